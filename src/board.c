@@ -0,0 +1,142 @@
+#include "lib/board.h"
+#include "lib/resources.h"
+
+int board_bit(int cell) {
+  return (cell - 1) / BOARD_SIZE * BOARD_STRIDE + (cell - 1) % BOARD_SIZE;
+}
+
+// ANDs each bit with the one `shift` bits after it, i.e. the next cell along
+// a direction. The words are gone through from the lowest, so each is only
+// changed after the ones below it have read it.
+static void board_and_shifted(uint64_t *words, int count, int shift) {
+  int word = shift / 64, bit = shift % 64;
+  for (int i = 0; i < count; ++i) {
+    uint64_t low = i + word < count ? words[i + word] : 0;
+    uint64_t high = i + word + 1 < count ? words[i + word + 1] : 0;
+    words[i] &= bit == 0 ? low : low >> bit | high << (64 - bit);
+  }
+}
+
+BOOL board_has_line(const uint64_t *words, int size, int length) {
+  int count = BOARD_WORDS_FOR(size), stride = size + 1;
+  // Across, down, and both diagonals
+  int directions[] = {1, stride, stride + 1, stride - 1};
+  for (int d = 0; d < 4; ++d) {
+    uint64_t runs[BOARD_MAX_WORDS];
+    memcpy(runs, words, count * sizeof(uint64_t));
+    // NOTE: A bit is left set if it starts `run` pieces in a row, which
+    // doubles each time until the next would be past `length`. The last
+    // step joins up two runs that overlap to make exactly `length`.
+    int run = 1;
+    while (run * 2 <= length) {
+      board_and_shifted(runs, count, run * directions[d]);
+      run *= 2;
+    }
+    if (run < length)
+      board_and_shifted(runs, count, (length - run) * directions[d]);
+
+    for (int i = 0; i < count; ++i)
+      if (runs[i] != 0)
+        return TRUE;
+  }
+  return FALSE;
+}
+
+// How many bits are set one after the other from `bit` (but not including
+// it) in steps of `step`, up to `most`. The spare bit at the end of each row
+// is never set, so a run stops at the edge of the board.
+static int board_run(const uint64_t *words, int bits, int bit, int step,
+                     int most) {
+  int run = 0;
+  for (bit += step; run < most && bit >= 0 && bit < bits; bit += step) {
+    if (!(words[bit / 64] >> (bit % 64) & 1))
+      break;
+    run++;
+  }
+  return run;
+}
+
+BOOL board_has_line_through(const uint64_t *words, int size, int length,
+                            int cell) {
+  int stride = size + 1, bits = stride * size;
+  int bit = (cell - 1) / size * stride + (cell - 1) % size;
+  // Across, down, and both diagonals
+  int directions[] = {1, stride, stride + 1, stride - 1};
+  for (int d = 0; d < 4; ++d) {
+    int run = 1 + board_run(words, bits, bit, directions[d], length - 1);
+    if (run < length)
+      run += board_run(words, bits, bit, -directions[d], length - run);
+    if (run >= length)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+#ifdef BOARD_IS_CLASSIC
+// The lines that go through each cell (as many as there are, then 0)
+static const uint64_t board_cell_lines[BOARD_CELLS][5] = {
+    {0x007, 0x111, 0x421}, {0x007, 0x222},
+    {0x007, 0x444, 0x124}, {0x070, 0x111},
+    {0x070, 0x222, 0x421, 0x124}, {0x070, 0x444},
+    {0x700, 0x111, 0x124}, {0x700, 0x222},
+    {0x700, 0x444, 0x421},
+};
+#endif
+
+BOOL board_is_won_at(const board_mask *pieces, int cell) {
+#ifdef BOARD_IS_CLASSIC
+  const uint64_t *lines = board_cell_lines[cell - 1];
+  for (int i = 0; lines[i] != 0; ++i)
+    if ((pieces->words[0] & lines[i]) == lines[i])
+      return TRUE;
+  return FALSE;
+#else
+  return board_has_line_through(pieces->words, BOARD_SIZE, BOARD_WIN_LENGTH,
+                                cell);
+#endif
+}
+
+int board_play(board_t *board, int player, int cell) {
+  if (cell < 1 || cell > BOARD_CELLS)
+    return -1;
+  int bit = board_bit(cell);
+  uint64_t move = (uint64_t)1 << (bit % 64);
+  int word = bit / 64;
+  if ((board->pieces[0].words[word] | board->pieces[1].words[word]) & move)
+    return -1;
+
+  board->pieces[player].words[word] |= move;
+  board->taken++;
+  if (board_is_won_at(&board->pieces[player], cell))
+    return BOARD_WON;
+  return board->taken == BOARD_CELLS ? BOARD_DRAWN : BOARD_PLAYING;
+}
+
+int board_draw(char *out, size_t cap, char *const *cells) {
+  wire_writer writer = wire_writer_fixed(out, cap);
+  char label[BOARD_CELL_TEXT_SIZE];
+  for (int row = 0; row < BOARD_SIZE; ++row) {
+    if (row > 0) {
+      for (int col = 0; col < BOARD_SIZE; ++col) {
+        if (col > 0)
+          wire_write_raw(&writer, "+", 1);
+        wire_write_raw(&writer, "-----", BOARD_LABEL_WIDTH + 2);
+      }
+      wire_write_raw(&writer, "\n", 1);
+    }
+    for (int col = 0; col < BOARD_SIZE; ++col) {
+      int cell = row * BOARD_SIZE + col + 1;
+      const char *text = cells[cell - 1];
+      if (text == NULL) {
+        snprintf(label, sizeof(label), board_label_template,
+                 BOARD_LABEL_WIDTH, cell);
+        text = label;
+      }
+      wire_write_raw(&writer, col > 0 ? " | " : " ", col > 0 ? 3 : 1);
+      wire_write_raw(&writer, text, strlen(text));
+    }
+    wire_write_raw(&writer, "\n", 1);
+  }
+  wire_write_raw(&writer, "", 1);
+  return writer.has_failed ? -1 : (int)writer.len - 1;
+}
@@ -0,0 +1,157 @@
+#include "lib/bot.h"
+
+#ifdef BOARD_IS_CLASSIC
+#define BOT_POSITIONS 19683 // 3^9
+#define BOT_UNSOLVED INT8_MIN
+
+// The lines of the board, with cell `n` as bit `n - 1`
+static const uint16_t bot_lines[] = {0x007, 0x038, 0x1C0, 0x049,
+                                     0x092, 0x124, 0x111, 0x054};
+
+static int8_t bot_scores[BOT_POSITIONS];
+// Each set of cells as a number in base 3, with a 1 for every cell in it
+static uint16_t bot_base3[512];
+// Each set of cells after turning or flipping the board (the first of which
+// leaves it as it is)
+static uint16_t bot_symmetries[8][512];
+static BOOL bot_is_ready = FALSE;
+
+// Where the cell at (row, col) ends up after each of the 8 symmetries
+static int bot_transform(int symmetry, int row, int col) {
+  int to[8][2] = {{row, col},         {col, 2 - row}, {2 - row, 2 - col},
+                  {2 - col, row},     {row, 2 - col}, {2 - row, col},
+                  {col, row},         {2 - col, 2 - row}};
+  return to[symmetry][0] * 3 + to[symmetry][1];
+}
+
+// The padded bitboard (see board.h) as 9 bits
+static uint16_t bot_cells(const board_mask *pieces) {
+  uint64_t word = pieces->words[0];
+  return (word & 0x7) | (word >> 1 & 0x38) | (word >> 2 & 0x1C0);
+}
+
+static BOOL bot_has_line(uint16_t cells) {
+  for (size_t i = 0; i < sizeof(bot_lines) / sizeof(bot_lines[0]); ++i)
+    if ((cells & bot_lines[i]) == bot_lines[i])
+      return TRUE;
+  return FALSE;
+}
+
+static int bot_key(uint16_t mine, uint16_t theirs) {
+  int key = BOT_POSITIONS;
+  for (int s = 0; s < 8; ++s) {
+    int turned = bot_base3[bot_symmetries[s][mine]] +
+                 2 * bot_base3[bot_symmetries[s][theirs]];
+    if (turned < key)
+      key = turned;
+  }
+  return key;
+}
+
+static int bot_solve(uint16_t mine, uint16_t theirs) {
+  int key = bot_key(mine, theirs);
+  if (bot_scores[key] != BOT_UNSOLVED)
+    return bot_scores[key];
+
+  int empty = 9 - __builtin_popcount(mine | theirs);
+  int score;
+  if (bot_has_line(theirs)) {
+    // They won with the move before
+    score = -(empty + 1);
+  } else if (empty == 0) {
+    score = 0;
+  } else {
+    score = -BOT_POSITIONS;
+    for (int cell = 0; cell < 9; ++cell) {
+      uint16_t bit = 1 << cell;
+      if ((mine | theirs) & bit)
+        continue;
+      int child = -bot_solve(theirs, mine | bit);
+      if (child > score)
+        score = child;
+    }
+  }
+  bot_scores[key] = score;
+  return score;
+}
+
+void bot_init() {
+  if (bot_is_ready)
+    return;
+  for (int cells = 0; cells < 512; ++cells) {
+    int power = 1;
+    for (int cell = 0; cell < 9; ++cell, power *= 3) {
+      if (!(cells & 1 << cell))
+        continue;
+      bot_base3[cells] += power;
+      for (int s = 0; s < 8; ++s)
+        bot_symmetries[s][cells] |= 1 << bot_transform(s, cell / 3, cell % 3);
+    }
+  }
+  memset(bot_scores, (uint8_t)BOT_UNSOLVED, sizeof(bot_scores));
+  // NOTE: Nothing is pruned, so every position that can be reached from the
+  // empty board is solved on the way.
+  bot_solve(0, 0);
+  bot_is_ready = TRUE;
+}
+
+int bot_score(uint16_t mine, uint16_t theirs) {
+  int8_t score = bot_scores[bot_key(mine, theirs)];
+  // A position that can't come up in a game (e.g. both have a line)
+  return score != BOT_UNSOLVED ? score : 0;
+}
+
+int bot_move(const board_t *board, int player) {
+  uint16_t mine = bot_cells(&board->pieces[player]);
+  uint16_t theirs = bot_cells(&board->pieces[!player]);
+  int best = -1, best_score = -BOT_POSITIONS;
+  for (int cell = 0; cell < 9; ++cell) {
+    uint16_t bit = 1 << cell;
+    if ((mine | theirs) & bit)
+      continue;
+    int score = -bot_score(theirs, mine | bit);
+    if (score > best_score) {
+      best = cell + 1;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+#else
+
+void bot_init() {}
+
+// Whether the piece would give `pieces` a line
+static BOOL bot_is_winning(const board_mask *pieces, int cell) {
+  board_mask after = *pieces;
+  int bit = board_bit(cell);
+  after.words[bit / 64] |= (uint64_t)1 << (bit % 64);
+  return board_is_won_at(&after, cell);
+}
+
+int bot_move(const board_t *board, int player) {
+  int block = -1, central = -1, best_distance = INT32_MAX;
+  int middle = (BOARD_SIZE - 1) / 2;
+  for (int cell = 1; cell <= BOARD_CELLS; ++cell) {
+    int bit = board_bit(cell);
+    uint64_t taken = board->pieces[0].words[bit / 64] |
+                     board->pieces[1].words[bit / 64];
+    if (taken >> (bit % 64) & 1)
+      continue;
+    if (bot_is_winning(&board->pieces[player], cell))
+      return cell;
+    if (block == -1 && bot_is_winning(&board->pieces[!player], cell))
+      block = cell;
+
+    int row = (cell - 1) / BOARD_SIZE, col = (cell - 1) % BOARD_SIZE;
+    int distance = abs(row - middle) + abs(col - middle);
+    if (distance < best_distance) {
+      central = cell;
+      best_distance = distance;
+    }
+  }
+  return block != -1 ? block : central;
+}
+
+#endif
@@ -3,6 +3,29 @@
 #define PORT 80
 #define loop while (1)
 
+static struct termios restore;
+static struct termios noughts_crosses_term;
+
+static board_piece board[BOARD_WIDTH][BOARD_WIDTH] = {0};
+// Whether the game on the board is being watched, rather than played, in
+// which case the pieces are told apart as x & o instead of as ours & theirs.
+static BOOL is_spectating = FALSE;
+
+static char printable_board[printable_board_mem + 1]; // Each time we want
+                                                      // to print, we will
+// draw the board (see `board_draw`) with the string of each piece from the
+// board.
+static char intermediate[intermediate_mem + 1] = {0};
+
+// NOTE: Only one page is ever shown, so the games on it are kept here.
+static lobby_game lobby_games[LOBBY_PAGE_SIZE];
+static int lobby_game_count = 0;
+static int lobby_offset = 0; // How many games come before the page
+static int lobby_total = 0;  // How many games there are (on every page)
+// The number of the game to watch, while it's being typed out on the games
+// page (0 to watch any game)
+static unsigned int typed_game = 0;
+
 int main() {
   client_t *client = client_init();
   // Initially, requires_username will be TRUE when the client_id is first
@@ -11,7 +34,7 @@ int main() {
   BOOL requires_username;
   uint8_t client_name_length = 0;
 
-  char buffer[1024];
+  char buffer[CLIENT_BUFFER_SIZE];
   struct pollfd fds[1];
   fds[0].fd = client->socket;
   fds[0].events = POLL_IN;
@@ -21,6 +44,12 @@ int main() {
 
   char c;
   int ignore_n_chars = 0;
+  BOOL is_lobby_outdated = FALSE; // The games page needs to be drawn again
+  // What the server gave us to get back in if our connection drops (see
+  // RESUME_FLAG), which is sent back as it is.
+  char resume_token[WIRE_RESUME_SIZE];
+  BOOL has_resume_token = FALSE;
+  BOOL is_resuming = FALSE; // Waiting to hear if we're back in
 
   while (client->socket == fds[0].fd) {
     // Check if we have a connection
@@ -34,7 +63,17 @@ int main() {
 
       if (fds[0].revents & POLL_IN) {
         // We have received a message
-        if (read_status == -1) {
+        if ((read_status == 0 || read_status == -1) && has_resume_token) {
+          // The server might still be holding on to us
+          if (client_resume(client, resume_token) == -1) {
+            printf("\x1b[31;1mServer has disconnected\x1b[0m\r\n");
+            break;
+          }
+          fds[0].fd = client->socket;
+          client_id = -1;
+          is_resuming = TRUE;
+          continue;
+        } else if (read_status == -1) {
           disable_raw_term();
           handle_sock_error(errno);
           exit(1);
@@ -44,52 +83,114 @@ int main() {
           break;
         }
 
-        int received = smart_recv(client->socket, buffer, 1024);
+        int received = smart_recv(client->socket, buffer, sizeof(buffer));
+        BOOL is_printable = TRUE;
         if (client_id == -1) {
           // We have received the client ID
           // We need to use strtol to convert the string to an integer
           /* client_id = deserialize_int(buffer); */
           client_id = strtol(buffer, NULL, 10);
-
-          printf("\x1b[32;1mConnected to server as client %s\x1b[0m\r\n",
-                 buffer);
           client->client_id = client_id;
-          requires_username = TRUE;
-          client->client_name = calloc(MAX_CLIENT_NAME_LENGTH, sizeof(char));
+
+          // NOTE: While resuming, we already sent our token instead of a name.
+          if (!is_resuming) {
+            printf("\x1b[32;1mConnected to server as client %s\x1b[0m\r\n",
+                   buffer);
+            requires_username = TRUE;
+            client->client_name = calloc(MAX_CLIENT_NAME_LENGTH, sizeof(char));
+            print_buffer(clear_screen);
+            print_buffer(main_menu);
+          }
+        } else if (received == WIRE_RESUME_SIZE && buffer[0] == RESUME_FLAG) {
+          memcpy(resume_token, buffer, WIRE_RESUME_SIZE);
+          has_resume_token = TRUE;
+          is_printable = FALSE;
+        } else if (is_resuming && received > 0 &&
+                   buffer[0] == STRING_SERIALIZE_FLAG) {
+          char *message = deserialize_string(buffer);
+          is_resuming = FALSE;
+          free(client->game);
+          client->game = NULL;
           print_buffer(clear_screen);
           print_buffer(main_menu);
-        } else if (client->screen_state == IN_GAME_PAGE) {
+          if (!strcmp(message, "resumed")) {
+            // We're back, and the server sends us our game if we had one
+            client->screen_state = HOME_PAGE;
+          } else {
+            // We were gone for too long, so we have to start over
+            has_resume_token = FALSE;
+            client->screen_state = SETUP_PAGE;
+            requires_username = TRUE;
+            client_name_length = 0;
+            memset(client->client_name, 0, MAX_CLIENT_NAME_LENGTH);
+          }
+          free(message);
+          is_printable = FALSE;
+        } else if (client->screen_state == HOME_PAGE && received >= 3 &&
+                   buffer[0] == GAME_SIG_MOVE && buffer[1] == 0x03) {
+          // We've been put back into a game that we had going before the
+          // server (or our connection) went down. The board so far is sent as
+          // moves, starting with the host's.
+          client->screen_state = IN_GAME_PAGE;
+          game_t *game = calloc(1, sizeof(game_t));
+          game->isCurrentPlayerTurn = buffer[2] == 0;
+          client->game = game;
+          setup_game_dep(FALSE);
+          is_printable = FALSE;
+        } else if (client->screen_state == IN_GAME_PAGE ||
+                   client->screen_state == SPECTATOR_PAGE) {
           if (deserialize_int(buffer) == GAME_SIG_EXIT) {
             // We must leave the game.
             client->screen_state = GAME_VIEW_PAGE;
+            free(client->game);
+            client->game = NULL;
             print_buffer(game_end);
             sleep(1);
             print_buffer(clear_screen);
 
             // Send another request to the server
             // to retrieve the list of games.
-            char *view_games_req = serialize_int(1);
-            smart_send(fds[0].fd, view_games_req, 7);
-            free(view_games_req);
-          } else if (is_game_sig(buffer[0])) {
-            // Switch out the buffer type so we can deserialize it
-            int signal;
-            switch (buffer[0]) {
-            case GAME_SIG_CHECK:
-            case GAME_SIG_CONFIRM:
-            case GAME_SIG_EXIT:
-              buffer[0] = INT_SERIALIZE_FLAG;
-              signal = deserialize_int(
-                  buffer); // Signal may be a position on the board
-                           // or a signal to check for a condition (e.g win)
-              break;
-            default:
-              signal = buffer[0];
-            }
-            handle_game_input(fds[0].fd, client, signal, ENEMY);
+            send_constant(fds[0].fd, WIRE_VIEW_GAMES);
+          } else if (received > 0 && buffer[0] == GAME_SIG_MOVE) {
+            handle_game_move(client, buffer, received);
+            is_printable = FALSE;
+          }
+        } else if (client->screen_state == GAME_VIEW_PAGE && received > 0 &&
+                   buffer[0] == LOBBY_DELTA_FLAG) {
+          // NOTE: The server keeps us up to date with the games page by
+          // itself, we draw it once we have caught up.
+          if (apply_lobby_delta(buffer, received)) {
+            // A game has gone from the page, so it's filled up again (or is
+            // swapped for the last page if it's been emptied).
+            request_lobby_page(fds[0].fd, LOBBY_PAGE_FROM,
+                               lobby_game_count > 0 ? lobby_games[0].id
+                                                    : INT_MAX);
+          }
+          is_lobby_outdated = TRUE;
+          is_printable = FALSE;
+        } else if (client->screen_state == GAME_VIEW_PAGE && received > 0 &&
+                   buffer[0] == STRING_SERIALIZE_FLAG) {
+          char *message = deserialize_string(buffer);
+          if (!strcmp(message, "joined")) {
+            // The game we asked to join has started
+            client->screen_state = IN_GAME_PAGE;
+            game_t *game = calloc(1, sizeof(game_t));
+            game->isCurrentPlayerTurn = FALSE; // The host will be going first.
+            client->game = game;
+            setup_game_dep(FALSE);
+            is_lobby_outdated = is_printable = FALSE;
+          } else if (!strcmp(message, "watching")) {
+            // The board so far is sent as moves, starting with the host's
+            client->screen_state = SPECTATOR_PAGE;
+            game_t *game = calloc(1, sizeof(game_t));
+            game->isCurrentPlayerTurn = TRUE;
+            client->game = game;
+            setup_game_dep(TRUE);
+            is_lobby_outdated = is_printable = FALSE;
           }
+          free(message);
         }
-        if (client->client_name != NULL &&
+        if (is_printable && client->client_name != NULL &&
             client->client_name[0] !=
                 0) // The server doesn't send anything useful
                    // for output until after we have joined
@@ -100,6 +201,13 @@ int main() {
         // Prevent previous long messages leaking into new short messages
         if (received > 0)
           bzero(buffer, received);
+
+        // Only draw the games page once there are no more changes waiting
+        if (is_lobby_outdated && client->screen_state == GAME_VIEW_PAGE &&
+            recv(client->socket, peek_buf, 1, MSG_PEEK | MSG_DONTWAIT) < 1) {
+          render_lobby();
+          is_lobby_outdated = FALSE;
+        }
       } else if (fds[0].revents & POLL_ERR) {
         printf("\x1b[31;1mError occurred\x1b[0m\r\n");
       }
@@ -155,7 +263,7 @@ int main() {
 
           // NOTE: We need to wait for a heads-up from the server that we were
           // successful.
-          smart_recv(fds[0].fd, buffer, 1024);
+          smart_recv(fds[0].fd, buffer, sizeof(buffer));
           if (deserialize_int(buffer) == 1) {
             printf("\033[%d;0H", 6); // Move to the line above the input dialog
             printf("\0337");
@@ -187,7 +295,12 @@ int main() {
         ignore_n_chars--;
         continue;
       }
-      serialized s;
+      if (client->screen_state == GAME_VIEW_PAGE && isdigit(c)) {
+        typed_game = typed_game * 10 + (c - '0');
+        if (typed_game > UINT32_MAX / 10)
+          typed_game = c - '0';
+        continue;
+      }
       switch (c) {
       case ESC_KEY:
         ignore_n_chars = 2;
@@ -200,59 +313,66 @@ int main() {
       case 'r':
       case 'R':
         if (client->screen_state == GAME_VIEW_PAGE) {
-          s.val = serialize_int(1);
-          smart_send(fds[0].fd, s.val, 7);
-          free(s.val);
-          s.val = NULL;
+          send_constant(fds[0].fd, WIRE_VIEW_GAMES);
+        }
+        break;
+      case 'n':
+      case 'N':
+        if (client->screen_state == GAME_VIEW_PAGE && lobby_game_count > 0 &&
+            lobby_offset + lobby_game_count < lobby_total) {
+          request_lobby_page(fds[0].fd, LOBBY_PAGE_FROM,
+                             lobby_games[lobby_game_count - 1].id + 1);
+        }
+        break;
+      case 'p':
+      case 'P':
+        if (client->screen_state == GAME_VIEW_PAGE && lobby_game_count > 0 &&
+            lobby_offset > 0) {
+          request_lobby_page(fds[0].fd, LOBBY_PAGE_BEFORE, lobby_games[0].id);
         }
         break;
       case 'b':
       case 'B':
         if (client->screen_state == GAME_VIEW_PAGE) {
-          smart_send(fds[0].fd, "b", 2);
+          send_constant(fds[0].fd, WIRE_BACK);
+          typed_game = 0;
           client->screen_state = HOME_PAGE;
           print_buffer(clear_screen);
           print_buffer(main_menu);
-        } else if (client->screen_state == IN_GAME_PAGE) {
+        } else if (client->screen_state == IN_GAME_PAGE ||
+                   client->screen_state == SPECTATOR_PAGE) {
           print_buffer(clear_screen);
-          smart_send(fds[0].fd, "b", 2);
+          send_constant(fds[0].fd, WIRE_BACK);
           client->screen_state = GAME_VIEW_PAGE;
+          free(client->game);
+          client->game = NULL;
+        }
+        break;
+      case 'w':
+      case 'W':
+        if (client->screen_state == GAME_VIEW_PAGE) {
+          // NOTE: The server answers with "watching", or the games page if
+          // there isn't a game to watch.
+          watch_game(fds[0].fd, typed_game);
+          typed_game = 0;
         }
         break;
       case ' ':
         if (client->screen_state == GAME_VIEW_PAGE) {
-          s.str = serialize_string(" ");
-          int sent;
-          while ((sent = smart_send(fds[0].fd, s.str.str, s.str.len + 1)) !=
-                 s.str.len + 1)
+          // NOTE: We find out whether we got into a game when the server
+          // answers (with "joined", or the games page if there wasn't one).
+          while (send_constant(fds[0].fd, WIRE_JOIN) !=
+                 wire_constants[WIRE_JOIN].len)
             ;
-          free(s.str.str);
-
-          // We might not be able to join the game.
-          // If we have not refreshed, the server will send us back a response
-          // with the updated games list.
-          int received = smart_recv(fds[0].fd, buffer, 1024);
-          if (received > 0) {
-            s.str.str = deserialize_string(buffer);
-            if (!strcmp(s.str.str, "joined")) {
-              client->screen_state = IN_GAME_PAGE;
-              game_t *game = calloc(1, sizeof(game_t));
-              game->isCurrentPlayerTurn =
-                  FALSE; // The host will be going first.
-              client->game = game;
-              setup_game_dep();
-            }
-            free(s.str.str);
-          }
         }
         break;
       case '1':
         switch (client->screen_state) {
         case HOME_PAGE:
-          view_active_games(fds[0].fd, client, &s);
+          view_active_games(fds[0].fd, client);
           break;
         case IN_GAME_PAGE:
-          handle_game_input(fds[0].fd, client, 1, PLAYER);
+          handle_game_key(fds[0].fd, client, c);
           break;
         default:
           break;
@@ -261,10 +381,10 @@ int main() {
       case '2':
         switch (client->screen_state) {
         case HOME_PAGE:
-          create_new_game(fds[0].fd, client, &s);
+          create_new_game(fds[0].fd, client);
           break;
         case IN_GAME_PAGE:
-          handle_game_input(fds[0].fd, client, 2, PLAYER);
+          handle_game_key(fds[0].fd, client, c);
           break;
         default:
           break;
@@ -276,35 +396,22 @@ int main() {
           fds[0].fd = -1;
           break;
         case IN_GAME_PAGE:
-          handle_game_input(fds[0].fd, client, 3, PLAYER);
+          handle_game_key(fds[0].fd, client, c);
           break;
         default:
           break;
         }
         break;
       case '4':
-        if (client->screen_state == IN_GAME_PAGE)
-          handle_game_input(fds[0].fd, client, 4, PLAYER);
-        break;
       case '5':
-        if (client->screen_state == IN_GAME_PAGE)
-          handle_game_input(fds[0].fd, client, 5, PLAYER);
-        break;
       case '6':
-        if (client->screen_state == IN_GAME_PAGE)
-          handle_game_input(fds[0].fd, client, 6, PLAYER);
-        break;
       case '7':
-        if (client->screen_state == IN_GAME_PAGE)
-          handle_game_input(fds[0].fd, client, 7, PLAYER);
-        break;
       case '8':
-        if (client->screen_state == IN_GAME_PAGE)
-          handle_game_input(fds[0].fd, client, 8, PLAYER);
-        break;
       case '9':
+      case '0':
+      case NEWLINE_KEY:
         if (client->screen_state == IN_GAME_PAGE)
-          handle_game_input(fds[0].fd, client, 9, PLAYER);
+          handle_game_key(fds[0].fd, client, c);
         break;
       }
     }
@@ -364,6 +471,26 @@ client_t *client_init() {
   return client;
 }
 
+int client_resume(client_t *client, const char *token) {
+  printf("\x1b[33;1mLost the connection, trying to get back in\x1b[0m\r\n");
+  close(client->socket);
+  for (int attempt = 0; attempt < RESUME_ATTEMPTS; ++attempt) {
+    int socket_fd = socket(AF_INET, SOCK_STREAM, TCP);
+    if (socket_fd != -1 &&
+        connect(socket_fd, (struct sockaddr *)&client->addr,
+                sizeof(client->addr)) == 0) {
+      client->socket = socket_fd;
+      // NOTE: The token goes out straight away, rather than after our ID, so
+      // that we're back in a single round trip.
+      return smart_send(socket_fd, token, WIRE_RESUME_SIZE) > 0 ? 0 : -1;
+    }
+    if (socket_fd != -1)
+      close(socket_fd);
+    sleep(RECONNECT_INTERVAL);
+  }
+  return -1;
+}
+
 int client_connect(int server_fd, client_t *client) {
   printf("\x1b[33;1mAttempting to connect to server\x1b[0m\r\n");
   struct sockaddr_in server_addr;
@@ -410,35 +537,108 @@ void client_disconnect(client_t *client) {
   free(client->client_name);
 
   // Free the game board strings
-  int row, col;
-  for (int i = 0; i < BOARD_WIDTH * BOARD_WIDTH; i++) {
-    row = i / 3;
-    col = i % 3;
-    if (board[row][col].type != SERVER)
-      free(board[row][col].print_string);
-  }
+  for (int i = 0; i < BOARD_CELLS; i++)
+    free(board[i / BOARD_WIDTH][i % BOARD_WIDTH].print_string);
   free(client->game);
   free(client);
 }
 
-void view_active_games(int socket, client_t *client, serialized *s) {
-  s->val = serialize_int(1);
-  smart_send(socket, s->val, 7);
-  free(s->val);
-  s->val = NULL;
+BOOL apply_lobby_delta(char *buffer, int len) {
+  wire_reader reader = wire_reader_init(buffer, len);
+  int id;
+  int kind = wire_read_delta(&reader, &id);
+
+  if (kind == LOBBY_RESET) {
+    lobby_total = id;
+    lobby_offset = wire_read_int(&reader);
+    lobby_game_count = 0;
+  } else if (kind == LOBBY_GAME_OPENED) {
+    const char *line = wire_read_string(&reader, NULL);
+    if (line == NULL)
+      return FALSE;
+    // NOTE: New games go at the end, so only the last page can show them.
+    if (lobby_offset + lobby_game_count == lobby_total &&
+        lobby_game_count < LOBBY_PAGE_SIZE) {
+      lobby_games[lobby_game_count].id = id;
+      strcpy(lobby_games[lobby_game_count].line, line);
+      lobby_game_count++;
+    }
+    lobby_total++;
+  } else if (kind == LOBBY_GAME_FILLED || kind == LOBBY_GAME_CLOSED) {
+    // Either way, it can't be joined anymore
+    lobby_total--;
+    if (lobby_game_count > 0 && id < lobby_games[0].id) {
+      lobby_offset--;
+      return FALSE;
+    }
+    for (int i = 0; i < lobby_game_count; ++i) {
+      if (lobby_games[i].id != id)
+        continue;
+      memmove(lobby_games + i, lobby_games + i + 1,
+              (lobby_game_count - i - 1) * sizeof(lobby_game));
+      lobby_game_count--;
+      // The games after the page (or before, if it's now empty) would move
+      // into it, which only the server knows about.
+      return lobby_offset + lobby_game_count < lobby_total ||
+             (lobby_game_count == 0 && lobby_offset > 0);
+    }
+  }
+  return FALSE;
+}
+
+void render_lobby() {
+  char header[512];
+  snprintf(header, sizeof(header), view_games,
+           lobby_total > 1 || lobby_total == 0 ? "are" : "is", lobby_total,
+           lobby_total > 1 || lobby_total == 0 ? "games" : "game");
+
+  printf("%s", clear_screen);
+  print_buffer(header);
+  if (lobby_total > LOBBY_PAGE_SIZE) {
+    snprintf(header, sizeof(header), page_info, lobby_offset + 1,
+             lobby_offset + lobby_game_count, lobby_total);
+    print_buffer(header);
+  }
+  for (int i = 0; i < lobby_game_count; ++i)
+    print_buffer(lobby_games[i].line);
+  fflush(stdout);
+}
+
+void request_lobby_page(int socket, int kind, int id) {
+  char request[WIRE_DELTA_SIZE];
+  wire_writer writer = wire_writer_fixed(request, sizeof(request));
+  wire_write_delta(&writer, kind, id);
+  smart_send(socket, request, writer.len);
+}
+
+void watch_game(int socket, unsigned int id) {
+  if (id == 0) {
+    send_constant(socket, WIRE_WATCH);
+    return;
+  }
+  char request[WIRE_STRING_SIZE(1) + WIRE_INT_SIZE];
+  wire_writer writer = wire_writer_fixed(request, sizeof(request));
+  wire_write_string(&writer, "w");
+  wire_write_int(&writer, id);
+  smart_send(socket, request, writer.len);
+}
+
+int send_constant(int socket, wire_constant_id id) {
+  return smart_send(socket, wire_constants[id].data, wire_constants[id].len);
+}
+
+void view_active_games(int socket, client_t *client) {
+  send_constant(socket, WIRE_VIEW_GAMES);
   client->screen_state = GAME_VIEW_PAGE;
 }
 
-void create_new_game(int socket, client_t *client, serialized *s) {
-  s->val = serialize_int(2);
-  smart_send(socket, s->val, 7);
-  free(s->val);
-  s->val = NULL;
+void create_new_game(int socket, client_t *client) {
+  send_constant(socket, WIRE_CREATE_GAME);
 
   print_buffer(clear_screen);
   print_buffer(waiting_room);
 
-  setup_game_dep();
+  setup_game_dep(FALSE);
 
   client->screen_state = IN_GAME_PAGE;
   game_t *game = calloc(1, sizeof(game_t));
@@ -446,98 +646,80 @@ void create_new_game(int socket, client_t *client, serialized *s) {
   client->game = game;
 }
 
-void setup_game_dep() {
+void setup_game_dep(BOOL is_watching) {
+  is_spectating = is_watching;
   int row, col;
-  for (int i = 0; i < BOARD_WIDTH * BOARD_WIDTH; i++) {
-    row = i / 3;
-    col = i % 3;
-    board[row][col] =
-        (board_piece){.piece = (1 + row + col) + '0',
-                      .type = SERVER}; // NOTE: This only works where
-                                       // BOARD_WIDTH * BOARD_WIDTH < 10
-    snprintf(intermediate, intermediate_mem + 1, "\x1b[30;1m%c\x1b[0;0m",
-             (i + 1) + '0');
-    board[row][col].print_string = strdup(intermediate);
+  for (int i = 0; i < BOARD_CELLS; i++) {
+    row = i / BOARD_WIDTH;
+    col = i % BOARD_WIDTH;
+    // NOTE: The pieces from the last game (if there was one) are still here.
+    free(board[row][col].print_string);
+    board[row][col] = (board_piece){.piece = i + 1, .type = SERVER};
   }
 
   update_board(PLAYER);
 }
 
-void handle_game_input(int socket, client_t *client, unsigned int position,
-                       Source source) {
-  // Define up here so we can check in the handle_game_win
-  int game_over;
-
-  // Check if the signal is related to the game state (e.g ending /
-  // drawing)
-  if (source == ENEMY && position == GAME_SIG_WIN || position == GAME_SIG_DRAW)
-    goto handle_game_win;
+#if BOARD_CELLS >= 10
+// The cell that is being typed out
+static unsigned int typed_cell = 0;
+#endif
+
+void handle_game_key(int socket, client_t *client, char key) {
+#if BOARD_CELLS < 10
+  if (isdigit(key))
+    handle_game_input(socket, client, key - '0');
+#else
+  if (isdigit(key)) {
+    typed_cell = typed_cell * 10 + (key - '0');
+    // Start again from the latest digit, rather than having to be cleared
+    if (typed_cell > BOARD_CELLS)
+      typed_cell = key - '0';
+    return;
+  }
+  if (key == NEWLINE_KEY && typed_cell > 0)
+    handle_game_input(socket, client, typed_cell);
+  typed_cell = 0;
+#endif
+}
 
+void handle_game_input(int socket, client_t *client, unsigned int position) {
   // We are attempting to play when it is not our turn
-  if (source == PLAYER && !((game_t *)client->game)->isCurrentPlayerTurn)
+  if (!((game_t *)client->game)->isCurrentPlayerTurn)
     return;
 
-  unsigned int row, col;
-  row = (position - 1) / 3;
-  col = (position - 1) % 3;
-
-  // The other player is attempting to play when it is our turn.
-  int is_other_player_attempting =
-      source == ENEMY && ((game_t *)client->game)->isCurrentPlayerTurn;
-  // The position is invalid (we only end up here if none of the signals
-  // match ones such as GAME_SIG_WIN so this must have the intention of
-  // being a position)
-  int is_position_invalid =
-      position > (BOARD_WIDTH * BOARD_WIDTH) || position < 1;
-
-  if (is_other_player_attempting || is_position_invalid) {
-    char *confirm_message = serialize_bool(FALSE);
-    confirm_message[0] = GAME_SIG_CONFIRM;
-    smart_send(socket, confirm_message, 4);
-    free(confirm_message);
-    return;
-  } else if (board[row][col].type != SERVER) { // Position is already occupied.
-    char *confirm_message = serialize_bool(FALSE);
-    confirm_message[0] = GAME_SIG_CONFIRM;
-    smart_send(socket, confirm_message, 4);
-    free(confirm_message);
+  // NOTE: The server checks the move for itself, this only saves asking it
+  // about one that it would turn down.
+  unsigned int row = (position - 1) / BOARD_WIDTH,
+               col = (position - 1) % BOARD_WIDTH;
+  if (position > BOARD_CELLS || position < 1 ||
+      board[row][col].type != SERVER)
     return;
-  }
 
-  // All checks have been passed, update the board
-  if (source == ENEMY) {
-    char *confirm_message = serialize_bool(TRUE);
-    confirm_message[0] = GAME_SIG_CONFIRM;
-    smart_send(socket, confirm_message, 4);
-    free(confirm_message);
-    goto change_board;
-  }
+  char move[] = {GAME_SIG_MOVE, 0x01, position};
+  smart_send(socket, move, sizeof(move));
+}
 
-  // Check if the other client thinks the move is valid.
-  char *check_message = serialize_int(position);
-  // The server will check this for whether it's a game signal or a normal int.
-  check_message[0] = GAME_SIG_CHECK;
-  smart_send(socket, check_message, 7);
-  free(check_message);
-
-  char buf[4];
-  // Wait for a response from the server.
-  smart_recv(socket, buf, 4);
-
-  // The move was not valid.
-  buf[0] = BOOL_SERIALIZE_FLAG; // Change from GAME_SIG_CONFIRM to bool so we
-                                // can deserialize
-  if (deserialize_bool(buf) == FALSE) {
+void handle_game_move(client_t *client, const char *buffer, int len) {
+  if (len < 4 || buffer[1] != 0x02)
+    return;
+  unsigned int position = (unsigned char)buffer[2];
+  int outcome = buffer[3];
+  if (position > BOARD_CELLS || position < 1)
     return;
-  }
 
-change_board:
+  // NOTE: The server only lets whoever's turn it is move.
+  game_t *game = client->game;
+  Source source = game->isCurrentPlayerTurn ? PLAYER : ENEMY;
+  unsigned int row = (position - 1) / BOARD_WIDTH,
+               col = (position - 1) % BOARD_WIDTH;
 
   board[row][col].piece = position;
   board[row][col].type = source;
-  snprintf(intermediate, intermediate_mem + 1, "\x1b[3%d;1m%c\x1b[0;0m",
-           source == PLAYER ? 2 : 1,
+  snprintf(intermediate, intermediate_mem + 1, board_piece_template,
+           source == PLAYER ? 2 : 1, BOARD_LABEL_WIDTH,
            source == PLAYER ? 'x' : 'o'); // 2 -> 32 -> Green, 1 -> 31 -> Red
+  free(board[row][col].print_string);
   board[row][col].print_string = strdup(intermediate);
 
   update_board(source);
@@ -547,108 +729,37 @@ change_board:
   printf("\033[B");
   print_buffer(printable_board);
 
-  ((game_t *)client->game)->isCurrentPlayerTurn ^= 1; // Switch turns.
+  game->isCurrentPlayerTurn ^= 1; // Switch turns.
   printf("\0338");
 
-  // We don't NEED to check anything else if we are just accepting an
-  // enemy position
-  if (source == ENEMY)
+  if (outcome == BOARD_PLAYING)
     return;
-
-  // Check if we have won.
-  game_over = is_game_over(PLAYER);
-  if (game_over > 0) {
-    char *check_game_over = serialize_bool(TRUE);
-    check_game_over[0] = game_over == 1 ? GAME_SIG_WIN : GAME_SIG_DRAW;
-    smart_send(socket, check_game_over, 4);
-
-    // Wait for the response.
-    char res[4] = {0};
-    while (smart_recv(socket, res, 4) < 0 && res[0] != GAME_SIG_CONFIRM_END)
-      ;
-
-    res[0] = BOOL_SERIALIZE_FLAG;
-    if (deserialize_bool(res) == TRUE) {
-      // The other player agrees with our decision.
-      printf("You have %s the game!\r\n", game_over == 1 ? "won" : "drawn");
-      // Delay the program for 1s, then recieve the server message.
-      sleep(1);
-    }
-    free(check_game_over);
-  }
-  return;
-
-handle_game_win:
-  game_over = is_game_over(ENEMY);
-  // Convert from the defined values to the enum values (e.g 12 is Draw -> 2 for
-  // Draw)
-  if (game_over == (position - 10)) {
-    // Send back a confirmation message to the enemy.
-    char *game_win_confirmation = serialize_bool(TRUE);
-    game_win_confirmation[0] = GAME_SIG_CONFIRM_END;
-    smart_send(socket, game_win_confirmation, 4);
-    free(game_win_confirmation);
-
-    printf("\033[AYou have %s the game!\r\n",
-           game_over == 1 ? "lost" : "drawn");
-    sleep(1);
-  } else {
-    char *game_win_denial = serialize_bool(FALSE);
-    game_win_denial[0] = GAME_SIG_CONFIRM_END;
-    smart_send(socket, game_win_denial, 4);
-    free(game_win_denial);
-  }
+  if (is_spectating && outcome == BOARD_DRAWN)
+    printf("The game is a draw!\r\n");
+  else if (is_spectating)
+    printf("%c has won the game!\r\n", source == PLAYER ? 'x' : 'o');
+  else
+    printf("You have %s the game!\r\n", outcome == BOARD_DRAWN ? "drawn"
+                                         : source == PLAYER    ? "won"
+                                                               : "lost");
+  // Delay the program for 1s, then the server will end the game.
+  sleep(1);
 }
 
 void update_board(int source) {
-  snprintf(printable_board, printable_board_mem + 1, board_template,
-           board[0][0].print_string, board[0][1].print_string,
-           board[0][2].print_string, board[1][0].print_string,
-           board[1][1].print_string, board[1][2].print_string,
-           board[2][0].print_string, board[2][1].print_string,
-           board[2][2].print_string, source != PLAYER ? "currently" : "not");
-}
-
-int is_game_over(Source source) {
-  // Since the player enum value is 0 and there are no other
-  // values in the enum < 0, we can do !(val) to see if it is
-  // the player value.
-  int win_horizontal =
-      IS_ROW_WON(0, source) || IS_ROW_WON(1, source) || IS_ROW_WON(2, source);
-  if (win_horizontal)
-    return 1;
-
-  int win_vertical =
-      IS_COL_WON(0, source) || IS_COL_WON(1, source) || IS_COL_WON(2, source);
-  if (win_vertical)
-    return 1;
-
-  int win_diagonal =
-      (board[0][0].type == source && board[1][1].type == source &&
-       board[2][2].type == source) ||
-      (board[2][0].type == source && board[1][1].type == source &&
-       board[0][2].type == source);
-  if (win_diagonal)
-    return 1;
-
-  // Check if any spaces are left
-  BOOL is_space_left = FALSE;
-  int row, col;
-  for (int pos = 0; pos < BOARD_WIDTH * BOARD_WIDTH; pos++) {
-    row = pos / 3;
-    col = pos % 3;
-    if (board[row][col].type == SERVER) {
-      is_space_left = TRUE;
-      break;
-    }
-  }
-
-  if (!is_space_left)
-    return 2;
-  return 0;
+  char *cells[BOARD_CELLS];
+  for (int i = 0; i < BOARD_CELLS; i++)
+    cells[i] = board[i / BOARD_WIDTH][i % BOARD_WIDTH].print_string;
+  int len = board_draw(printable_board, printable_board_mem + 1, cells);
+  if (is_spectating)
+    snprintf(printable_board + len, printable_board_mem + 1 - len,
+             board_watch_template, source != PLAYER ? 'x' : 'o');
+  else
+    snprintf(printable_board + len, printable_board_mem + 1 - len,
+             board_turn_template, source != PLAYER ? "currently" : "not");
 }
 
-void print_buffer(char *buf) {
+void print_buffer(const char *buf) {
   char *dup = strdup(buf);
   char *token = strtok(dup, "\n");
   while (token != NULL) {
@@ -0,0 +1,456 @@
+#include "lib/conn.h"
+#include "lib/reactor.h"
+#include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef CONN_MAX_IOV
+#define CONN_MAX_IOV 64 // The amount of chunks we hand to a single `writev`
+#endif
+
+// NOTE: We use `sendmsg` rather than `writev` (they both gather the iovecs
+// into one syscall) so that a broken pipe can't raise SIGPIPE.
+#ifdef MSG_NOSIGNAL
+#define CONN_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define CONN_SEND_FLAGS 0
+#endif
+
+conn_t *conn_init(int socket) {
+  conn_t *conn = calloc(1, sizeof(conn_t));
+  conn->socket = socket;
+  conn->reactor = -1;
+  conn->read_cap = CONN_READ_SIZE;
+  conn->read_buf = malloc(conn->read_cap);
+  return conn;
+}
+
+void conn_on_congestion(conn_t *conn, conn_congestion_callback callback,
+                        void *arg) {
+  conn->on_congestion = callback;
+  conn->congestion_arg = arg;
+}
+
+static void conn_set_congestion(conn_t *conn, int congestion) {
+  if (conn->congestion == congestion)
+    return;
+  conn->congestion = congestion;
+  if (conn->on_congestion != NULL)
+    conn->on_congestion(conn, congestion, conn->congestion_arg);
+}
+
+// Called whenever the queue has grown or shrunk. Between the watermarks, the
+// connection stays as it was.
+static void conn_check_watermarks(conn_t *conn) {
+  if (conn->congestion == CONN_OVERFLOWED)
+    return;
+  if (conn->write_queued > CONN_HIGH_WATERMARK)
+    conn_set_congestion(conn, CONN_CONGESTED);
+  else if (conn->write_queued <= CONN_LOW_WATERMARK)
+    conn_set_congestion(conn, CONN_DRAINED);
+}
+
+// Make sure that the reactor is only told about writability while we
+// actually have something to write, otherwise we'd be woken up constantly.
+static int conn_update_events(conn_t *conn) {
+  if (conn->reactor == -1)
+    return 0;
+  int events = REACTOR_READ | (conn->write_queued > 0 ? REACTOR_WRITE : 0);
+  if (events == conn->events)
+    return 0;
+  conn->events = events;
+  return reactor_mod(conn->reactor, conn->socket, events, conn->token);
+}
+
+int conn_attach(conn_t *conn, int reactor, uint64_t token, conn_batch *batch) {
+  int events = REACTOR_READ | (conn->write_queued > 0 ? REACTOR_WRITE : 0);
+  if (reactor_add(reactor, conn->socket, events, token) == -1)
+    return -1;
+  conn->reactor = reactor;
+  conn->token = token;
+  conn->events = events;
+  conn->batch = batch;
+  return 0;
+}
+
+static void conn_batch_remove(conn_t *conn) {
+  if (!conn->is_batched)
+    return;
+  if (conn->batch_prev != NULL)
+    conn->batch_prev->batch_next = conn->batch_next;
+  else
+    conn->batch->head = conn->batch_next;
+  if (conn->batch_next != NULL)
+    conn->batch_next->batch_prev = conn->batch_prev;
+  conn->batch_prev = conn->batch_next = NULL;
+  conn->is_batched = FALSE;
+}
+
+// The pools of a batch belong to its thread, so whatever is still queued is
+// moved out of them before the connection can be handed to another one.
+static void conn_unpool(conn_t *conn) {
+  conn_chunk **link = &conn->write_head;
+  conn_chunk *last = NULL;
+  for (conn_chunk *chunk = conn->write_head; chunk != NULL;
+       chunk = chunk->next) {
+    if (chunk->pool != NULL) {
+      size_t data = chunk->shared != NULL ? 0 : chunk->cap;
+      conn_chunk *copy = malloc(sizeof(conn_chunk) + data);
+      memcpy(copy, chunk, sizeof(conn_chunk) + (data != 0 ? chunk->len : 0));
+      copy->pool = NULL;
+      pool_release(chunk->pool, chunk);
+      chunk = *link = copy;
+    }
+    link = &chunk->next;
+    last = chunk;
+  }
+  conn->write_tail = last;
+}
+
+void conn_detach(conn_t *conn) {
+  // NOTE: Anything still queued stays queued, and is written out once the
+  // connection has been attached again.
+  conn_batch_remove(conn);
+  conn_unpool(conn);
+  conn->is_corked = FALSE;
+  conn->batch = NULL;
+  if (conn->reactor == -1)
+    return;
+  reactor_del(conn->reactor, conn->socket);
+  conn->reactor = -1;
+  conn->events = 0;
+}
+
+static void conn_release_frame(conn_t *conn) {
+  if (conn->is_holding) {
+    conn->read_buf[conn->read_start] = conn->held_byte;
+    conn->is_holding = FALSE;
+  }
+}
+
+int conn_read(conn_t *conn) {
+  conn_release_frame(conn);
+
+  // Move whatever is left of a partial frame to the front of the buffer
+  if (conn->read_start > 0) {
+    memmove(conn->read_buf, conn->read_buf + conn->read_start,
+            conn->read_len - conn->read_start);
+    conn->read_len -= conn->read_start;
+    conn->read_start = 0;
+  }
+
+  // NOTE: We always keep one byte spare, so that the last frame can be NULL
+  // terminated.
+  if (conn->read_cap - conn->read_len < CONN_READ_SIZE + 1) {
+    conn->read_cap = conn->read_len + CONN_READ_SIZE + 1;
+    conn->read_buf = realloc(conn->read_buf, conn->read_cap);
+  }
+
+  ssize_t received = recv(conn->socket, conn->read_buf + conn->read_len,
+                          CONN_READ_SIZE, 0);
+  if (received > 0)
+    conn->read_len += received;
+  return received;
+}
+
+int conn_next_frame(conn_t *conn, char **frame) {
+  conn_release_frame(conn);
+
+  size_t available = conn->read_len - conn->read_start;
+  if (available < (size_t)CONN_HEADER_SIZE)
+    return CONN_FRAME_INCOMPLETE;
+
+  int len;
+  memcpy(&len, conn->read_buf + conn->read_start, CONN_HEADER_SIZE);
+  if (len <= 0 || len > CONN_MAX_FRAME)
+    return CONN_FRAME_INVALID;
+  if (available < (size_t)(CONN_HEADER_SIZE + len))
+    return CONN_FRAME_INCOMPLETE;
+
+  *frame = conn->read_buf + conn->read_start + CONN_HEADER_SIZE;
+  conn->read_start += CONN_HEADER_SIZE + len;
+
+  // Terminate the frame in place, the byte is given back on the next call.
+  conn->held_byte = conn->read_buf[conn->read_start];
+  conn->read_buf[conn->read_start] = '\0';
+  conn->is_holding = TRUE;
+  return len;
+}
+
+static void conn_append_chunk(conn_t *conn, conn_chunk *chunk) {
+  if (conn->write_tail == NULL)
+    conn->write_head = conn->write_tail = chunk;
+  else
+    conn->write_tail = conn->write_tail->next = chunk;
+}
+
+// Takes a chunk with room for `cap` bytes of data from `pool` (which has to
+// fit that many), or mallocs it if there is no pool.
+static conn_chunk *conn_chunk_alloc(pool_t *pool, size_t cap) {
+  conn_chunk *chunk =
+      pool != NULL ? pool_alloc(pool) : malloc(sizeof(conn_chunk) + cap);
+  chunk->next = NULL;
+  chunk->pool = pool;
+  return chunk;
+}
+
+// Returns a chunk with at least `len` bytes free at the end of the queue.
+static conn_chunk *conn_reserve(conn_t *conn, size_t len) {
+  conn_chunk *tail = conn->write_tail;
+  if (tail != NULL && tail->cap - tail->len >= len)
+    return tail;
+
+  // NOTE: Only chunks of the default size are pooled, anything bigger is rare
+  // enough to be malloc'd.
+  size_t cap = len > CONN_CHUNK_SIZE ? len : CONN_CHUNK_SIZE;
+  pool_t *pool = NULL;
+  if (conn->batch != NULL && cap == CONN_CHUNK_SIZE)
+    pool = conn->batch->chunks;
+  conn_chunk *chunk = conn_chunk_alloc(pool, cap);
+  chunk->cap = cap;
+  chunk->len = chunk->sent = 0;
+  chunk->shared = NULL;
+  conn_append_chunk(conn, chunk);
+  return chunk;
+}
+
+static void conn_chunk_free(conn_chunk *chunk) {
+  if (chunk->shared != NULL)
+    conn_shared_release(chunk->shared);
+  if (chunk->pool != NULL)
+    pool_release(chunk->pool, chunk);
+  else
+    free(chunk);
+}
+
+static void conn_drop_queue(conn_t *conn);
+
+// Whether `len` more bytes can be queued. If not, the connection overflows.
+static BOOL conn_has_room(conn_t *conn, size_t len) {
+  if (conn->congestion == CONN_OVERFLOWED)
+    return FALSE;
+  if (conn->write_queued + len <= CONN_MAX_QUEUED)
+    return TRUE;
+  // NOTE: The peer isn't going to get a stream that makes sense anymore, so
+  // the memory is let go of straight away.
+  conn_drop_queue(conn);
+  conn_update_events(conn);
+  conn_set_congestion(conn, CONN_OVERFLOWED);
+  return FALSE;
+}
+
+char *conn_frame_begin(conn_t *conn, int max_length) {
+  if (conn->socket == -1 || max_length < 0 ||
+      !conn_has_room(conn, CONN_HEADER_SIZE + max_length))
+    return NULL;
+
+  // Frames are appended to the last chunk while there is space, so a batch
+  // of small frames ends up in one buffer.
+  conn_chunk *chunk = conn_reserve(conn, CONN_HEADER_SIZE + max_length);
+  return chunk->data + chunk->len + CONN_HEADER_SIZE;
+}
+
+// Called once `len` more bytes have been queued, to write them out (or join
+// the batch, which writes them out later).
+static int conn_queued(conn_t *conn, size_t len) {
+  conn->write_queued += len;
+
+  if (conn->batch != NULL && !conn->is_batched) {
+    conn_cork(conn);
+    conn->batch_prev = NULL;
+    conn->batch_next = conn->batch->head;
+    if (conn->batch->head != NULL)
+      conn->batch->head->batch_prev = conn;
+    conn->batch->head = conn;
+    conn->is_batched = TRUE;
+  }
+
+  if (conn->is_corked) {
+    conn_check_watermarks(conn);
+    return 0;
+  }
+  return conn_flush(conn) == -1 ? -1 : 0;
+}
+
+int conn_frame_end(conn_t *conn, int length) {
+  conn_chunk *chunk = conn->write_tail;
+  memcpy(chunk->data + chunk->len, &length, CONN_HEADER_SIZE);
+  chunk->len += CONN_HEADER_SIZE + length;
+  return conn_queued(conn, CONN_HEADER_SIZE + length);
+}
+
+int conn_send(conn_t *conn, const void *data, int data_length) {
+  char *frame = conn_frame_begin(conn, data_length);
+  if (frame == NULL)
+    return -1;
+  memcpy(frame, data, data_length);
+  return conn_frame_end(conn, data_length);
+}
+
+conn_shared *conn_shared_init(size_t cap) {
+  conn_shared *shared = malloc(sizeof(conn_shared) + cap);
+  atomic_init(&shared->refs, 1);
+  shared->cap = cap;
+  shared->len = 0;
+  return shared;
+}
+
+int conn_shared_append(conn_shared *shared, const void *data, int length) {
+  if (length < 0 ||
+      shared->cap - shared->len < CONN_HEADER_SIZE + (size_t)length)
+    return -1;
+  memcpy(shared->data + shared->len, &length, CONN_HEADER_SIZE);
+  memcpy(shared->data + shared->len + CONN_HEADER_SIZE, data, length);
+  shared->len += CONN_HEADER_SIZE + length;
+  return 0;
+}
+
+conn_shared *conn_shared_retain(conn_shared *shared) {
+  atomic_fetch_add_explicit(&shared->refs, 1, memory_order_relaxed);
+  return shared;
+}
+
+void conn_shared_release(conn_shared *shared) {
+  if (shared == NULL)
+    return;
+  if (atomic_fetch_sub_explicit(&shared->refs, 1, memory_order_acq_rel) == 1)
+    free(shared);
+}
+
+int conn_send_shared(conn_t *conn, conn_shared *shared) {
+  if (conn->socket == -1 || !conn_has_room(conn, shared->len))
+    return -1;
+  if (shared->len == 0)
+    return 0;
+
+  // NOTE: The chunk is full from the start, so the next frame goes into a
+  // chunk of its own rather than into the shared buffer.
+  conn_chunk *chunk =
+      conn_chunk_alloc(conn->batch != NULL ? conn->batch->shared_chunks : NULL,
+                       0);
+  chunk->cap = chunk->len = shared->len;
+  chunk->sent = 0;
+  chunk->shared = conn_shared_retain(shared);
+  conn_append_chunk(conn, chunk);
+  return conn_queued(conn, shared->len);
+}
+
+void conn_batch_init(conn_batch *batch) {
+  batch->head = NULL;
+  batch->chunks = pool_init(sizeof(conn_chunk) + CONN_CHUNK_SIZE, 0);
+  batch->shared_chunks = pool_init(sizeof(conn_chunk), 0);
+}
+
+void conn_batch_free(conn_batch *batch) {
+  if (batch->chunks != NULL)
+    pool_free(batch->chunks);
+  if (batch->shared_chunks != NULL)
+    pool_free(batch->shared_chunks);
+  batch->chunks = batch->shared_chunks = NULL;
+}
+
+void conn_cork(conn_t *conn) { conn->is_corked = TRUE; }
+
+int conn_uncork(conn_t *conn) {
+  conn->is_corked = FALSE;
+  return conn_flush(conn);
+}
+
+void conn_batch_flush(conn_batch *batch) {
+  while (batch->head != NULL) {
+    conn_t *conn = batch->head;
+    conn_batch_remove(conn);
+    conn_uncork(conn);
+  }
+}
+
+static void conn_drop_queue(conn_t *conn) {
+  conn_chunk *chunk = conn->write_head;
+  while (chunk != NULL) {
+    conn_chunk *next = chunk->next;
+    conn_chunk_free(chunk);
+    chunk = next;
+  }
+  conn->write_head = conn->write_tail = NULL;
+  conn->write_queued = 0;
+}
+
+int conn_flush(conn_t *conn) {
+  while (conn->write_head != NULL) {
+    struct iovec iov[CONN_MAX_IOV];
+    int iov_count = 0;
+    for (conn_chunk *chunk = conn->write_head;
+         chunk != NULL && iov_count < CONN_MAX_IOV; chunk = chunk->next) {
+      char *data = chunk->shared != NULL ? chunk->shared->data : chunk->data;
+      iov[iov_count].iov_base = data + chunk->sent;
+      iov[iov_count].iov_len = chunk->len - chunk->sent;
+      iov_count++;
+    }
+
+    struct msghdr message = {.msg_iov = iov, .msg_iovlen = iov_count};
+    ssize_t written = sendmsg(conn->socket, &message, CONN_SEND_FLAGS);
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      // The peer has gone away, we'll find out about it when reading.
+      conn_drop_queue(conn);
+      conn_update_events(conn);
+      conn_check_watermarks(conn);
+      return -1;
+    }
+
+    conn->write_queued -= written;
+    // NOTE: This also drops any empty chunks (from a frame that was begun but
+    // never ended).
+    while (conn->write_head != NULL) {
+      conn_chunk *chunk = conn->write_head;
+      size_t remaining = chunk->len - chunk->sent;
+      if ((size_t)written < remaining) {
+        chunk->sent += written;
+        break;
+      }
+      written -= remaining;
+      conn->write_head = chunk->next;
+      conn_chunk_free(chunk);
+    }
+    if (conn->write_head == NULL)
+      conn->write_tail = NULL;
+  }
+
+  conn_update_events(conn);
+  conn_check_watermarks(conn);
+  return conn->write_queued > 0 ? 1 : 0;
+}
+
+int conn_rtt(conn_t *conn) {
+#if defined(TCP_INFO)
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+  if (getsockopt(conn->socket, IPPROTO_TCP, TCP_INFO, &info, &len) == -1)
+    return -1;
+  return info.tcpi_rtt / 1000; // It's in microseconds
+#elif defined(TCP_CONNECTION_INFO)
+  struct tcp_connection_info info;
+  socklen_t len = sizeof(info);
+  if (getsockopt(conn->socket, IPPROTO_TCP, TCP_CONNECTION_INFO, &info,
+                 &len) == -1)
+    return -1;
+  return info.tcpi_srtt;
+#else
+  return -1;
+#endif
+}
+
+void conn_free(conn_t *conn) {
+  if (conn == NULL)
+    return;
+  conn_drop_queue(conn);
+  free(conn->read_buf);
+  free(conn);
+}
@@ -0,0 +1,83 @@
+#include "lib/id_alloc.h"
+
+#define WORD_BITS 64
+
+id_allocator *id_allocator_init(int capacity) {
+  id_allocator *ids = calloc(1, sizeof(id_allocator));
+  ids->capacity = capacity;
+  ids->used = 0;
+
+  // Build the levels from the bottom up until a single word covers them all
+  int bits = capacity;
+  do {
+    int words = (bits + WORD_BITS - 1) / WORD_BITS;
+    uint64_t *level = calloc(words, sizeof(uint64_t));
+    // Mark the first `bits` bits as free, and leave the rest of the last word
+    // as used so that we never hand them out.
+    for (int i = 0; i < bits / WORD_BITS; ++i)
+      level[i] = UINT64_MAX;
+    if (bits % WORD_BITS != 0)
+      level[words - 1] = (1ULL << (bits % WORD_BITS)) - 1;
+    ids->levels[ids->level_count++] = level;
+    bits = words;
+  } while (bits > 1 && ids->level_count < ID_ALLOC_MAX_LEVELS);
+
+  return ids;
+}
+
+void id_allocator_free(id_allocator *ids) {
+  for (int i = 0; i < ids->level_count; ++i)
+    free(ids->levels[i]);
+  free(ids);
+}
+
+int id_alloc(id_allocator *ids) {
+  if (id_allocator_is_full(ids))
+    return -1;
+
+  // Walk down from the top, always taking the lowest word with a free ID
+  int index = 0;
+  for (int level = ids->level_count - 1; level >= 0; --level) {
+    uint64_t word = ids->levels[level][index];
+    if (word == 0)
+      return -1; // NOTE: Only possible if the capacity is beyond the levels
+    index = index * WORD_BITS + __builtin_ctzll(word);
+  }
+
+  // Mark it as used, and carry on up while the words become full
+  int bit = index;
+  for (int level = 0; level < ids->level_count; ++level) {
+    uint64_t *word = &ids->levels[level][bit / WORD_BITS];
+    *word &= ~(1ULL << (bit % WORD_BITS));
+    if (*word != 0)
+      break;
+    bit /= WORD_BITS;
+  }
+
+  ids->used++;
+  return index + 1;
+}
+
+void id_release(id_allocator *ids, int id) {
+  int bit = id - 1;
+  if (bit < 0 || bit >= ids->capacity)
+    return;
+  if (ids->levels[0][bit / WORD_BITS] & (1ULL << (bit % WORD_BITS)))
+    return; // It is already free
+
+  // Mark it as free, and carry on up while the words were full before
+  for (int level = 0; level < ids->level_count; ++level) {
+    uint64_t *word = &ids->levels[level][bit / WORD_BITS];
+    BOOL was_full = *word == 0;
+    *word |= 1ULL << (bit % WORD_BITS);
+    if (!was_full)
+      break;
+    bit /= WORD_BITS;
+  }
+
+  ids->used--;
+}
+
+BOOL id_allocator_is_full(id_allocator *ids) {
+  return ids->used >= ids->capacity;
+}
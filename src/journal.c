@@ -0,0 +1,269 @@
+#include "lib/journal.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// FNV-1a, which is plenty to notice a record that was cut off
+static uint32_t journal_checksum(const char *data, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= (uint8_t)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Reads the header of the record at `offset`, which is FALSE if there isn't
+// a whole (valid) record there.
+// NOTE: Records aren't aligned, so the header is copied out.
+static BOOL journal_record(const journal_t *journal, size_t offset,
+                           journal_header *header) {
+  if (journal->size - offset < sizeof(journal_header))
+    return FALSE;
+  memcpy(header, journal->map + offset, sizeof(journal_header));
+  size_t end = offset + sizeof(journal_header) + header->length;
+  if (header->type < JOURNAL_CREATE || header->type > JOURNAL_SECRET ||
+      end > journal->size)
+    return FALSE;
+  return journal_checksum(journal->map + offset + sizeof(uint32_t),
+                          end - offset - sizeof(uint32_t)) == header->checksum;
+}
+
+static int journal_grow(journal_t *journal, size_t needed) {
+  size_t size = journal->size;
+  while (size < needed)
+    size += JOURNAL_GROWTH;
+  if (size > JOURNAL_MAX_SIZE || ftruncate(journal->fd, size) == -1)
+    return -1;
+  journal->size = size;
+  return 0;
+}
+
+journal_t *journal_open(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1)
+    return NULL;
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return NULL;
+  }
+
+  journal_t *journal = calloc(1, sizeof(journal_t));
+  journal->fd = fd;
+  journal->size = info.st_size;
+  journal->map = mmap(NULL, JOURNAL_MAX_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  if (journal->map == MAP_FAILED ||
+      (journal->size < JOURNAL_GROWTH && journal_grow(journal, 1) == -1)) {
+    if (journal->map != MAP_FAILED)
+      munmap(journal->map, JOURNAL_MAX_SIZE);
+    close(fd);
+    free(journal);
+    return NULL;
+  }
+
+  journal_header header;
+  while (journal_record(journal, journal->len, &header))
+    journal->len += sizeof(journal_header) + header.length;
+  journal->synced = journal->len;
+  journal->interval = JOURNAL_COMMIT_INTERVAL;
+  pthread_mutex_init(&journal->lock, NULL);
+  pthread_cond_init(&journal->wake, NULL);
+  return journal;
+}
+
+static void *journal_thread(void *arg) {
+  journal_t *journal = arg;
+  pthread_mutex_lock(&journal->lock);
+  while (journal->is_running) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += (long)journal->interval * 1000000;
+    until.tv_sec += until.tv_nsec / 1000000000;
+    until.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&journal->wake, &journal->lock, &until);
+
+    pthread_mutex_unlock(&journal->lock);
+    journal_commit(journal);
+    pthread_mutex_lock(&journal->lock);
+  }
+  pthread_mutex_unlock(&journal->lock);
+  return NULL;
+}
+
+void journal_start(journal_t *journal, int interval) {
+  journal->interval = interval > 0 ? interval : JOURNAL_COMMIT_INTERVAL;
+  journal->is_running = TRUE;
+  pthread_create(&journal->thread, NULL, journal_thread, journal);
+}
+
+void journal_close(journal_t *journal) {
+  pthread_mutex_lock(&journal->lock);
+  BOOL was_running = journal->is_running;
+  journal->is_running = FALSE;
+  pthread_cond_signal(&journal->wake);
+  pthread_mutex_unlock(&journal->lock);
+  if (was_running)
+    pthread_join(journal->thread, NULL);
+
+  journal_commit(journal);
+  munmap(journal->map, JOURNAL_MAX_SIZE);
+  close(journal->fd);
+  pthread_mutex_destroy(&journal->lock);
+  pthread_cond_destroy(&journal->wake);
+  free(journal);
+}
+
+int journal_append(journal_t *journal, int type, uint32_t game,
+                   const void *payload, int length) {
+  if (length < 0 || length > UINT16_MAX)
+    return -1;
+  journal_header header = {
+      .game = game, .length = length, .type = type, .unused = 0};
+  size_t total = sizeof(header) + length;
+
+  pthread_mutex_lock(&journal->lock);
+  if (journal->len + total > journal->size &&
+      journal_grow(journal, journal->len + total) == -1) {
+    pthread_mutex_unlock(&journal->lock);
+    return -1;
+  }
+  char *record = journal->map + journal->len;
+  memcpy(record, &header, sizeof(header));
+  memcpy(record + sizeof(header), payload, length);
+  header.checksum = journal_checksum(record + sizeof(uint32_t),
+                                     total - sizeof(uint32_t));
+  memcpy(record, &header.checksum, sizeof(uint32_t));
+  journal->len += total;
+  pthread_mutex_unlock(&journal->lock);
+  return 0;
+}
+
+int journal_commit(journal_t *journal) {
+  pthread_mutex_lock(&journal->lock);
+  size_t from = journal->synced, to = journal->len;
+  pthread_mutex_unlock(&journal->lock);
+  if (from == to)
+    return 0;
+
+  // NOTE: The map never moves, so it's written out without holding the lock
+  // (anything appended in the meantime goes out with the next commit).
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t start = from / page * page;
+  if (msync(journal->map + start, to - start, MS_SYNC) == -1)
+    return -1;
+
+  pthread_mutex_lock(&journal->lock);
+  if (to > journal->synced)
+    journal->synced = to;
+  pthread_mutex_unlock(&journal->lock);
+  return 0;
+}
+
+journal_game *journal_replay(journal_t *journal, int *count) {
+  int capacity = 16, total = 0;
+  journal_game *games = malloc(capacity * sizeof(journal_game));
+  BOOL *is_live = malloc(capacity * sizeof(BOOL));
+  // The index (into `games`) of each game, by its ID
+  HashMap indices = new_hashmap(INITIAL_MAP_SIZE);
+
+  journal_header header;
+  for (size_t offset = 0; offset < journal->len &&
+                          journal_record(journal, offset, &header);
+       offset += sizeof(journal_header) + header.length) {
+    const char *payload = journal->map + offset + sizeof(journal_header);
+    int index = get(indices, header.game).err;
+
+    if (header.type == JOURNAL_CREATE && index == NO_VALUE) {
+      if (total == capacity) {
+        capacity *= 2;
+        games = realloc(games, capacity * sizeof(journal_game));
+        is_live = realloc(is_live, capacity * sizeof(BOOL));
+      }
+      games[total] = (journal_game){.id = header.game};
+      games[total].names[0] = strndup(payload, header.length);
+      is_live[total] = TRUE;
+      put(&indices, header.game, (BucketValue){.i_value = total});
+      total++;
+      continue;
+    }
+    if (index == NO_VALUE || !is_live[index])
+      continue;
+
+    journal_game *game = &games[index];
+    if (header.type == JOURNAL_JOIN && game->names[1] == NULL) {
+      game->names[1] = strndup(payload, header.length);
+    } else if (header.type == JOURNAL_MOVE && header.length == 1 &&
+               game->names[1] != NULL) {
+      int outcome =
+          board_play(&game->board, game->turn, (uint8_t)payload[0]);
+      if (outcome == BOARD_PLAYING)
+        game->turn ^= 1;
+      else if (outcome != -1)
+        is_live[index] = FALSE; // It ended with that move
+    } else if (header.type == JOURNAL_SECRET &&
+               header.length == JOURNAL_SECRET_SIZE && (uint8_t)payload[0] < 2) {
+      memcpy(&game->secrets[(uint8_t)payload[0]], payload + 1,
+             sizeof(uint64_t));
+    } else if (header.type == JOURNAL_END) {
+      is_live[index] = FALSE;
+    }
+  }
+
+  // Only the games that are still being played are kept
+  *count = 0;
+  for (int i = 0; i < total; ++i) {
+    if (is_live[i] && games[i].names[1] != NULL) {
+      games[(*count)++] = games[i];
+    } else {
+      free(games[i].names[0]);
+      free(games[i].names[1]);
+    }
+  }
+  free(is_live);
+  free_hashmap(&indices);
+  return games;
+}
+
+void journal_games_free(journal_game *games, int count) {
+  for (int i = 0; i < count; ++i) {
+    free(games[i].names[0]);
+    free(games[i].names[1]);
+  }
+  free(games);
+}
+
+int journal_append_secret(journal_t *journal, uint32_t game, int seat,
+                          uint64_t secret) {
+  char payload[JOURNAL_SECRET_SIZE] = {seat};
+  memcpy(payload + 1, &secret, sizeof(secret));
+  return journal_append(journal, JOURNAL_SECRET, game, payload,
+                        sizeof(payload));
+}
+
+int journal_append_game(journal_t *journal, const journal_game *game) {
+  int status = 0;
+  for (int i = 0; i < 2; ++i) {
+    status |= journal_append(journal, i == 0 ? JOURNAL_CREATE : JOURNAL_JOIN,
+                             game->id, game->names[i],
+                             strlen(game->names[i]));
+    if (game->secrets[i] != 0)
+      status |= journal_append_secret(journal, game->id, i, game->secrets[i]);
+  }
+
+  int cells[2][BOARD_CELLS], counts[2] = {0, 0};
+  for (int cell = 1; cell <= BOARD_CELLS; ++cell) {
+    int bit = board_bit(cell);
+    for (int player = 0; player < 2; ++player)
+      if (game->board.pieces[player].words[bit / 64] >> (bit % 64) & 1)
+        cells[player][counts[player]++] = cell;
+  }
+  for (int i = 0; i < counts[0] + counts[1]; ++i) {
+    uint8_t cell = cells[i % 2][i / 2];
+    status |= journal_append(journal, JOURNAL_MOVE, game->id, &cell, 1);
+  }
+  return status;
+}
@@ -0,0 +1,139 @@
+#ifndef NOUGHTS_CROSSES_BOARD_H
+#define NOUGHTS_CROSSES_BOARD_H
+
+#include "utils.h"
+#include "wire.h"
+#include <stdint.h>
+
+// The board of a game, which the server keeps so that it is the one deciding
+// whether a move is allowed and when the game is over (the clients only draw
+// what they're told).
+//
+// The board is BOARD_SIZE cells across & down, and a player wins with
+// BOARD_WIN_LENGTH of their pieces in a row (across, down or diagonally),
+// e.g. `-DBOARD_SIZE=15 -DBOARD_WIN_LENGTH=5` for gomoku. Both are fixed when
+// compiling, and the server & the client must agree on them.
+//
+// The pieces of each player are a bitboard, where the cell at (row, col) is
+// bit `row * BOARD_STRIDE + col`. Each row has a bit to spare at the end,
+// which is never set, so that a line can't carry on from the end of one row
+// into the next.
+//
+// The board had no line on it before a move, so a new one has to go through
+// the cell that was just played. Only the four lines through it are looked
+// at, a cell at a time out to BOARD_WIN_LENGTH - 1 either side (see
+// `board_has_line_through`), and a draw is found from how many cells have
+// been taken. So a move costs the same however big the board is.
+//
+// The classic 3x3 board is a single word, and is instead checked against the
+// masks of the lines through the cell, which is decided at compile time.
+
+#ifndef BOARD_SIZE
+#define BOARD_SIZE 3
+#endif
+
+#ifndef BOARD_WIN_LENGTH
+#define BOARD_WIN_LENGTH 3
+#endif
+
+// NOTE: Cells are sent as a single byte, from 1 (see GAME_SIG_MOVE).
+#define BOARD_MAX_SIZE 15
+#if BOARD_SIZE > BOARD_MAX_SIZE
+#error "BOARD_SIZE must be at most BOARD_MAX_SIZE"
+#endif
+#if BOARD_WIN_LENGTH > BOARD_SIZE || BOARD_WIN_LENGTH < 2
+#error "BOARD_WIN_LENGTH must fit on the board"
+#endif
+
+#if BOARD_SIZE == 3 && BOARD_WIN_LENGTH == 3
+#define BOARD_IS_CLASSIC
+#endif
+
+#define BOARD_CELLS (BOARD_SIZE * BOARD_SIZE)
+#define BOARD_STRIDE (BOARD_SIZE + 1)
+#define BOARD_WORDS_FOR(size) ((((size) + 1) * (size) + 63) / 64)
+#define BOARD_WORDS BOARD_WORDS_FOR(BOARD_SIZE)
+#define BOARD_MAX_WORDS BOARD_WORDS_FOR(BOARD_MAX_SIZE)
+
+typedef struct {
+  uint64_t words[BOARD_WORDS];
+} board_mask;
+
+typedef struct {
+  board_mask pieces[2]; // In the same order as the players of the game
+  int taken; // How many cells have a piece in them, which is BOARD_CELLS once
+             // the board is full
+} board_t;
+
+enum BOARD_OUTCOME {
+  BOARD_PLAYING, // Nobody has won yet & there are cells left
+  BOARD_WON,     // By whoever made the move
+  BOARD_DRAWN,
+};
+
+/**
+ * @brief The bit of a cell (1 to BOARD_CELLS) in `board_mask.words`.
+ */
+int board_bit(int cell);
+
+/**
+ * @brief Whether the pieces have BOARD_WIN_LENGTH of them in a row going
+ * through the cell.
+ */
+BOOL board_is_won_at(const board_mask *pieces, int cell);
+
+/**
+ * @brief Whether a bitboard of any size (laid out as described above, for a
+ * board `size` cells across) has `length` of its bits in a row going through
+ * the cell. This is the check that `board_is_won_at` makes for anything other
+ * than the classic board.
+ *
+ * @param cell 1 to `size * size`, which must be set
+ */
+BOOL board_has_line_through(const uint64_t *words, int size, int length,
+                            int cell);
+
+/**
+ * @brief Whether a bitboard of any size has `length` of its bits in a row
+ * anywhere. It shifts the pieces along each direction and ANDs them together,
+ * so the board is checked a word at a time.
+ * NOTE: The server only ever uses `board_has_line_through`. This looks at the
+ * whole board in a different way, which is what the tests check the lines
+ * through each move against.
+ *
+ * @param words BOARD_WORDS_FOR(size) of them
+ */
+BOOL board_has_line(const uint64_t *words, int size, int length);
+
+/**
+ * @brief Puts the player's piece into a cell.
+ * NOTE: Whose turn it is is left up to the caller.
+ *
+ * @param player 0 or 1
+ * @param cell 1 to BOARD_CELLS, going along the rows
+ * @return The outcome (BOARD_OUTCOME) of the game after the move, or -1 if
+ * the cell isn't on the board or has already been taken (in which case the
+ * board is left as it was)
+ */
+int board_play(board_t *board, int player, int cell);
+
+// How many columns the number of a cell takes up on the screen
+#define BOARD_LABEL_WIDTH (BOARD_CELLS >= 100 ? 3 : BOARD_CELLS >= 10 ? 2 : 1)
+// The most that the text of a cell can be (a label or a piece, with its
+// colour)
+#define BOARD_CELL_TEXT_SIZE (16 + BOARD_LABEL_WIDTH)
+// The most that `board_draw` writes (including the terminator)
+#define BOARD_TEXT_SIZE                                                        \
+  (BOARD_CELLS * (BOARD_CELL_TEXT_SIZE + BOARD_LABEL_WIDTH + 6) +             \
+   2 * BOARD_SIZE + 1)
+
+/**
+ * @brief Draws the board as text, a row to a line.
+ *
+ * @param cells The text of each cell (`cells[0]` is cell 1), which must be
+ * BOARD_LABEL_WIDTH columns wide. NULL draws the number of the cell instead.
+ * @return The length of the text, or -1 if it doesn't fit into `cap`
+ */
+int board_draw(char *out, size_t cap, char *const *cells);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef NOUGHTS_CROSSES_BOT_H
+#define NOUGHTS_CROSSES_BOT_H
+
+#include "board.h"
+#include "utils.h"
+#include <stdint.h>
+
+// The opponent that the server puts into a game that nobody has joined for a
+// while (see BOT_TIMEOUT_ENV).
+//
+// On the classic board the bot plays perfectly. Every position that can come
+// up is solved once when starting up (see `bot_init`) by a negamax search, and
+// its score is kept in a table, so a move is just a lookup for each free cell.
+// A position is only kept once for all 8 ways of turning or flipping the
+// board, as they all have the same score: the key of a position is the
+// smallest of its 8 keys. That leaves the table at 3^9 bytes, one per board
+// that each cell being empty, the mover's or the other player's could make.
+//
+// Scores are from the point of view of whoever is to move, a win is worth
+// more the sooner it comes (so the bot doesn't put off winning), and a loss
+// costs less the later it comes.
+//
+// Any other board has far too many positions to solve, so the bot wins if it
+// can, stops the other player from winning if it has to, and otherwise plays
+// as close to the middle of the board as it can.
+
+/**
+ * @brief Solves the classic board. It has to be called (once, from a single
+ * thread) before the bot is asked for a move, after which the table is only
+ * ever read so any thread can use it.
+ */
+void bot_init();
+
+/**
+ * @brief The cell that the bot would play next.
+ *
+ * @param player Whose move it is (0 or 1)
+ * @return The cell (1 to BOARD_CELLS), or -1 if the board is full
+ */
+int bot_move(const board_t *board, int player);
+
+#ifdef BOARD_IS_CLASSIC
+/**
+ * @brief The score (as described above) of a position on the classic board,
+ * for whoever is to move.
+ *
+ * @param mine The cells of whoever is to move, with cell `n` as bit `n - 1`
+ * @param theirs The cells of the other player
+ */
+int bot_score(uint16_t mine, uint16_t theirs);
+#endif
+
+#endif
@@ -1,8 +1,13 @@
 #ifndef NOUGHTS_CROSSES_CLIENT_H
 #define NOUGHTS_CROSSES_CLIENT_H
+#include "board.h"
+#include "matchmaker.h"
 #include "resources.h"
+#include "slot_map.h"
 #include "utils.h"
+#include "wire.h"
 #include <arpa/inet.h>
+#include <limits.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -18,6 +23,8 @@
 #define TCP 0
 #define RECONNECT_INTERVAL                                                     \
   1 // This is the amount of seconds inbetween reconnect attempts
+// How many times we try to connect again after our connection drops
+#define RESUME_ATTEMPTS 10
 
 const uint8_t MAX_CLIENT_NAME_LENGTH = 24;
 
@@ -39,9 +46,6 @@ const uint8_t MAX_CLIENT_NAME_LENGTH = 24;
 #define ESC_KEY 27
 #endif
 
-static struct termios restore;
-static struct termios noughts_crosses_term;
-
 void hide_term_cursor();
 void show_term_cursor();
 
@@ -52,58 +56,129 @@ void disable_raw_term();
 
 client_t *client_init();
 int client_connect(int server_fd, client_t *client);
+
+/**
+ * @brief Connects again after our connection has dropped, and asks the
+ * server to put us back where we were with `token` (see RESUME_FLAG).
+ *
+ * @return 0 once the token has been sent, -1 if we couldn't get back through
+ */
+int client_resume(client_t *client, const char *token);
 void client_disconnect(client_t *client);
 
-#define BOARD_WIDTH 3
+#define BOARD_WIDTH BOARD_SIZE
 
 typedef enum { PLAYER = 0, ENEMY = 1, SERVER = 2 } Source;
 typedef struct board_piece {
-  char piece;
+  int piece;          // The number of the cell
   Source type;        // In this instance, SERVER are uninitialised pieces.
-  char *print_string; // The coloured string that is output.
+  char *print_string; // The coloured string that is output (NULL until a
+                      // piece is put there, so the number is drawn).
 } board_piece;
 
-static board_piece board[BOARD_WIDTH][BOARD_WIDTH] = {0};
+#define intermediate_mem BOARD_CELL_TEXT_SIZE
+#define printable_board_mem                                                    \
+  (BOARD_TEXT_SIZE + sizeof("\r\n\x1b[2K\x1b[;1mIt is currently your turn.\x1b[;0m"))
 
-#define intermediate_mem (sizeof("\x1b[31;1m%s\x1b[0;0m"))
-#define board_mem (BOARD_WIDTH * BOARD_WIDTH * intermediate_mem)
-#define printable_board_mem (sizeof(board_template) + board_mem)
-
-static char printable_board[printable_board_mem + 1]; // Each time we want
-                                                      // to print, we will
-// iterate over `board_template` and replace the %s with the correct string from
-// the board.
-static char intermediate[intermediate_mem + 1] = {0};
+// The largest frame that we can be sent, which has to fit the empty board
+#define CLIENT_BUFFER_SIZE                                                     \
+  (BOARD_TEXT_SIZE + 2 > 1024 ? BOARD_TEXT_SIZE + 2 : 1024)
 
 typedef struct {
   /* uint8_t game_id; */
   client_t *players[2];
-  /* LinkedList spectators; */
+  // NOTE: Only used by the server, which creates it when the first spectator
+  // arrives. Keyed by `client->spectator`.
+  slot_map spectators;
   BOOL isCurrentPlayerTurn; // Either 0 or 1
   BOOL validConnections;
   BOOL isFull;
+  // NOTE: These are only used by the server.
+  void *shard; // The shard of the host, which owns the game
+  int pending; // How many players are being handed over to the owning shard
+  match_entry waiting; // In the matchmaker, until someone joins
+  uint64_t handle; // In the registry of running games, once it has started
+  int lobby_id;    // Identifies the game on the games page
+  board_t board;   // NOTE: The clients only keep what they have been sent.
+  // Until somebody joins, when a bot joins it (or else it's closed)
+  wheel_timer lobby_timer;
+  wheel_timer clock; // How long whoever's turn it is has left to move
+  uint32_t id;       // Identifies the game in the journal (and to watchers)
+  // NOTE: These are guarded by the shared lock, so that any shard can tell
+  // whether the game is worth watching (see `handle_game_watch`).
+  BOOL has_bot;
+  int away_players; // From the journal, or being held on to
 } game_t;
 
-void view_active_games(int socket, client_t *client, serialized *s);
-void create_new_game(int socket, client_t *client, serialized *s);
-void setup_game_dep();
-void handle_game_input(
-    int socket, client_t *client, unsigned int position,
-    Source source); // Position is 1-9, we then break this down into
-                    // the 3x3 grid using MOD and DIV
-void update_board(int source);
+/**
+ * @brief Sends one of the frames that never change (see `wire_constants`),
+ * without allocating or encoding anything.
+ */
+int send_constant(int socket, wire_constant_id id);
+
+// A game on the games page, which the server keeps us up to date with (see
+// LOBBY_DELTA_FLAG)
+typedef struct {
+  int id;
+  char line[WIRE_MAX_STRING + 1];
+} lobby_game;
+
+/**
+ * @brief Applies a change to the games page that the server has sent us. The
+ * page isn't drawn again until `render_lobby` is called.
+ *
+ * @return TRUE if the page has to be asked for again, as games from the pages
+ * either side of it would have moved on to it
+ */
+BOOL apply_lobby_delta(char *buffer, int len);
+void render_lobby();
+
+/**
+ * @brief Asks the server for another page of games.
+ *
+ * @param kind LOBBY_PAGE_FROM or LOBBY_PAGE_BEFORE
+ * @param id The ID of the game that the page is relative to
+ */
+void request_lobby_page(int socket, int kind, int id);
 
-// Returns 0 if not, 1 if the game
-// has ended in a win and 2 if the game was a draw.
-int is_game_over(Source source);
+/**
+ * @brief Asks the server to let us watch a game.
+ *
+ * @param id The number of the game (as its players are shown it), or 0 for
+ * any game
+ */
+void watch_game(int socket, unsigned int id);
 
-#define IS_ROW_WON(row_num, source)                                            \
-  (board[row_num][0].type == source && board[row_num][1].type == source &&     \
-   board[row_num][2].type == source)
+void view_active_games(int socket, client_t *client);
+void create_new_game(int socket, client_t *client);
+/**
+ * @brief Clears the board for a new game.
+ *
+ * @param is_watching Whether we are only a spectator of the game
+ */
+void setup_game_dep(BOOL is_watching);
+/**
+ * @brief Handles a key that was pressed during a game. On the classic board a
+ * digit plays that cell straight away, otherwise the number of the cell is
+ * typed out and played with enter.
+ */
+void handle_game_key(int socket, client_t *client, char key);
+
+/**
+ * @brief Asks the server to put our piece into a cell. Nothing changes until
+ * the server has checked the move and sent it back (see `handle_game_move`).
+ *
+ * @param position 1 to BOARD_CELLS, which is broken down into the grid using
+ * MOD and DIV
+ */
+void handle_game_input(int socket, client_t *client, unsigned int position);
 
-#define IS_COL_WON(col_num, source)                                            \
-  (board[0][col_num].type == source && board[1][col_num].type == source &&     \
-   board[2][col_num].type == source)
+/**
+ * @brief Draws a move that the server has sent to both players, and says how
+ * the game ended if it has.
+ */
+void handle_game_move(client_t *client, const char *buffer, int len);
+void update_board(int source);
 
 #ifndef HANDLE_SOCK_ERROR_FN
 #define HANDLE_SOCK_ERROR_FN
@@ -115,5 +190,5 @@ int is_game_over(Source source);
 void handle_sock_error(int err);
 #endif
 
-void print_buffer(char *buf);
+void print_buffer(const char *buf);
 #endif
@@ -0,0 +1,286 @@
+#ifndef NOUGHTS_CROSSES_CONN_H
+#define NOUGHTS_CROSSES_CONN_H
+
+#include "pool.h"
+#include "utils.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A connection wraps a non-blocking socket with a read buffer and a write
+// queue. Every message on the wire is a frame, made of the length of the
+// payload (an `int`, the same as `smart_send`) followed by the payload itself.
+//
+// Frames are parsed incrementally from the read buffer, so it does not matter
+// how the kernel splits them up. Outgoing frames are queued and written with
+// a single `writev`, and anything that could not be written is retried once
+// the reactor tells us that the socket is writable again.
+//
+// The write queue is bounded, so that a peer that doesn't keep up with what
+// it's sent can't take up more and more memory. Once more than
+// CONN_HIGH_WATERMARK is queued the connection is congested, until it has
+// drained back down to CONN_LOW_WATERMARK (see `conn_on_congestion`), and a
+// connection that would go over CONN_MAX_QUEUED is overflowed for good.
+
+#ifndef CONN_HEADER_SIZE
+#define CONN_HEADER_SIZE ((int)sizeof(int))
+#endif
+
+// The largest payload we'll accept from a peer.
+#ifndef CONN_MAX_FRAME
+#define CONN_MAX_FRAME 1024
+#endif
+
+#ifndef CONN_READ_SIZE
+#define CONN_READ_SIZE 2048 // The amount we try to read in one go
+#endif
+
+// Frames are packed into chunks of (at least) this size, so that a screen
+// made of many small frames leaves in one piece.
+#ifndef CONN_CHUNK_SIZE
+#define CONN_CHUNK_SIZE 4096
+#endif
+
+#ifndef CONN_HIGH_WATERMARK
+#define CONN_HIGH_WATERMARK (64 * 1024)
+#endif
+
+#ifndef CONN_LOW_WATERMARK
+#define CONN_LOW_WATERMARK (16 * 1024)
+#endif
+
+#ifndef CONN_MAX_QUEUED
+#define CONN_MAX_QUEUED (1024 * 1024)
+#endif
+
+// How backed up the write queue of a connection is
+enum CONN_CONGESTION {
+  CONN_DRAINED,   // At most CONN_LOW_WATERMARK is queued (or it's on its way
+                  // up to the high watermark)
+  CONN_CONGESTED, // Over CONN_HIGH_WATERMARK, and it hasn't drained yet
+  CONN_OVERFLOWED, // The queue was dropped, as it would have gone over
+                   // CONN_MAX_QUEUED. Nothing more can be sent.
+};
+
+// The errors returned by `conn_next_frame`
+#define CONN_FRAME_INCOMPLETE 0
+#define CONN_FRAME_INVALID -1
+
+// An immutable buffer of whole frames (headers included) that can be queued
+// on any number of connections without being copied (see
+// `conn_send_shared`). It is freed once the last reference is released, which
+// may happen on any thread.
+typedef struct CONN_SHARED_T {
+  atomic_int refs;
+  size_t cap;
+  size_t len;
+  char data[];
+} conn_shared;
+
+typedef struct CONN_CHUNK_T {
+  struct CONN_CHUNK_T *next;
+  pool_t *pool; // The pool it came from (NULL if it was malloc'd)
+  size_t cap;  // The size of `data`
+  size_t len;  // How much of `data` is used (headers + payloads)
+  size_t sent; // How much of `data` has already been written
+  // If set, the chunk holds a reference to this buffer and writes it out in
+  // place of `data` (it is always full, so nothing is appended to it).
+  conn_shared *shared;
+  char data[];
+} conn_chunk;
+
+struct CONN_T;
+
+/**
+ * @brief Called whenever the connection moves from one CONN_CONGESTION to
+ * another, which can happen while anything is being sent or flushed.
+ * NOTE: The connection must not be freed from the callback.
+ */
+typedef void (*conn_congestion_callback)(struct CONN_T *conn, int congestion,
+                                         void *arg);
+
+// A batch collects the connections that have been written to, so that they
+// can all be flushed at once (e.g. at the end of an iteration of the event
+// loop). Connections in a batch are corked.
+//
+// A batch can also have pools (see `conn_batch_init`) that the connections
+// attached to it take their chunks from, so that sending a frame doesn't
+// have to call malloc. As the pools do no locking, the batch must only be
+// used by one thread, and a connection gives back any chunks it still has
+// from them when it's detached.
+typedef struct {
+  struct CONN_T *head;
+  pool_t *chunks;        // Chunks with CONN_CHUNK_SIZE bytes of data
+  pool_t *shared_chunks; // Chunks without any data (see `conn_send_shared`)
+} conn_batch;
+
+typedef struct CONN_T {
+  int socket;
+
+  // The reactor the socket is registered with (-1 if it isn't).
+  int reactor;
+  uint64_t token;
+  int events; // The events we're currently registered for
+
+  char *read_buf;
+  size_t read_start; // Offset of the first byte that hasn't been consumed
+  size_t read_len;   // Offset of the end of the data that has been read
+  size_t read_cap;
+  // The frame handed out by `conn_next_frame` is NULL terminated in place,
+  // this is the byte that was overwritten by the terminator.
+  char held_byte;
+  BOOL is_holding;
+
+  conn_chunk *write_head;
+  conn_chunk *write_tail;
+  size_t write_queued; // Bytes that are still waiting to be written
+  int congestion;      // One of CONN_CONGESTION
+  conn_congestion_callback on_congestion;
+  void *congestion_arg;
+
+  // While corked, frames are only queued up and nothing is written until the
+  // connection is uncorked.
+  BOOL is_corked;
+  conn_batch *batch; // The batch that we join whenever we are written to
+  struct CONN_T *batch_prev;
+  struct CONN_T *batch_next;
+  BOOL is_batched;
+} conn_t;
+
+conn_t *conn_init(int socket);
+
+/**
+ * @brief Sets up an empty batch with its own pools of chunks.
+ */
+void conn_batch_init(conn_batch *batch);
+
+/**
+ * @brief Frees the pools of the batch.
+ * NOTE: Every connection that was attached to it must have been detached or
+ * freed first.
+ */
+void conn_batch_free(conn_batch *batch);
+
+/**
+ * @brief Registers the connection with `reactor`. The connection will listen
+ * for writability by itself whenever it has queued data.
+ *
+ * @param batch If not NULL, anything sent is held back until the batch is
+ * flushed.
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int conn_attach(conn_t *conn, int reactor, uint64_t token, conn_batch *batch);
+void conn_detach(conn_t *conn);
+
+/**
+ * @brief Calls `callback` (with `arg`) whenever the congestion of the
+ * connection changes. NULL stops calling it.
+ */
+void conn_on_congestion(conn_t *conn, conn_congestion_callback callback,
+                        void *arg);
+
+/**
+ * @brief Reads whatever is available on the socket into the read buffer.
+ *
+ * @return The amount of bytes read, 0 if the peer has disconnected and -1 on
+ * failure (errno is EAGAIN if there was nothing to read)
+ */
+int conn_read(conn_t *conn);
+
+/**
+ * @brief Takes the next complete frame out of the read buffer. The frame is
+ * NULL terminated and stays valid until the next call to `conn_next_frame` or
+ * `conn_read`.
+ *
+ * @return The length of the payload, CONN_FRAME_INCOMPLETE (0) if there is no
+ * complete frame yet and CONN_FRAME_INVALID (-1) if the peer sent something
+ * that cannot be a frame.
+ */
+int conn_next_frame(conn_t *conn, char **frame);
+
+/**
+ * @brief Queues `data` as a single frame and tries to write out the queue
+ * (unless the connection is corked or part of a batch).
+ *
+ * @return 0 on success (even if some of it is still queued), -1 if the
+ * connection is broken or has overflowed (in which case nothing was queued)
+ */
+int conn_send(conn_t *conn, const void *data, int data_length);
+
+/**
+ * @brief Reserves room for a frame of up to `max_length` bytes at the end of
+ * the write queue, so that it can be encoded in place (see wire.h) instead
+ * of being copied in by `conn_send`.
+ *
+ * @return Where the payload goes, or NULL if the connection is broken (or
+ * overflowed)
+ */
+char *conn_frame_begin(conn_t *conn, int max_length);
+
+/**
+ * @brief Queues the frame started by `conn_frame_begin`, with the first
+ * `length` bytes as its payload. A frame that is never ended is just dropped.
+ *
+ * @return The same as `conn_send`
+ */
+int conn_frame_end(conn_t *conn, int length);
+
+/**
+ * @brief Creates a shared buffer with room for `cap` bytes, holding a single
+ * reference (the caller's).
+ */
+conn_shared *conn_shared_init(size_t cap);
+
+/**
+ * @brief Appends a frame of `length` bytes to `shared`.
+ *
+ * @return 0 on success, -1 if it doesn't fit
+ */
+int conn_shared_append(conn_shared *shared, const void *data, int length);
+
+conn_shared *conn_shared_retain(conn_shared *shared);
+void conn_shared_release(conn_shared *shared);
+
+/**
+ * @brief Queues the frames of `shared` by reference (it is retained until
+ * they have been written). The buffer must not be changed after this.
+ *
+ * @return The same as `conn_send`
+ */
+int conn_send_shared(conn_t *conn, conn_shared *shared);
+
+/**
+ * @brief Holds back everything sent until `conn_uncork` is called, which
+ * writes it all out together.
+ */
+void conn_cork(conn_t *conn);
+int conn_uncork(conn_t *conn);
+
+/**
+ * @brief Uncorks (and so flushes) every connection that was written to since
+ * the last call.
+ */
+void conn_batch_flush(conn_batch *batch);
+
+/**
+ * @brief Writes as much of the queue as the socket accepts.
+ *
+ * @return 0 if the queue is empty, 1 if some of it is still queued and -1 if
+ * the connection is broken
+ */
+int conn_flush(conn_t *conn);
+
+/**
+ * @brief The round trip time of the connection, as the kernel has measured
+ * it from the packets sent so far.
+ *
+ * @return The RTT in ms, or -1 if it isn't known
+ */
+int conn_rtt(conn_t *conn);
+
+/**
+ * @brief Frees the buffers of the connection. The socket is not closed.
+ */
+void conn_free(conn_t *conn);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef NOUGHTS_CROSSES_ID_ALLOC_H
+#define NOUGHTS_CROSSES_ID_ALLOC_H
+
+#include "utils.h"
+#include <stdint.h>
+
+// Hands out the lowest free ID in [1, capacity].
+//
+// The free IDs are kept in a hierarchical bitmap: a set bit in the bottom
+// level means that the ID is free, and a set bit in any of the levels above
+// means that the matching word below it has at least one free ID. Finding the
+// lowest free ID is a count-trailing-zeros per level (two levels cover 4096
+// IDs), rather than a walk over every ID that is in use.
+
+#ifndef ID_ALLOC_MAX_LEVELS
+#define ID_ALLOC_MAX_LEVELS 4 // Enough for 64^4 IDs
+#endif
+
+typedef struct {
+  uint64_t *levels[ID_ALLOC_MAX_LEVELS]; // levels[0] has one bit per ID
+  int level_count;
+  int capacity;
+  int used;
+} id_allocator;
+
+id_allocator *id_allocator_init(int capacity);
+void id_allocator_free(id_allocator *ids);
+
+/**
+ * @brief Takes the lowest free ID.
+ *
+ * @return The ID (starting from 1), or -1 if every ID is in use
+ */
+int id_alloc(id_allocator *ids);
+
+/**
+ * @brief Gives the ID back, so that it can be handed out again.
+ */
+void id_release(id_allocator *ids, int id);
+
+BOOL id_allocator_is_full(id_allocator *ids);
+
+#endif
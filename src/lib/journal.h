@@ -0,0 +1,146 @@
+#ifndef NOUGHTS_CROSSES_JOURNAL_H
+#define NOUGHTS_CROSSES_JOURNAL_H
+
+#include "board.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdint.h>
+
+// An append-only log of what has happened to every game (see JOURNAL_TYPE),
+// so that the games that were being played can be put back together after
+// the server has been restarted or has crashed (see `journal_replay`).
+//
+// The file is memory-mapped, and a record is appended by copying it into the
+// map. Nothing waits on the disk when appending: the records are written out
+// together every so often by a thread of their own (see `journal_start`),
+// so a crash loses at most the last commit interval of them.
+//
+// The map reserves JOURNAL_MAX_SIZE of address space up front, and the file
+// is grown a JOURNAL_GROWTH at a time underneath it, so the map never moves
+// and a commit can run without holding up the appends.
+//
+// A record is a header (see `journal_header`) with a checksum over the rest
+// of it, followed by its payload. A record that was only partly written when
+// the server crashed fails its checksum, and the journal is taken to end just
+// before it (appending then carries on from there).
+
+#ifndef JOURNAL_MAX_SIZE
+#define JOURNAL_MAX_SIZE ((size_t)1 << 30)
+#endif
+
+#ifndef JOURNAL_GROWTH
+#define JOURNAL_GROWTH ((size_t)1 << 20)
+#endif
+
+// How often (ms) the records are written out by default
+#ifndef JOURNAL_COMMIT_INTERVAL
+#define JOURNAL_COMMIT_INTERVAL 20
+#endif
+
+enum JOURNAL_TYPE {
+  JOURNAL_CREATE = 1, // The name of the host
+  JOURNAL_JOIN,       // The name of the second player
+  JOURNAL_MOVE,       // The cell (a byte), played by whoever's turn it was
+  JOURNAL_END,        // Nothing
+  JOURNAL_SECRET,     // The seat (a byte), then the resume secret of its player
+};
+
+// The payload of a JOURNAL_SECRET record
+#define JOURNAL_SECRET_SIZE (1 + sizeof(uint64_t))
+
+typedef struct {
+  uint32_t checksum; // Of everything after it (including the payload)
+  uint32_t game;     // The ID of the game
+  uint16_t length;   // Of the payload
+  uint8_t type;      // One of JOURNAL_TYPE
+  uint8_t unused;
+} journal_header;
+
+typedef struct {
+  int fd;
+  char *map;     // JOURNAL_MAX_SIZE of it, of which `size` is backed by the file
+  size_t size;   // The size of the file
+  size_t len;    // Where the next record goes
+  size_t synced; // How much of it is known to be on the disk
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Wakes the commit thread up to stop it
+  pthread_t thread;
+  BOOL is_running;
+  int interval;
+} journal_t;
+
+// A game that was still being played when the journal ended
+typedef struct {
+  uint32_t id;
+  char *names[2]; // The host's first
+  // What each player has to resume with to get their seat back (0 if they
+  // never had one)
+  uint64_t secrets[2];
+  board_t board;
+  int turn; // Whose move is next (0 or 1)
+} journal_game;
+
+/**
+ * @brief Opens (or creates) the journal at `path`, and finds where its
+ * records end.
+ *
+ * @return The journal, or NULL if it couldn't be opened or mapped
+ */
+journal_t *journal_open(const char *path);
+
+/**
+ * @brief Stops the commit thread (if it was started), writes out whatever is
+ * left and closes the journal.
+ */
+void journal_close(journal_t *journal);
+
+/**
+ * @brief Starts the thread that writes the records out every `interval` ms.
+ */
+void journal_start(journal_t *journal, int interval);
+
+/**
+ * @brief Copies a record into the journal. It's safe to call from any thread.
+ *
+ * @param game The ID of the game the record is about
+ * @param type One of JOURNAL_TYPE
+ * @return 0 on success, -1 if the journal is full (or the file couldn't be
+ * grown)
+ */
+int journal_append(journal_t *journal, int type, uint32_t game,
+                   const void *payload, int length);
+
+/**
+ * @brief Writes out (and waits for) everything that was appended since the
+ * last commit.
+ *
+ * @return 0 on success, -1 if it couldn't be written
+ */
+int journal_commit(journal_t *journal);
+
+/**
+ * @brief Plays the records back, from the start of the journal.
+ *
+ * @param count Set to how many games there are
+ * @return The games that had started and hadn't ended yet (in the order they
+ * were created), which the caller frees with `journal_games_free`
+ */
+journal_game *journal_replay(journal_t *journal, int *count);
+void journal_games_free(journal_game *games, int count);
+
+/**
+ * @brief Appends the resume secret of whoever is in `seat` (0 for the host),
+ * which replaces the one before it.
+ */
+int journal_append_secret(journal_t *journal, uint32_t game, int seat,
+                          uint64_t secret);
+
+/**
+ * @brief Appends the records that put the game back together as it is.
+ * NOTE: The moves are written taking turns between the players, rather than
+ * in the order that they were played, which ends up with the same board.
+ */
+int journal_append_game(journal_t *journal, const journal_game *game);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef NOUGHTS_CROSSES_LOBBY_H
+#define NOUGHTS_CROSSES_LOBBY_H
+
+#include "conn.h"
+#include "wire.h"
+#include <stdint.h>
+
+// The games page looks the same to everyone who is viewing it, so instead of
+// formatting it for each of them, the lobby keeps the line of every open game
+// encoded and only puts the page together again (once) after it has changed.
+// The page is then queued on each viewer's connection by reference (see
+// `conn_send_shared`), so sending it does not depend on the amount of games.
+//
+// A page is made of lobby deltas (see LOBBY_DELTA_FLAG), a LOBBY_RESET
+// followed by the opening of each of its games, and the client draws it by
+// itself. Anyone who already has a page is sent just the changes since then
+// (see `lobby_deltas`), which the lobby keeps the last LOBBY_MAX_CHANGES of.
+//
+// The lobby only ever holds the games that can be joined, in the order of
+// their IDs. A page is found by the ID that it starts from (its cursor), so
+// putting one together never depends on how many games there are.
+//
+// NOTE: The lobby does no locking of its own, the server keeps it behind the
+// same lock as its list of games.
+
+#ifndef LOBBY_INITIAL_SIZE
+#define LOBBY_INITIAL_SIZE 16
+#endif
+
+#ifndef LOBBY_MAX_CHANGES
+#define LOBBY_MAX_CHANGES 256
+#endif
+
+// The largest that the delta of a game being opened can be
+#define LOBBY_ENTRY_SIZE (WIRE_DELTA_SIZE + WIRE_STRING_SIZE(WIRE_MAX_STRING))
+
+typedef struct {
+  int id; // Identifies the game to the clients
+  uint64_t opened_epoch;
+  int len;
+  char delta[LOBBY_ENTRY_SIZE]; // LOBBY_GAME_OPENED with the line of the game
+} lobby_entry;
+
+typedef struct {
+  uint64_t epoch; // The epoch that the change moved the lobby on to
+  uint64_t opened_epoch;
+  int id;
+  int kind; // One of LOBBY_DELTA_KIND
+} lobby_change;
+
+typedef struct {
+  // In the order that the games were opened, which is also the order of
+  // their IDs.
+  lobby_entry **entries;
+  int count;
+  int capacity;
+  int next_id;
+  // The first page as it was last put together, which is NULL once it is out
+  // of date. Viewers that are still being sent an older page hold on to it.
+  conn_shared *page;
+  // Bumped every time that the page changes, so a viewer that remembers the
+  // epoch of the page it was sent knows exactly whether it is out of date.
+  // NOTE: It starts at 1, so 0 can stand for "never seen it".
+  uint64_t epoch;
+  // The change that moved the lobby on to epoch `e` is at
+  // `changes[e % LOBBY_MAX_CHANGES]`
+  lobby_change changes[LOBBY_MAX_CHANGES];
+} lobby_t;
+
+lobby_t *lobby_init();
+void lobby_free(lobby_t *lobby);
+
+/**
+ * @brief Adds an open game to the end of the page.
+ *
+ * @param host_name
+ * @return The ID of the game on the page, or -1 if the line could not be
+ * encoded
+ */
+int lobby_add(lobby_t *lobby, const char *host_name);
+
+/**
+ * @brief Takes a game off of the page.
+ *
+ * @param id As given by `lobby_add`
+ * @param kind Why it was taken off (LOBBY_GAME_FILLED or LOBBY_GAME_CLOSED)
+ * @return 0 on success, -1 if the game isn't on the page
+ */
+int lobby_remove(lobby_t *lobby, int id, int kind);
+
+/**
+ * @brief The current page (made of whole frames) of up to LOBBY_PAGE_SIZE
+ * games, starting from the first with an ID of at least `cursor`.
+ * NOTE: If there are none, it is the last page instead.
+ *
+ * @param cursor 0 for the first page, which is only put together again if
+ * anything has changed since it was last asked for
+ * @return A reference to the page, which the caller must release
+ */
+conn_shared *lobby_page(lobby_t *lobby, int cursor);
+
+/**
+ * @brief The cursor of the page that comes before the game with the ID `id`.
+ */
+int lobby_cursor_before(lobby_t *lobby, int id);
+
+/**
+ * @brief Puts together the changes made since `epoch`, which turn the page
+ * from then into the current one. Changes that cancel each other out (e.g. a
+ * game that was opened and then filled) are left out.
+ *
+ * @return A buffer (which the caller owns) of delta frames, or NULL if the
+ * changes are no longer known (in which case the whole page has to be sent)
+ */
+conn_shared *lobby_deltas(lobby_t *lobby, uint64_t epoch);
+
+#endif
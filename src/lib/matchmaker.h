@@ -0,0 +1,113 @@
+#ifndef NOUGHTS_CROSSES_MATCHMAKER_H
+#define NOUGHTS_CROSSES_MATCHMAKER_H
+
+#include "queue.h"
+#include "utils.h"
+#include <stdint.h>
+
+// Decides which of the waiting games a player is put into.
+//
+// The waiting games are kept in buckets (a FIFO queue each) by what the mode
+// pairs players on, e.g. the rating of the host in steps of
+// MATCHMAKER_RATING_STEP. A player is given the oldest game from the closest
+// bucket to their own that has anything in it. Which buckets have anything in
+// them is kept as a bitmask, so that is found without looking through the
+// buckets, and a match never depends on how many games are waiting.
+//
+// NOTE: The matchmaker does no locking of its own, the server keeps it behind
+// the same lock as the lobby.
+
+// NOTE: There has to be a bit for each of them in `occupied`
+#define MATCHMAKER_BUCKETS 64
+
+#ifndef MATCHMAKER_DEFAULT_RATING
+#define MATCHMAKER_DEFAULT_RATING 1000
+#endif
+
+// The width of a bucket for each mode (everything past the last bucket goes
+// into the last bucket)
+#ifndef MATCHMAKER_RATING_STEP
+#define MATCHMAKER_RATING_STEP 50
+#endif
+#ifndef MATCHMAKER_RTT_STEP
+#define MATCHMAKER_RTT_STEP 10 // ms
+#endif
+
+// The most that a rating can move by after a single game
+#ifndef MATCHMAKER_RATING_K
+#define MATCHMAKER_RATING_K 32
+#endif
+
+enum MATCHMAKER_MODE {
+  MATCH_FIFO,   // The oldest game, whoever is hosting it
+  MATCH_RATING, // The game with the closest rating
+  // The game whose host is about as far from the server as the player is,
+  // which is as close as we can get to them being in the same region
+  MATCH_RTT,
+};
+
+// What the matchmaker knows about a player
+typedef struct {
+  int rating;
+  int rtt; // Round trip time to the server in ms, or -1 if it isn't known
+} match_profile;
+
+// A waiting game (or anything else that is waiting to be matched), which is
+// embedded in it so that adding & removing never allocate.
+typedef struct {
+  queue_link link;
+  int bucket;
+  uint64_t sequence; // The order it was added in, for breaking ties
+} match_entry;
+
+typedef struct {
+  enum MATCHMAKER_MODE mode;
+  queue_t buckets[MATCHMAKER_BUCKETS];
+  uint64_t occupied; // Bucket `b` has something in it if bit `b` is set
+  uint64_t next_sequence;
+  int count;
+} matchmaker_t;
+
+void matchmaker_init(matchmaker_t *matchmaker, enum MATCHMAKER_MODE mode);
+
+/**
+ * @brief Parses the name of a mode ("fifo", "rating" or "rtt").
+ *
+ * @return The mode, or -1 if there isn't one by that name
+ */
+int matchmaker_mode_from_name(const char *name);
+
+/**
+ * @brief The bucket that a player (or their game) goes into.
+ */
+int matchmaker_bucket(matchmaker_t *matchmaker, match_profile profile);
+
+void matchmaker_add(matchmaker_t *matchmaker, match_entry *entry,
+                    match_profile profile);
+
+/**
+ * @brief Takes the entry out of the matchmaker, wherever it is.
+ *
+ * @return 0 on success, -1 if it isn't waiting
+ */
+int matchmaker_remove(matchmaker_t *matchmaker, match_entry *entry);
+
+/**
+ * @brief Takes the best match for the player out of the matchmaker. That is
+ * the oldest entry in the closest bucket (the older of the two, if there is
+ * one as close either side).
+ *
+ * @return The entry, or NULL if nothing is waiting
+ */
+match_entry *matchmaker_match(matchmaker_t *matchmaker, match_profile profile);
+
+/**
+ * @brief Moves the ratings of two players on after one has beaten the other.
+ * The winner takes more of the loser's rating the higher the loser is rated
+ * compared to them (a straight line through the middle of the Elo curve, so
+ * that it doesn't need floating point), but always at least 1 and less than
+ * MATCHMAKER_RATING_K.
+ */
+void matchmaker_rate(int *winner, int *loser);
+
+#endif
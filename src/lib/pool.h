@@ -0,0 +1,47 @@
+#ifndef NOUGHTS_CROSSES_POOL_H
+#define NOUGHTS_CROSSES_POOL_H
+
+#include <stddef.h>
+
+// A pool hands out objects of one fixed size. The objects are carved out of
+// slabs that are allocated a batch at a time, and objects that are given back
+// go onto a free list to be handed out again, so once a pool has warmed up it
+// never has to call malloc/free.
+//
+// NOTE: A pool does no locking of its own. It must only be used by one thread
+// at a time, i.e. either by a single thread (like the lists that only a shard
+// touches) or under the same lock as the lists that draw from it.
+
+#ifndef POOL_SLAB_OBJECTS
+#define POOL_SLAB_OBJECTS 64 // The default amount of objects per slab
+#endif
+
+struct POOL_SLAB_T;
+
+typedef struct POOL_T {
+  size_t object_size;
+  size_t slab_objects; // The amount of objects in each slab
+  void *free_objects;  // Each free object holds a pointer to the next one
+  struct POOL_SLAB_T *slabs;
+  size_t slab_count;
+  size_t in_use; // The amount of objects that have been handed out
+} pool_t;
+
+/**
+ * @brief Creates a pool for objects of `object_size` bytes.
+ *
+ * @param slab_objects How many objects to allocate at a time (0 for
+ * POOL_SLAB_OBJECTS)
+ */
+pool_t *pool_init(size_t object_size, size_t slab_objects);
+
+/**
+ * @brief Frees the pool and every slab in it, including the objects that
+ * are still in use.
+ */
+void pool_free(pool_t *pool);
+
+void *pool_alloc(pool_t *pool);
+void pool_release(pool_t *pool, void *object);
+
+#endif
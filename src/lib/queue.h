@@ -0,0 +1,45 @@
+#ifndef NOUGHTS_CROSSES_QUEUE_H
+#define NOUGHTS_CROSSES_QUEUE_H
+
+#include "utils.h"
+#include <stddef.h>
+
+// An intrusive FIFO queue. The links live inside of whatever is queued (see
+// `queue_entry`), so pushing and popping never allocate, and anything can be
+// taken out from the middle of the queue without having to search for it.
+
+typedef struct QUEUE_LINK_T {
+  struct QUEUE_LINK_T *prev;
+  struct QUEUE_LINK_T *next;
+  BOOL is_queued;
+} queue_link;
+
+typedef struct {
+  queue_link *head; // The oldest, which is the next to be popped
+  queue_link *tail;
+  int count;
+} queue_t;
+
+// Gets the value that `link` is embedded in as `member`
+#define queue_entry(link, type, member)                                       \
+  ((type *)((char *)(link) - offsetof(type, member)))
+
+queue_t new_queue();
+
+void queue_push(queue_t *queue, queue_link *link);
+
+/**
+ * @brief Takes the oldest link off of the queue.
+ *
+ * @return The link, or NULL if the queue is empty
+ */
+queue_link *queue_pop(queue_t *queue);
+
+/**
+ * @brief Takes the link out of the queue, wherever it is.
+ *
+ * @return 0 on success, -1 if it isn't queued
+ */
+int queue_remove(queue_t *queue, queue_link *link);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef NOUGHTS_CROSSES_REACTOR_H
+#define NOUGHTS_CROSSES_REACTOR_H
+
+#include <stdint.h>
+
+// The reactor is a thin wrapper around the readiness API of the platform
+// (epoll on Linux, kqueue on MacOS/BSD). Every socket the server cares about
+// is registered once and the reactor only hands back the ones that are ready,
+// meaning that idle clients cost us nothing per iteration.
+
+#ifndef REACTOR_READ
+#define REACTOR_READ 0x01
+#endif
+
+#ifndef REACTOR_WRITE
+#define REACTOR_WRITE 0x02
+#endif
+
+#ifndef REACTOR_HUP
+#define REACTOR_HUP 0x04
+#endif
+
+#ifndef REACTOR_MAX_EVENTS
+#define REACTOR_MAX_EVENTS 64
+#endif
+
+typedef struct {
+  uint64_t token; // The value passed in when the fd was registered
+  int events;     // Some combination of REACTOR_READ/WRITE/HUP
+} reactor_event;
+
+/**
+ * @brief Creates a new reactor (interest set)
+ *
+ * @return The file descriptor of the reactor, or -1 on failure
+ */
+int reactor_init();
+
+/**
+ * @brief Registers `fd` with the reactor. The `token` is handed back in
+ * `reactor_event.token` whenever the fd becomes ready.
+ *
+ * @param reactor
+ * @param fd
+ * @param events REACTOR_READ and/or REACTOR_WRITE
+ * @param token
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int reactor_add(int reactor, int fd, int events, uint64_t token);
+
+/**
+ * @brief Changes the events that `fd` is interested in. Passing 0 as the
+ * events will keep the fd registered, but it will never be reported as ready.
+ */
+int reactor_mod(int reactor, int fd, int events, uint64_t token);
+
+/**
+ * @brief Removes `fd` from the reactor. This must be called before the fd is
+ * closed.
+ */
+int reactor_del(int reactor, int fd);
+
+/**
+ * @brief Waits for at most `timeout_ms` milliseconds (-1 to wait forever) for
+ * any of the registered fds to become ready.
+ *
+ * @return The amount of events written into `events`, 0 on timeout and -1 on
+ * failure (errno is set, EINTR if interrupted by a signal)
+ */
+int reactor_wait(int reactor, reactor_event *events, int max_events,
+                 int timeout_ms);
+
+void reactor_free(int reactor);
+
+/**
+ * @brief The current time of a monotonic clock in milliseconds, for working
+ * out the timeouts of `reactor_wait`.
+ */
+uint64_t reactor_now_ms();
+
+#endif
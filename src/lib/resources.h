@@ -3,46 +3,37 @@
 
 #include <string.h>
 
-#define StringResource static const char *
-
-StringResource clear_screen = "\x1b[2J\x1b[H";
-StringResource main_menu = "\x1b[;1mWelcome to XO Online!\n\n1)\tView Active "
-                           "Games\n2)\tCreate new Game\n3)\tQuit\x1b[0;0m\n";
-
-StringResource game_info_template = "%s's game\t[%d/2]\n";
-
-StringResource view_games =
-    "\x1b[32;1mThere %s currently %d "
-    "available %s.\n\r\n\x1b[0;1m(SPACE) Join Game\n(R) Refresh "
-    "Games\n(B) Go back to Home Page\n(Q) Quit\x1b[0;0m\n\r\n";
-
-StringResource waiting_room =
-    "\x1b[;1mYou're currently waiting for another player to join..\nB) Leave "
-    "Room\nQ) Quit\x1b[0;0m\n\r\n\x1b[;3mIf you don't want to wait for too "
-    "long, it might "
-    "be best to leave the room\nand join someone someone else's "
-    "game.\x1b[0;0m\n";
-
-StringResource playing_header = "\x1b[;1mYou're playing against %s!\n";
-
-const static char board_template[] =
-    " %s | %s | %s\n"
-    "---+---+---\n"
-    " %s | %s | %s\n"
-    "---+---+---\n"
-    " %s | %s | %s\n\r\n\x1b[2K\x1b[;1mIt is %s your turn.\x1b[;0m";
-
-StringResource prefilled =
-    " \x1b[30;1m1\x1b[0;0m | \x1b[30;1m2\x1b[0;0m | \x1b[30;1m3\x1b[0;0m\n"
-    "---+---+---\n"
-    " \x1b[30;1m4\x1b[0;0m | \x1b[30;1m5\x1b[0;0m | \x1b[30;1m6\x1b[0;0m\n"
-    "---+---+---\n"
-    " \x1b[30;1m7\x1b[0;0m | \x1b[30;1m8\x1b[0;0m | \x1b[30;1m9\x1b[0;0m\n\r\n";
-
-StringResource current_player_turn =
+// NOTE: The strings are only declared here, and defined once in resources.c,
+// so that every file that includes this doesn't get a copy of its own.
+#define StringResource const char *const
+
+// NOTE: The screens that the server sends as they are are arrays, so that
+// their lengths are known up front (see `WIRE_CONSTANT`).
+static const char clear_screen[] = "\x1b[2J\x1b[H";
+extern StringResource main_menu;
+
+extern StringResource game_info_template;
+
+extern StringResource view_games;
+extern StringResource page_info;
+
+extern StringResource waiting_room;
+
+extern StringResource playing_header;
+extern StringResource watching_header;
+
+// The cells of the board, which are padded to the width of the biggest label
+// (see `board_draw`)
+extern StringResource board_label_template;
+extern StringResource board_piece_template;
+extern StringResource board_turn_template;
+// What a spectator is shown instead, with the piece of whoever is next
+extern StringResource board_watch_template;
+
+static const char current_player_turn[] =
     "\x1b[;1mIt is currently your turn.\x1b[;0m";
 
-StringResource enemy_turn = "\x1b[;1mIt is not your turn.\x1b[;0m";
-StringResource game_end = "\x1b[2K\r\x1b[33;1mSorry, the game has ended!\r\n\x1b[0;0m";
+static const char enemy_turn[] = "\x1b[;1mIt is not your turn.\x1b[;0m";
+extern StringResource game_end;
 
 #endif
@@ -1,7 +1,17 @@
 #ifndef NOUGHTS_CROSSES_SERVER_H
 #define NOUGHTS_CROSSES_SERVER_H
 
+#include "bot.h"
 #include "client.h"
+#include "conn.h"
+#include "id_alloc.h"
+#include "journal.h"
+#include "lobby.h"
+#include "matchmaker.h"
+#include "reactor.h"
+#include "slot_map.h"
+#include "timer_wheel.h"
+#include "wire.h"
 #include "utils.h"
 #include <arpa/inet.h>
 #include <fcntl.h>
@@ -9,10 +19,12 @@
 #include <poll.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/errno.h>
+#include <sys/random.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -20,32 +32,193 @@
 #define TCP 0
 #define loop while (1)
 
-#define HEADER_VERB (game_count > 1 || game_count == 0 ? "are" : "is")
+// The listen socket is registered with this token, client sockets are
+// registered with their (non-zero) client ID.
+#define LISTEN_TOKEN 0
+// The read end of the pipe other threads use to wake a reactor up.
+#define WAKE_TOKEN UINT64_MAX
 
-#define HEADER_GAME (game_count > 1 || game_count == 0 ? "games" : "game")
+// The amount of reactor threads can be overridden with this environment
+// variable. By default we start one per online core.
+#define SERVER_THREADS_ENV "XO_SERVER_THREADS"
+// How players are matched into games (see `matchmaker_mode_from_name`), FIFO
+// by default.
+#define MATCHMAKING_ENV "XO_MATCHMAKING"
+// If set (ms), players that want to join a game are matched in batches this
+// far apart, instead of straight away.
+#define MATCH_INTERVAL_ENV "XO_MATCH_INTERVAL"
+// If set (ms), a game that nobody has joined for this long is joined by a bot
+// instead (see bot.h). By default, games wait for a person until they're
+// closed (see LOBBY_TIMEOUT_ENV).
+#define BOT_DELAY_ENV "XO_BOT_DELAY"
+// How long (ms) a game waits for somebody to join it before it's closed,
+// LOBBY_TIMEOUT by default. 0 keeps it open for as long as its host is there.
+#define LOBBY_TIMEOUT_ENV "XO_LOBBY_TIMEOUT"
+// How long (ms) a player has to make their move before they lose the game,
+// MOVE_TIMEOUT by default. 0 lets them take as long as they like.
+#define MOVE_TIMEOUT_ENV "XO_MOVE_TIMEOUT"
+// How long (ms) a client that isn't in a game can go without sending anything
+// before it's disconnected (which frees up its space), IDLE_TIMEOUT by
+// default. 0 never disconnects them.
+#define IDLE_TIMEOUT_ENV "XO_IDLE_TIMEOUT"
+// How long (ms) a client can go without reading what it's sent (see
+// CONN_HIGH_WATERMARK) before it's disconnected, STALL_TIMEOUT by default. 0
+// only disconnects them once they have overflowed (see CONN_MAX_QUEUED).
+#define STALL_TIMEOUT_ENV "XO_STALL_TIMEOUT"
+// If set, every game is written to the journal at this path (see journal.h),
+// and the games that were still being played when the server went down are
+// picked up again when it starts. A player gets their game back by resuming
+// with their token (see RESUME_FLAG), and not by using the same name.
+#define JOURNAL_ENV "XO_JOURNAL"
+// How often (ms) the journal is written out, which is as much as a crash
+// could lose (JOURNAL_COMMIT_INTERVAL by default).
+#define JOURNAL_INTERVAL_ENV "XO_JOURNAL_INTERVAL"
+// How long (ms) a client whose connection drops is held on to (along with
+// their game) for them to come back with their resume token (see
+// RESUME_FLAG), GRACE_PERIOD by default. 0 lets them go straight away.
+#define GRACE_PERIOD_ENV "XO_GRACE_PERIOD"
+
+#ifndef GRACE_PERIOD
+#define GRACE_PERIOD 30000
+#endif
+
+#ifndef LOBBY_TIMEOUT
+#define LOBBY_TIMEOUT 600000
+#endif
+
+#ifndef MOVE_TIMEOUT
+#define MOVE_TIMEOUT 60000
+#endif
+
+#ifndef IDLE_TIMEOUT
+#define IDLE_TIMEOUT 300000
+#endif
+
+#ifndef STALL_TIMEOUT
+#define STALL_TIMEOUT 10000
+#endif
+
+// The name that the bot goes by
+#ifndef BOT_NAME
+#define BOT_NAME "Bot"
+#endif
+
+// A player without a connection is either a bot, or somebody whose game was
+// picked up from the journal and who hasn't come back for it yet. Nothing is
+// ever sent to either of them.
+#define client_is_bot(client) ((client)->is_bot)
+#define client_is_away(client) ((client)->conn == NULL && !(client)->is_bot)
+
+// Clients on the games page are pushed the changes to it, at most once every
+// this many milliseconds so that a burst of changes goes out together.
+#ifndef LOBBY_PUSH_INTERVAL
+#define LOBBY_PUSH_INTERVAL 100
+#endif
 
 const int MAX_CLIENTS = 1000;
 
 enum SERVER_STATE { ACCEPTING, NOT_ACCEPTING };
 
+struct SERVER_T;
+
+// State that is shared by every reactor thread.
+// NOTE: Anything in here must only be touched while holding `lock`.
 typedef struct {
+  pthread_mutex_t lock;
+  id_allocator *client_ids; // The IDs of every connected client (across all
+                            // of the shards).
+  // The games that are waiting for a second player. A game is only ever in
+  // one of `matchmaker` or `running`.
+  matchmaker_t matchmaker;
+  int match_interval; // 0 if players are matched as soon as they ask
+  slot_map running;   // The games that have started, keyed by `game->handle`
+  int bot_delay;      // 0 if bots never join games
+  int lobby_timeout;  // 0 if games are never closed for nobody joining
+  int move_timeout;   // 0 if the moves aren't timed
+  int idle_timeout;   // 0 if idle clients are never disconnected
+  int stall_timeout;  // 0 if only clients that overflow are disconnected
+  lobby_t *lobby;     // The games page, which always matches `matchmaker`
+  journal_t *journal; // NULL unless games are being kept (see JOURNAL_ENV)
+  uint32_t next_game_id;
+  // The players of the games from the journal that haven't come back yet,
+  // keyed by `client->handle`.
+  slot_map away;
+  int grace_period; // 0 if clients aren't held on to
+  // Every client that has a name (connected or not), keyed by
+  // `client->session`, which is how a resume token finds them.
+  slot_map sessions;
+
+  struct SERVER_T **shards;
+  int shard_count;
+} server_shared_t;
+
+// Each reactor thread owns one of these (a shard). It has its own listen
+// socket (bound with SO_REUSEPORT so that the kernel spreads the connections
+// out for us) and its own set of clients. A game is owned by the shard of its
+// host, and a player joining from another shard is handed over to it, meaning
+// that a game is only ever touched by a single thread.
+typedef struct SERVER_T {
   int socket;
+  int reactor; // Every socket (listen & clients) is registered here
   short port;
-  HashMap clients;
+  int shard_id;
+  slot_map clients; // The clients on this shard, keyed by `client->handle`
+  // The clients on this shard that are on the games page, keyed by
+  // `client->subscription`.
+  slot_map subscribers;
+  atomic_bool has_lobby_changed; // Set by whichever shard changes the lobby
+  uint64_t next_lobby_push;      // The earliest (ms) we can push again
+  // The clients on this shard that are waiting to be matched into a game
+  // (keyed by `client->seeking`), while matching is done in batches.
+  slot_map seekers;
+  uint64_t next_match; // When (ms) the seekers are next matched
+  // What `server_match_seekers` works in, which is kept from one round to the
+  // next (and only ever grows) so that matching doesn't allocate.
+  client_t **match_seekers;
+  game_t **match_games;
+  match_profile *match_profiles;
+  uint32_t match_capacity;
+  // The timers of the clients & games on this shard, which is what the
+  // reactor waits on when nothing else is due (see `server_serve`).
+  timer_wheel timers;
+  // The clients of this shard whose connection has dropped, keyed by
+  // `client->handle` until they come back or their grace period is up.
+  slot_map graced;
   enum SERVER_STATE state;
-  LinkedList *games;
-  unsigned long current_game_hash;
+  conn_batch batch; // Connections written to during this iteration (and
+                    // the pools their chunks come from)
+
+  // Other shards hand clients over to us by pushing them to the inbox and
+  // writing a byte into the `wake_pipe`.
+  int wake_pipe[2];
+  pthread_mutex_t inbox_lock;
+  LinkedList *inbox;
+  pool_t *inbox_pool; // The nodes of `inbox`, also guarded by `inbox_lock`
+
+  pthread_t thread;
+  server_shared_t *shared;
 } server_t;
 
 /* ------------------------------------------------------------------------ */
 
 /**
- * @brief Creates a new server instance
+ * @brief Creates the state shared between all of the shards
+ *
+ * @param shard_count
+ * @return server_shared_t
+ */
+server_shared_t *server_shared_init(int shard_count);
+void server_shared_free(server_shared_t *shared);
+
+/**
+ * @brief Creates a new server instance (shard)
  *
  * @param port
+ * @param shared
+ * @param shard_id
  * @return server_t
  */
-server_t *server_init(short port);
+server_t *server_init(short port, server_shared_t *shared, int shard_id);
 
 // Helpers used by the server_init function
 int server_bind(server_t *server);
@@ -59,25 +232,388 @@ int server_listen(server_t *server);
 void server_start(server_t *server);
 
 /**
- * @brief Accepts new client connections and adds them to the server
+ * @brief Accepts new client connections and adds them to the server. Returns
+ * once the server has been interrupted.
  *
  * @param server
  */
 void server_serve(server_t *server);
 
+/**
+ * @brief Wakes up the reactor of `server` from any thread.
+ *
+ * @param server
+ */
+void server_wake(server_t *server);
+
+/**
+ * @brief Moves `client` from `server` over to the shard `target`. The client
+ * is picked up by `target` the next time its reactor wakes up.
+ *
+ * @param server
+ * @param client
+ * @param target
+ */
+void server_migrate_client(server_t *server, client_t *client,
+                           server_t *target);
+void handle_client_arrival(server_t *server, client_t *client);
+
 // Helpers used by the server_serve function
 client_t *server_accept(server_t *server);
+void server_set_accepting(server_t *server, enum SERVER_STATE state);
 
-void handle_client_name_set(client_t *client, char *buf);
+/**
+ * @brief Reads a single message from a client that the reactor reported as
+ * readable and acts upon it.
+ *
+ * @param server
+ * @param client
+ */
+void handle_client_readable(server_t *server, client_t *client);
+void handle_client_frames(server_t *server, client_t *client);
+
+// Returned by the message handlers once the client has been handed over to
+// another shard, and so must not be touched anymore.
+#define CLIENT_MOVED -2
+
+int handle_client_message(server_t *server, client_t *client, char *buf,
+                          int len);
+
+/**
+ * @brief Accepts (or rejects) the name that the client has sent, and puts
+ * them back into their game if it was picked up from the journal.
+ *
+ * @return 0, or CLIENT_MOVED if the client is now on another shard
+ */
+int handle_client_name_set(server_t *server, client_t *client,
+                           wire_reader *reader);
 void handle_game_create(server_t *server, client_t *client);
+
+/**
+ * @brief Puts the client into a waiting game, or sends them the games page if
+ * there isn't one (or leaves them waiting for the next round of matching).
+ *
+ * @return 0, or CLIENT_MOVED if the client is now on another shard
+ */
 int handle_game_join(server_t *server, client_t *client);
+
+/**
+ * @brief What the matchmaker goes by for the client.
+ */
+match_profile server_profile(server_t *server, client_t *client);
+
+/**
+ * @brief Takes the best match for the client out of the matchmaker and puts
+ * them into it. Must be called with the lock held.
+ *
+ * @return The game, or NULL if there aren't any waiting
+ */
+game_t *server_claim_game(server_t *server, client_t *client,
+                          match_profile profile);
+
+/**
+ * @brief Starts the game that the client has been put into, or moves them
+ * over to the shard that owns it.
+ *
+ * @return 0, or CLIENT_MOVED if the client is now on another shard
+ */
+int server_enter_game(server_t *server, client_t *client, game_t *game);
+void handle_game_start(server_t *server, game_t *game);
+
+/**
+ * @brief Puts the client into a running game as a spectator, or moves them
+ * over to the shard that owns it first. If there isn't one to watch, they are
+ * sent the games page instead.
+ *
+ * @param game_id The `id` of the game, or 0 for any game between two players
+ * that are both here (rather than against a bot, or with somebody away)
+ * @return 0, or CLIENT_MOVED if the client is now on another shard
+ */
+int handle_game_watch(server_t *server, client_t *client, uint32_t game_id);
+
+/**
+ * @brief Adds the client to the spectators of the game that it was sent to
+ * watch (which is owned by this shard), and sends it the board as it is so
+ * far.
+ */
+void server_watch_game(server_t *server, client_t *client);
+void server_unwatch(client_t *client);
+
+/**
+ * @brief Sends a frame to the players and every spectator of the game. With
+ * spectators, the frame is encoded once into a shared buffer that each of
+ * them only queues a reference to (see `conn_send_shared`).
+ */
+void server_broadcast_game(game_t *game, const char *data, int len);
+
+/**
+ * @brief Plays the client's move if it is theirs to make, and sends it to
+ * both players. The game is ended (and the winner's rating moved on) once
+ * the move has won or drawn it. A bot answers the move straight away.
+ * NOTE: A move that isn't allowed is ignored.
+ */
+void handle_game_play(server_t *server, client_t *client, const char *buf,
+                      int len);
 void handle_game_unbind(server_t *server, client_t *client);
 void handle_client_disconnect(server_t *server, client_t *client,
                               int client_id);
 
+/**
+ * @brief Gives the client ID back, and lets any shard that was full start
+ * accepting again.
+ */
+void server_release_id(server_t *server, int client_id);
+
 int render_games_page(server_t *server, client_t *client);
 
-void smart_broadcast(client_t **clients, size_t amount, char *message,
+/**
+ * @brief Moves the client on to the page that it asked for (see
+ * LOBBY_PAGE_FROM and LOBBY_PAGE_BEFORE).
+ */
+void handle_lobby_paging(server_t *server, client_t *client,
+                         wire_reader *reader);
+
+/**
+ * @brief Keeps the client up to date with the games page (see
+ * `server_push_lobby`) until it leaves it.
+ */
+void server_subscribe(server_t *server, client_t *client);
+void server_unsubscribe(server_t *server, client_t *client);
+
+/**
+ * @brief Lets every shard know that the lobby has changed, waking up the
+ * ones that haven't been told yet. Must be called without the lock held.
+ */
+void server_lobby_changed(server_t *server);
+
+/**
+ * @brief Pushes whatever has changed in the lobby to the subscribers of the
+ * shard, unless it has already done so in the last LOBBY_PUSH_INTERVAL.
+ * Every change since the last push is coalesced into one buffer, which is
+ * queued on each of them by reference.
+ */
+void server_push_lobby(server_t *server);
+
+/**
+ * @brief How long (ms) the reactor can wait before the next push is due, or
+ * -1 if there is nothing to push.
+ */
+int server_lobby_timeout(server_t *server);
+
+/**
+ * @brief Matches every seeker of the shard into a game at once (under a
+ * single lock), once the next batch is due. Anyone who there isn't a game for
+ * is sent the games page, as they would be without the batching.
+ */
+void server_match_seekers(server_t *server);
+
+/**
+ * @brief How long (ms) the reactor can wait before the next batch of seekers
+ * is due, or -1 if nobody is waiting.
+ */
+int server_match_timeout(server_t *server);
+void server_unseek(server_t *server, client_t *client);
+
+/**
+ * @brief Puts a bot into the game, unless a player has been matched into it
+ * in the meantime. The game then starts as it would with a person.
+ */
+void server_add_bot(server_t *server, game_t *game);
+
+/**
+ * @brief Fired once a game has waited for the bot delay (see BOT_DELAY_ENV),
+ * or else for the lobby timeout, which closes it.
+ */
+void server_lobby_expired(wheel_timer *timer, void *server);
+
+/**
+ * @brief Starts the clock of whoever's turn it is in the game (see
+ * MOVE_TIMEOUT_ENV), from the start.
+ */
+void server_start_clock(server_t *server, game_t *game);
+
+/**
+ * @brief Fired once a player has run out of time to move, which loses them
+ * the game.
+ */
+void server_move_expired(wheel_timer *timer, void *server);
+
+/**
+ * @brief Starts the client's idle timeout (see IDLE_TIMEOUT_ENV) over, as it
+ * has just sent something.
+ */
+void server_touch(server_t *server, client_t *client);
+
+/**
+ * @brief Fired once a client has been idle for too long, which disconnects
+ * it (without holding on to it). A client in a game is left to the clock of
+ * the game instead.
+ */
+void server_idle_expired(wheel_timer *timer, void *server);
+
+/**
+ * @brief Registers the connection of the client with the reactor of the
+ * shard, and keeps an eye on how backed up it gets (see
+ * `server_congestion`).
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int server_attach(server_t *server, client_t *client);
+
+/**
+ * @brief Cancels the timers that are only armed while the client is
+ * connected to this shard.
+ */
+void server_stop_timers(server_t *server, client_t *client);
+
+/**
+ * @brief Told whenever the connection of a client of the shard (`arg`) gets
+ * backed up or catches up again. A client that stays congested for the stall
+ * timeout, or that overflows, is disconnected (see `server_stall_expired`),
+ * and the lobby isn't pushed to it in the meantime.
+ */
+void server_congestion(conn_t *conn, int congestion, void *arg);
+
+/**
+ * @brief Fired once a client hasn't kept up with what it has been sent,
+ * which disconnects it (without a grace period).
+ */
+void server_stall_expired(wheel_timer *timer, void *server);
+
+/**
+ * @brief Creates a player without a connection (a bot, or somebody that is
+ * away) for `game`, which is freed alongside the game (see
+ * `handle_game_unbind`).
+ */
+client_t *server_player_init(game_t *game, const char *name);
+
+/**
+ * @brief Writes what has happened to the game to the journal, if there is
+ * one. It's safe to call from any shard.
+ */
+void server_journal(server_t *server, int type, game_t *game,
+                    const void *payload, int length);
+
+/**
+ * @brief Writes the resume secret of a player to the journal (if there is
+ * one), which is what gets them their seat back after a restart.
+ */
+void server_journal_secret(server_t *server, client_t *client);
+
+/**
+ * @brief Puts the games that were still being played back together from the
+ * journal (if there is one), with both of their players away, and starts a
+ * fresh journal with only them in it. Must be called before the shards are
+ * started.
+ */
+void server_recover_games(server_shared_t *shared);
+
+/**
+ * @brief Gives the client back the seat that they had in a game from the
+ * journal, or moves them over to the shard that owns it first. The seat is
+ * only given to whoever has the resume secret that the journal has for it
+ * (which the client sent in `resume_secret`).
+ *
+ * @return 0, CLIENT_MOVED if the client is now on another shard, or -1 if
+ * there is no seat for their secret
+ */
+int server_resume(server_t *server, client_t *client);
+
+/**
+ * @brief Swaps the client in for the away player that has their secret, and
+ * sends them a new token and the game as it is so far. The game must be
+ * owned by this shard.
+ */
+void server_take_seat(client_t *client);
+
+/**
+ * @brief Gives the client a session (and sends them its token), so that they
+ * can get back to where they were if their connection drops.
+ */
+void server_start_session(server_t *server, client_t *client);
+void server_end_session(server_t *server, client_t *client);
+
+/**
+ * @brief Reads the resume token that a new connection sent instead of a
+ * name, and puts it back into the session (see `server_resume_session`).
+ *
+ * @return 0, or CLIENT_MOVED if the client is no longer to be touched
+ */
+int handle_client_resume(server_t *server, client_t *client,
+                         wire_reader *reader);
+
+/**
+ * @brief Hands the connection of `client` (which only has the token that it
+ * sent in `session` & `resume_secret`) over to the client of that session,
+ * moving it over to the shard that owns the session first. The old
+ * connection is dropped, if it hasn't been noticed to have already.
+ * A token that isn't for a session might still be for a seat in a game from
+ * the journal (see `server_resume`). Otherwise, the client is told that its
+ * token has expired.
+ *
+ * @return 0, or CLIENT_MOVED if the client is no longer to be touched
+ */
+int server_resume_session(server_t *server, client_t *client);
+
+/**
+ * @brief Takes the connection of `resumer` over for the client, and sends
+ * them where they were (their game, or else the home page).
+ */
+void server_rebind(server_t *server, client_t *client, client_t *resumer);
+
+/**
+ * @brief Holds on to a client whose connection has dropped (and to their
+ * game) for the grace period.
+ */
+void server_grace(server_t *server, client_t *client);
+
+/**
+ * @brief Fired once a client's grace period is up, which lets go of them and
+ * ends their game.
+ */
+void server_grace_expired(wheel_timer *timer, void *server);
+
+/**
+ * @brief Sends the client the game that they're in as it is, from their seat.
+ */
+void server_send_seat(client_t *client);
+
+/**
+ * @brief Sends the pieces so far, as moves that take turns between the
+ * players (like they were played) so that the client knows whose turn it is.
+ */
+void server_send_board(client_t *client, game_t *game);
+
+/**
+ * @brief Queues `data` as a single frame on the client's connection.
+ *
+ * @param client
+ * @param data
+ * @param data_length
+ * @return 0 on success and -1 if the connection is broken.
+ */
+int client_send(client_t *client, const void *data, int data_length);
+
+/**
+ * @brief Starts a frame (of up to `max_length` bytes) that is encoded straight
+ * into the client's write queue. It is sent by `client_frame_end`.
+ */
+wire_writer client_frame(client_t *client, int max_length);
+int client_frame_end(client_t *client, wire_writer *writer);
+
+/**
+ * @brief Sends one of the frames that never change (e.g. from
+ * `wire_constants`), which is only copied into the write queue.
+ */
+int client_send_constant(client_t *client, wire_constant constant);
+
+/**
+ * @brief Sends the formatted text as a single frame (including its NULL
+ * terminator), without allocating.
+ */
+int client_send_text(client_t *client, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+void smart_broadcast(client_t **clients, size_t amount, const char *message,
                      size_t len);
 
 /**
@@ -95,5 +631,4 @@ int server_unbind(server_t *server);
  * @param subprocess
  */
 /* void handle_commands(server_t *server, pid_t subprocess); */
-unsigned long hash_games_list(LinkedList *games);
 #endif
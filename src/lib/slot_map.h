@@ -0,0 +1,64 @@
+#ifndef NOUGHTS_CROSSES_SLOT_MAP_H
+#define NOUGHTS_CROSSES_SLOT_MAP_H
+
+#include "utils.h"
+#include <stdint.h>
+
+// A slot map stores pointers in one packed array, so iterating over all of
+// them is a linear scan: `for (i = 0; i < map.count; ++i) map.values[i]`.
+//
+// Values are looked up by a handle, which is the index of a slot (that knows
+// where the value currently is in the packed array) tagged with the
+// generation of that slot. Removing a value moves the last one into its place
+// and bumps the generation of the slot, so any handle that is still lying
+// around for it (e.g. in an event that was already queued up) just finds
+// nothing instead of some other value.
+
+#ifndef SLOT_MAP_INITIAL_SIZE
+#define SLOT_MAP_INITIAL_SIZE 16
+#endif
+
+// NOTE: Valid handles are never 0, as the generation of a slot starts at 1.
+#define SLOT_HANDLE_NONE 0
+
+typedef uint64_t slot_handle;
+
+typedef struct {
+  uint32_t generation;
+  // Where the value is in `values` if the slot is in use, otherwise the next
+  // free slot.
+  uint32_t index;
+} slot_t;
+
+typedef struct {
+  slot_t *slots;
+  uint32_t slot_count; // The amount of slots that have ever been used
+  uint32_t free_slot;  // The first slot of the free list
+  uint32_t capacity;   // The size of all three arrays
+
+  void **values;
+  uint32_t *value_slots; // The slot that points at each of the `values`
+  uint32_t count;
+} slot_map;
+
+slot_map new_slot_map();
+void free_slot_map(slot_map *map);
+
+slot_handle slot_map_insert(slot_map *map, void *value);
+
+/**
+ * @brief Gets the value of a handle.
+ *
+ * @return The value, or NULL if it has been removed
+ */
+void *slot_map_get(slot_map *map, slot_handle handle);
+
+/**
+ * @brief Removes the value of a handle. The last value in `values` is moved
+ * into its place.
+ *
+ * @return The value that was removed, or NULL if it was already gone
+ */
+void *slot_map_remove(slot_map *map, slot_handle handle);
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef NOUGHTS_CROSSES_TIMER_WHEEL_H
+#define NOUGHTS_CROSSES_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A hierarchical timing wheel, which keeps track of when each of a shard's
+// timers (idle clients, move clocks, ...) is due.
+//
+// Time is counted in ticks of TIMER_WHEEL_TICK ms. The wheel has
+// TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots each, where a slot of
+// level 0 is a single tick and a slot of each level after it covers a whole
+// turn of the level below. A timer goes into the lowest level whose current
+// turn it's due in, and is moved down a level (cascaded) once the wheel
+// reaches the start of its slot, so that it's in level 0 by the time it's
+// due.
+//
+// The timers live inside of whatever they're timing (see `timer_entry`) and
+// each slot is a circular list of them, so arming and cancelling a timer
+// never allocate or search, however many of them there are.
+//
+// NOTE: This header doesn't depend on utils.h, so that the timers can be
+// embedded in `client_t`.
+
+#ifndef TIMER_WHEEL_TICK
+#define TIMER_WHEEL_TICK 10
+#endif
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+// How many ticks ahead a timer can be put into the wheel. Anything later than
+// that is put in as late as it can go, and put back in once it comes around
+// (about 46 hours with the default tick).
+#define TIMER_WHEEL_SPAN ((uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+typedef struct TIMER_LINK_T {
+  struct TIMER_LINK_T *prev;
+  struct TIMER_LINK_T *next;
+} timer_link;
+
+struct WHEEL_TIMER_T;
+
+/**
+ * @brief Called once the timer is due, after it has been taken out of the
+ * wheel (so it can be armed again straight away).
+ *
+ * @param context Whatever was passed to `timer_wheel_advance`
+ */
+typedef void (*timer_callback)(struct WHEEL_TIMER_T *timer, void *context);
+
+typedef struct WHEEL_TIMER_T {
+  timer_link link;  // In the slot that it's due in, while it's armed
+  uint64_t expires; // The tick that it's due on
+  int is_armed;
+  timer_callback fire;
+} wheel_timer;
+
+typedef struct {
+  timer_link slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+  uint64_t tick; // The next tick to be run (every earlier one has fired)
+  int count;     // How many timers are armed
+} timer_wheel;
+
+// Gets the value that `timer` is embedded in as `member`
+#define timer_entry(timer, type, member)                                       \
+  ((type *)((char *)(timer) - offsetof(type, member)))
+
+/**
+ * @brief Empties the wheel, starting it at `now_ms`.
+ * NOTE: The slots point at themselves, so the wheel mustn't be moved once
+ * it's been initialised.
+ */
+void timer_wheel_init(timer_wheel *wheel, uint64_t now_ms);
+
+/**
+ * @brief Sets up a timer that isn't armed yet, which calls `fire` when it's
+ * due. A timer that isn't armed can be set up again with another callback.
+ */
+void timer_init(wheel_timer *timer, timer_callback fire);
+
+/**
+ * @brief Arms the timer to fire once it's `deadline_ms` (or straight away if
+ * that has already passed). A timer that is already armed is moved to the
+ * new deadline.
+ */
+void timer_arm(timer_wheel *wheel, wheel_timer *timer, uint64_t deadline_ms);
+
+/**
+ * @brief Takes the timer out of the wheel, so that it doesn't fire.
+ *
+ * @return 0 on success, -1 if it isn't armed
+ */
+int timer_cancel(timer_wheel *wheel, wheel_timer *timer);
+
+/**
+ * @brief Runs the wheel up until `now_ms`, firing every timer that is due by
+ * then. The callbacks can arm and cancel any timer (including the ones that
+ * are yet to fire).
+ *
+ * @return How many timers fired
+ */
+int timer_wheel_advance(timer_wheel *wheel, uint64_t now_ms, void *context);
+
+/**
+ * @brief How long (ms) until the wheel next has to be advanced, or -1 if
+ * nothing is armed. That is either when the nearest timer is due, or when
+ * the timers that are due soonest are cascaded (which is never after they're
+ * due), so the wait is never too long.
+ */
+int timer_wheel_timeout(const timer_wheel *wheel, uint64_t now_ms);
+
+#endif
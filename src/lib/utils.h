@@ -28,34 +28,22 @@
 #define NEXT_ITER(head) head = head->next != NULL ? head->next : NULL;
 #endif
 
-#ifndef GAME_SIG_CHECK
-#define GAME_SIG_CHECK 9
-#endif
-
-#ifndef GAME_SIG_CONFIRM
-#define GAME_SIG_CONFIRM 10
-#endif
-
-#ifndef GAME_SIG_WIN
-#define GAME_SIG_WIN 11
-#endif
-
-#ifndef GAME_SIG_DRAW
-#define GAME_SIG_DRAW 12
-#endif
-
-#ifndef GAME_SIG_CONFIRM_END
-#define GAME_SIG_CONFIRM_END 13
+// A move, which the client sends as [GAME_SIG_MOVE, 1, cell] and the server
+// (once it has checked it) sends to both players as
+// [GAME_SIG_MOVE, 2, cell, outcome], where the outcome is a BOARD_OUTCOME.
+// A player that is put back into their game is sent [GAME_SIG_MOVE, 3, seat]
+// (0 for the host), followed by the board so far.
+#ifndef GAME_SIG_MOVE
+#define GAME_SIG_MOVE 9
 #endif
 
 #ifndef GAME_SIG_EXIT
 #define GAME_SIG_EXIT -10
 #endif
 
-#define is_game_sig(sig)                                                       \
-  (sig == GAME_SIG_EXIT || sig == GAME_SIG_CHECK || sig == GAME_SIG_CONFIRM || \
-   sig == GAME_SIG_WIN || sig == GAME_SIG_DRAW || sig == GAME_SIG_CONFIRM_END)
+#define is_game_sig(sig) (sig == GAME_SIG_EXIT || sig == GAME_SIG_MOVE)
 
+#include "timer_wheel.h"
 #include <ctype.h>
 #include <netinet/in.h>
 typedef struct {
@@ -78,12 +66,41 @@ typedef struct {
     HOME_PAGE,
     GAME_VIEW_PAGE,
     IN_GAME_PAGE,
-    /* SPECTATOR_PAGE, */
+    SPECTATOR_PAGE, // Watching a game that somebody else is playing
   } screen_state;
 
   void *game; // This will not be set at all by the client
               // but will be used by the server.
-  unsigned long last_sent_game_hash;
+  uint64_t last_seen_epoch; // The lobby epoch of the last games page sent to
+                            // the client (0 if it needs a new one).
+  int lobby_cursor; // Where the page that the client is on starts (see
+                    // `lobby_page`)
+  struct CONN_T *conn; // The buffered connection (only used by the server)
+  uint64_t handle; // The handle of the client in the slot map of the shard
+                   // that it is on (only used by the server)
+  uint64_t subscription; // The handle of the client in the subscribers of its
+                         // shard, while it's on the games page
+  uint64_t seeking; // The handle of the client in the seekers of its shard,
+                    // while it's waiting to be matched into a game
+  int rating;       // Used by the matchmaker (only used by the server)
+  BOOL is_bot;      // Played by the server itself (see bot.h)
+  void *watching;   // The game that the client is spectating (only used by
+                    // the server, once the client is on the shard of the game)
+  uint64_t spectator; // The handle of the client in the spectators of the
+                      // game it is watching. While it's on its way over to
+                      // the shard of the game, the handle of the game in
+                      // the running games instead.
+  // NOTE: The rest are only used by the server.
+  void *shard;             // The shard the client is on (or on its way to)
+  uint64_t session;        // The handle of the client in the sessions, once it
+                           // has a name (see GRACE_PERIOD_ENV)
+  uint64_t resume_secret;  // Has to match for the session to be resumed
+  wheel_timer idle_timer;  // Disconnects the client once it has been quiet
+                           // for too long (see IDLE_TIMEOUT_ENV)
+  wheel_timer grace_timer; // Gives up on the client, while its connection is
+                           // down
+  wheel_timer stall_timer; // Disconnects the client, while it isn't keeping
+                           // up with what it's sent (see STALL_TIMEOUT_ENV)
 } client_t;
 #endif
 
@@ -104,12 +121,20 @@ struct node {
   struct node *next;
 };
 
+struct POOL_T;
+
 typedef struct LINKEDLIST_T {
   struct node *head;
   struct node *tail;
+  struct POOL_T *pool; // Where the nodes come from (NULL for malloc)
 } LinkedList;
 
 LinkedList *init_list();
+/**
+ * @brief Creates a list that takes its nodes from `pool` (which must be a pool
+ * of `struct node`s) instead of malloc.
+ */
+LinkedList *init_pooled_list(struct POOL_T *pool);
 int push_node(LinkedList *list, NodeValue value);
 int push_node_at(LinkedList *list, NodeValue value, int index);
 NodeValue pop_node(LinkedList *list);
@@ -137,19 +162,19 @@ void free_stack(stck_t *stack);
 /*
  * HashMap
  */
-/* #define INITIAL_MAP_SIZE 1000 */
-/* #define LOAD_FACTOR 0.75 */
-/* #define GROWTH_FACTOR 2 */
+// The map uses open addressing with Robin Hood hashing: every entry lives
+// directly in the bucket array, and entries that are further away from their
+// ideal bucket take the place of ones that are closer to theirs. This keeps
+// the probe sequences short enough that a lookup touches one or two cache
+// lines. When the map grows, the entries are moved over to the new table a
+// few at a time on each `put`/`remove_value`, instead of all at once.
+#define INITIAL_MAP_SIZE 16 // Always rounded up to a power of two
+#define GROWTH_FACTOR 2
+#define REHASH_STEP 4 // Minimum amount of entries moved over per operation
 #define NO_VALUE -1
 
-/* #define SHOULD_MAP_EXPAND(used, total) (float)used / total >= LOAD_FACTOR */
-
-#define HASH(key, size) (key % size)
-#define ZERO_HASHMAP(map)                                                      \
-  for (int i = 0; i < map.bucket_count; ++i)                                   \
-    map.buckets[i] = (Bucket) {                                                \
-      .key = NO_VALUE, .value = NO_VALUE, .next = NULL                         \
-    }
+// Grows once the map is 3/4 full (a load factor of 0.75)
+#define SHOULD_MAP_EXPAND(used, total) ((used) * 4 >= (total) * 3)
 
 typedef union {
   unsigned int i_value;
@@ -160,19 +185,28 @@ typedef union {
 
 typedef struct BUCKET_T {
   int key;
+  // How far away the entry is from the bucket that it hashed to, plus one.
+  // 0 means that the bucket is empty.
+  uint32_t distance;
   BucketValue value;
-  // pointer to next bucket in case of collision
-  struct BUCKET_T *next;
 } Bucket;
 
 typedef struct HASHMAP_T {
   Bucket *buckets;
-  int bucket_count;
-  int used_buckets;
-  LinkedList
-      *entry_ids; // We will use this to loop over the entries in the map.
+  int bucket_count; // Always a power of two
+  int used_buckets; // The amount of entries (in both tables while growing)
+
+  // The table we are growing out of, which is NULL when we aren't growing.
+  Bucket *old_buckets;
+  int old_bucket_count;
+  int rehash_index; // The next bucket in `old_buckets` to be moved over
+  int rehash_left;  // The amount of buckets in `old_buckets` left to visit
 } HashMap;
 
+/**
+ * @brief Creates a map with room for (at least) `map_size` buckets. The map
+ * will grow by itself, so this only needs to be a hint.
+ */
 HashMap new_hashmap(int map_size);
 void free_hashmap(HashMap *map);
 
@@ -180,6 +214,15 @@ void put(HashMap *map, int key, BucketValue value);
 BucketValue get(HashMap map, int key);
 void remove_value(HashMap *map, int key);
 
+/**
+ * @brief Walks over the entries of the map (in no particular order), straight
+ * out of the bucket arrays. The map must not be changed in the meantime.
+ *
+ * @param cursor Starts at 0, and is moved on past the entry that is returned
+ * @return The next entry, or NULL once there are none left
+ */
+Bucket *next_bucket(HashMap map, int *cursor);
+
 #ifndef HANDLE_SOCK_ERROR_FN
 #define HANDLE_SOCK_ERROR_FN
 /**
@@ -0,0 +1,200 @@
+#ifndef NOUGHTS_CROSSES_WIRE_H
+#define NOUGHTS_CROSSES_WIRE_H
+
+#include "utils.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cursors for writing and reading the serialization format described in
+// utils.h, without allocating a buffer per value.
+//
+// A writer encodes straight into a buffer that it is given (e.g. the write
+// queue of a connection, see `conn_frame_begin`), or into one that it grows
+// by itself. A reader decodes a buffer in place, so strings are handed back
+// as pointers into it instead of being copied.
+//
+// Neither of them stop at the first error. Once something does not fit (or
+// does not match), `has_failed` is set and everything after it is ignored, so
+// the check only needs to be done once at the end.
+
+// The encoded sizes of each type (type + length + data)
+#define WIRE_INT_SIZE 6
+#define WIRE_BOOL_SIZE 3
+#define WIRE_ENUM_SIZE 3
+#define WIRE_STRING_SIZE(length) ((length) + 3) // Includes the terminator
+#define WIRE_MAX_STRING 254 // The length has to fit into a byte (with '\0')
+#define WIRE_DELTA_SIZE 6
+#define WIRE_RESUME_SIZE 17
+
+// A change to the games page that the client keeps (see lobby.h), which is
+// encoded as [LOBBY_DELTA_FLAG, kind, 4 byte ID (BE)]. A game that is opened
+// is followed by its line (a string).
+// The client asks for another page in the same way, with the cursor as the ID.
+#ifndef LOBBY_DELTA_FLAG
+#define LOBBY_DELTA_FLAG 0x06
+#endif
+
+// The most games that are on a page
+#ifndef LOBBY_PAGE_SIZE
+#define LOBBY_PAGE_SIZE 10
+#endif
+
+enum LOBBY_DELTA_KIND {
+  // Forget every game, the whole page follows. The ID is the amount of games
+  // (on every page) and is followed by how many come before this page (int).
+  LOBBY_RESET = 1,
+  LOBBY_GAME_OPENED,
+  LOBBY_GAME_FILLED, // Someone has joined it, so it's no longer on the page
+  LOBBY_GAME_CLOSED, // The host left before anyone joined
+  // Client -> Server
+  LOBBY_PAGE_FROM,   // The page starting from the game with the ID (or after)
+  LOBBY_PAGE_BEFORE, // The page that comes before the game with the ID
+};
+
+// What a client needs to get back into its session after its connection has
+// dropped (see GRACE_PERIOD_ENV), encoded as [RESUME_FLAG, 8 byte session
+// (BE), 8 byte secret (BE)]. The server sends it once the name has been
+// accepted (and again whenever the session is resumed, as the secret changes),
+// and the client sends it back as the first frame of its new connection,
+// instead of a name.
+#ifndef RESUME_FLAG
+#define RESUME_FLAG 0x07
+#endif
+
+typedef struct {
+  uint64_t session;
+  uint64_t secret;
+} resume_token;
+
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t cap;
+  BOOL is_growable; // If set, `buf` is ours and is grown when it is full
+  BOOL has_failed;
+} wire_writer;
+
+typedef struct {
+  const char *buf;
+  size_t len;
+  size_t pos;
+  BOOL has_failed;
+} wire_reader;
+
+/**
+ * @brief Creates a writer over `cap` bytes of `buf`. Anything that does not
+ * fit fails the writer.
+ */
+wire_writer wire_writer_fixed(char *buf, size_t cap);
+
+/**
+ * @brief Creates a writer with a buffer of its own, which the caller takes
+ * ownership of (`writer.buf`) once they are done.
+ */
+wire_writer wire_writer_growable(size_t cap);
+
+void wire_write_int(wire_writer *writer, int i);
+void wire_write_bool(wire_writer *writer, BOOL b);
+void wire_write_enum(wire_writer *writer, int e);
+void wire_write_string(wire_writer *writer, const char *str);
+
+/**
+ * @brief Writes a string (as `wire_write_string` would) from a format.
+ */
+void wire_write_stringf(wire_writer *writer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Writes the formatted text as is (including its NULL terminator),
+ * which is what the client prints straight to the screen.
+ */
+void wire_write_text(wire_writer *writer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+void wire_write_vtext(wire_writer *writer, const char *format, va_list args);
+
+void wire_write_raw(wire_writer *writer, const void *data, size_t len);
+
+/**
+ * @brief Writes the start of a lobby delta (see LOBBY_DELTA_FLAG).
+ */
+void wire_write_delta(wire_writer *writer, int kind, int id);
+void wire_write_resume(wire_writer *writer, resume_token token);
+
+/**
+ * @brief Creates a reader over `len` bytes of `buf`.
+ * NOTE: The client leaves the terminator off of the last string in a frame,
+ * so `buf[len]` must be readable and '\0' (as it is for the frames from
+ * `conn_next_frame`).
+ */
+wire_reader wire_reader_init(const char *buf, size_t len);
+
+/**
+ * @brief The type of the next value (e.g. INT_SERIALIZE_FLAG), or -1 if there
+ * is nothing left.
+ */
+int wire_peek(wire_reader *reader);
+
+int wire_read_int(wire_reader *reader);
+// TRUE or FALSE, or -1 if the next value isn't a bool
+int wire_read_bool(wire_reader *reader);
+int wire_read_enum(wire_reader *reader);
+
+/**
+ * @brief Reads the start of a lobby delta.
+ *
+ * @param id Set to the ID of the game
+ * @return The kind of the delta, or -1 on failure
+ */
+int wire_read_delta(wire_reader *reader, int *id);
+
+/**
+ * @brief Reads a resume token (see RESUME_FLAG).
+ *
+ * @return 0 on success, -1 if the next value isn't one
+ */
+int wire_read_resume(wire_reader *reader, resume_token *token);
+
+/**
+ * @brief Reads a string in place.
+ *
+ * @param len If not NULL, set to the length of the string (without the
+ * terminator)
+ * @return The string (pointing into the buffer), or NULL on failure
+ */
+const char *wire_read_string(wire_reader *reader, size_t *len);
+
+// Every frame of the protocol that never changes, encoded once at compile
+// time so that sending one is just a pointer and a length (see
+// `wire_constants`).
+typedef enum WIRE_CONSTANT_ID {
+  // Client -> Server
+  WIRE_VIEW_GAMES,  // int 1
+  WIRE_CREATE_GAME, // int 2
+  WIRE_JOIN,        // string " "
+  WIRE_WATCH,       // string "w"
+  WIRE_BACK,        // "b" (raw)
+  // Server -> Client
+  WIRE_NAME_ACCEPTED,   // int 1
+  WIRE_NAME_REJECTED,   // int -1
+  WIRE_GAME_JOINED,     // string "joined"
+  WIRE_GAME_WATCHED,    // string "watching"
+  WIRE_GAME_EXIT,       // int GAME_SIG_EXIT
+  WIRE_RESUMED,         // string "resumed"
+  WIRE_RESUME_REJECTED, // string "expired"
+  WIRE_CONSTANT_COUNT
+} wire_constant_id;
+
+typedef struct {
+  const char *data;
+  int len; // Includes the NULL terminator that comes with the literal
+} wire_constant;
+
+// NOTE: Works for string literals and `char[]`s (not pointers). Each is sent
+// with its terminator, which is the length that the `serialize_*` versions
+// were always sent with.
+#define WIRE_CONSTANT(literal) {literal, sizeof(literal)}
+
+extern const wire_constant wire_constants[WIRE_CONSTANT_COUNT];
+
+#endif
@@ -0,0 +1,178 @@
+#include "lib/lobby.h"
+#include "lib/resources.h"
+
+lobby_t *lobby_init() {
+  lobby_t *lobby = calloc(1, sizeof(lobby_t));
+  lobby->capacity = LOBBY_INITIAL_SIZE;
+  lobby->epoch = 1;
+  lobby->next_id = 1;
+  lobby->entries = calloc(lobby->capacity, sizeof(lobby_entry *));
+  return lobby;
+}
+
+void lobby_free(lobby_t *lobby) {
+  for (int i = 0; i < lobby->count; ++i)
+    free(lobby->entries[i]);
+  free(lobby->entries);
+  conn_shared_release(lobby->page);
+  free(lobby);
+}
+
+// Throws away the page (it is put together again the next time it's needed)
+// and remembers the change for `lobby_deltas`.
+static void lobby_changed(lobby_t *lobby, lobby_entry *entry, int kind) {
+  conn_shared_release(lobby->page);
+  lobby->page = NULL;
+  lobby->epoch++;
+  if (kind == LOBBY_GAME_OPENED)
+    entry->opened_epoch = lobby->epoch;
+  lobby->changes[lobby->epoch % LOBBY_MAX_CHANGES] =
+      (lobby_change){.epoch = lobby->epoch,
+                     .opened_epoch = entry->opened_epoch,
+                     .id = entry->id,
+                     .kind = kind};
+}
+
+int lobby_add(lobby_t *lobby, const char *host_name) {
+  lobby_entry *entry = malloc(sizeof(lobby_entry));
+  entry->id = lobby->next_id;
+
+  wire_writer writer = wire_writer_fixed(entry->delta, LOBBY_ENTRY_SIZE);
+  wire_write_delta(&writer, LOBBY_GAME_OPENED, entry->id);
+  // NOTE: Every game on the page is waiting for its second player.
+  wire_write_stringf(&writer, game_info_template, host_name, 1);
+  if (writer.has_failed) {
+    free(entry);
+    return -1;
+  }
+  entry->len = writer.len;
+  lobby->next_id++;
+
+  if (lobby->count == lobby->capacity) {
+    lobby->capacity *= 2;
+    lobby->entries =
+        realloc(lobby->entries, lobby->capacity * sizeof(lobby_entry *));
+  }
+  lobby->entries[lobby->count++] = entry;
+  lobby_changed(lobby, entry, LOBBY_GAME_OPENED);
+  return entry->id;
+}
+
+// The index of the first game with an ID of at least `id`. The entries are
+// kept in the order of their IDs, so they can be searched.
+static int lobby_lower_bound(lobby_t *lobby, int id) {
+  int low = 0, high = lobby->count;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if (lobby->entries[middle]->id < id)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+static lobby_entry *lobby_find(lobby_t *lobby, int id) {
+  int i = lobby_lower_bound(lobby, id);
+  return i < lobby->count && lobby->entries[i]->id == id ? lobby->entries[i]
+                                                         : NULL;
+}
+
+int lobby_remove(lobby_t *lobby, int id, int kind) {
+  int i = lobby_lower_bound(lobby, id);
+  if (i == lobby->count || lobby->entries[i]->id != id)
+    return -1;
+  lobby_entry *entry = lobby->entries[i];
+  // NOTE: Only the pointers are moved along, which is a single memmove.
+  memmove(lobby->entries + i, lobby->entries + i + 1,
+          (lobby->count - i - 1) * sizeof(lobby_entry *));
+  lobby->count--;
+  lobby_changed(lobby, entry, kind);
+  free(entry);
+  return 0;
+}
+
+int lobby_cursor_before(lobby_t *lobby, int id) {
+  int start = lobby_lower_bound(lobby, id) - LOBBY_PAGE_SIZE;
+  return start > 0 ? lobby->entries[start]->id : 0;
+}
+
+conn_shared *lobby_page(lobby_t *lobby, int cursor) {
+  int start = lobby_lower_bound(lobby, cursor);
+  // NOTE: Everything from the cursor has gone, so the last page is shown
+  // instead of an empty one.
+  if (start == lobby->count)
+    start = lobby->count > LOBBY_PAGE_SIZE ? lobby->count - LOBBY_PAGE_SIZE : 0;
+  int end = start + LOBBY_PAGE_SIZE < lobby->count ? start + LOBBY_PAGE_SIZE
+                                                   : lobby->count;
+
+  // The first page is where everyone starts, so it is the one that is kept.
+  if (start == 0 && lobby->page != NULL)
+    return conn_shared_retain(lobby->page);
+
+  // Work out the size up front, so that the page is a single allocation.
+  size_t size = CONN_HEADER_SIZE + WIRE_DELTA_SIZE + WIRE_INT_SIZE;
+  for (int i = start; i < end; ++i)
+    size += CONN_HEADER_SIZE + lobby->entries[i]->len;
+
+  conn_shared *page = conn_shared_init(size);
+  char reset[WIRE_DELTA_SIZE + WIRE_INT_SIZE];
+  wire_writer writer = wire_writer_fixed(reset, sizeof(reset));
+  wire_write_delta(&writer, LOBBY_RESET, lobby->count);
+  wire_write_int(&writer, start);
+  conn_shared_append(page, reset, writer.len);
+
+  for (int i = start; i < end; ++i)
+    conn_shared_append(page, lobby->entries[i]->delta, lobby->entries[i]->len);
+
+  if (start != 0)
+    return page;
+  lobby->page = page;
+  return conn_shared_retain(page);
+}
+
+// Whether a change still has to be sent to someone who has the page from
+// `epoch`, or if a later one has cancelled it out. Sets `entry` to the game
+// of a change that opened it.
+static BOOL lobby_is_change_needed(lobby_t *lobby, lobby_change *change,
+                                   uint64_t epoch, lobby_entry **entry) {
+  *entry = NULL;
+  if (change->kind == LOBBY_GAME_OPENED) {
+    // Only if it's still open
+    *entry = lobby_find(lobby, change->id);
+    return *entry != NULL;
+  }
+  // Only if they have been told about it being opened
+  return change->opened_epoch <= epoch;
+}
+
+conn_shared *lobby_deltas(lobby_t *lobby, uint64_t epoch) {
+  if (epoch == 0 || epoch > lobby->epoch ||
+      lobby->epoch - epoch > LOBBY_MAX_CHANGES)
+    return NULL;
+
+  lobby_entry *entry;
+  size_t size = 0;
+  for (uint64_t e = epoch + 1; e <= lobby->epoch; ++e) {
+    lobby_change *change = &lobby->changes[e % LOBBY_MAX_CHANGES];
+    if (lobby_is_change_needed(lobby, change, epoch, &entry))
+      size += CONN_HEADER_SIZE +
+              (entry != NULL ? (size_t)entry->len : WIRE_DELTA_SIZE);
+  }
+
+  conn_shared *deltas = conn_shared_init(size);
+  for (uint64_t e = epoch + 1; e <= lobby->epoch; ++e) {
+    lobby_change *change = &lobby->changes[e % LOBBY_MAX_CHANGES];
+    if (!lobby_is_change_needed(lobby, change, epoch, &entry))
+      continue;
+    if (entry != NULL) {
+      conn_shared_append(deltas, entry->delta, entry->len);
+      continue;
+    }
+    char delta[WIRE_DELTA_SIZE];
+    wire_writer writer = wire_writer_fixed(delta, sizeof(delta));
+    wire_write_delta(&writer, change->kind, change->id);
+    conn_shared_append(deltas, delta, writer.len);
+  }
+  return deltas;
+}
@@ -0,0 +1,105 @@
+#include "lib/matchmaker.h"
+
+void matchmaker_init(matchmaker_t *matchmaker, enum MATCHMAKER_MODE mode) {
+  matchmaker->mode = mode;
+  for (int i = 0; i < MATCHMAKER_BUCKETS; ++i)
+    matchmaker->buckets[i] = new_queue();
+  matchmaker->occupied = 0;
+  matchmaker->next_sequence = 0;
+  matchmaker->count = 0;
+}
+
+int matchmaker_mode_from_name(const char *name) {
+  if (!strcmp(name, "fifo"))
+    return MATCH_FIFO;
+  if (!strcmp(name, "rating"))
+    return MATCH_RATING;
+  if (!strcmp(name, "rtt"))
+    return MATCH_RTT;
+  return -1;
+}
+
+int matchmaker_bucket(matchmaker_t *matchmaker, match_profile profile) {
+  int bucket;
+  switch (matchmaker->mode) {
+  case MATCH_RATING:
+    bucket = profile.rating / MATCHMAKER_RATING_STEP;
+    break;
+  case MATCH_RTT:
+    // NOTE: Someone whose RTT isn't known is treated as being close by.
+    bucket = profile.rtt / MATCHMAKER_RTT_STEP;
+    break;
+  default:
+    bucket = 0;
+  }
+  return CLAMP(bucket, 0, MATCHMAKER_BUCKETS - 1);
+}
+
+void matchmaker_add(matchmaker_t *matchmaker, match_entry *entry,
+                    match_profile profile) {
+  entry->bucket = matchmaker_bucket(matchmaker, profile);
+  entry->sequence = matchmaker->next_sequence++;
+  queue_push(&matchmaker->buckets[entry->bucket], &entry->link);
+  matchmaker->occupied |= 1ULL << entry->bucket;
+  matchmaker->count++;
+}
+
+int matchmaker_remove(matchmaker_t *matchmaker, match_entry *entry) {
+  queue_t *bucket = &matchmaker->buckets[entry->bucket];
+  if (queue_remove(bucket, &entry->link) != 0)
+    return -1;
+  if (bucket->count == 0)
+    matchmaker->occupied &= ~(1ULL << entry->bucket);
+  matchmaker->count--;
+  return 0;
+}
+
+// The entry at the front of a bucket
+static match_entry *matchmaker_oldest(matchmaker_t *matchmaker, int bucket) {
+  return queue_entry(matchmaker->buckets[bucket].head, match_entry, link);
+}
+
+match_entry *matchmaker_match(matchmaker_t *matchmaker, match_profile profile) {
+  if (matchmaker->occupied == 0)
+    return NULL;
+
+  int bucket = matchmaker_bucket(matchmaker, profile);
+  // The closest occupied buckets from `bucket` upwards and below it
+  uint64_t mask = 1ULL << bucket;
+  uint64_t above = matchmaker->occupied & ~(mask - 1);
+  uint64_t below = matchmaker->occupied & (mask - 1);
+  int up = above != 0 ? __builtin_ctzll(above) : -1;
+  int down = below != 0 ? 63 - __builtin_clzll(below) : -1;
+
+  int best;
+  if (up == -1) {
+    best = down;
+  } else if (down == -1 || up - bucket < bucket - down) {
+    best = up;
+  } else if (bucket - down < up - bucket) {
+    best = down;
+  } else {
+    best = matchmaker_oldest(matchmaker, up)->sequence <
+                   matchmaker_oldest(matchmaker, down)->sequence
+               ? up
+               : down;
+  }
+
+  match_entry *entry = matchmaker_oldest(matchmaker, best);
+  matchmaker_remove(matchmaker, entry);
+  return entry;
+}
+
+void matchmaker_rate(int *winner, int *loser) {
+  // NOTE: Elo gives K / 2 for players with the same rating, and the curve
+  // goes up by about K for every 800 that the loser is rated above the winner
+  // around there.
+  int change = MATCHMAKER_RATING_K / 2 +
+               (*loser - *winner) * MATCHMAKER_RATING_K / 800;
+  if (change < 1)
+    change = 1;
+  if (change > MATCHMAKER_RATING_K - 1)
+    change = MATCHMAKER_RATING_K - 1;
+  *winner += change;
+  *loser -= change;
+}
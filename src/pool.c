@@ -0,0 +1,65 @@
+#include "lib/pool.h"
+#include <stdalign.h>
+#include <stdlib.h>
+
+typedef struct POOL_SLAB_T {
+  struct POOL_SLAB_T *next;
+  alignas(max_align_t) char objects[];
+} pool_slab;
+
+pool_t *pool_init(size_t object_size, size_t slab_objects) {
+  pool_t *pool = calloc(1, sizeof(pool_t));
+  // Every object has to be able to hold the free list pointer, and stay
+  // aligned when they are laid out next to each other.
+  if (object_size < sizeof(void *))
+    object_size = sizeof(void *);
+  size_t align = alignof(max_align_t);
+  pool->object_size = (object_size + align - 1) / align * align;
+  pool->slab_objects = slab_objects != 0 ? slab_objects : POOL_SLAB_OBJECTS;
+  pool->free_objects = NULL;
+  pool->slabs = NULL;
+  return pool;
+}
+
+void pool_free(pool_t *pool) {
+  while (pool->slabs != NULL) {
+    pool_slab *next = pool->slabs->next;
+    free(pool->slabs);
+    pool->slabs = next;
+  }
+  free(pool);
+}
+
+static void pool_grow(pool_t *pool) {
+  pool_slab *slab =
+      malloc(sizeof(pool_slab) + pool->object_size * pool->slab_objects);
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->slab_count++;
+
+  // Thread the new objects onto the free list (back to front, so that they
+  // are handed out in address order).
+  for (size_t i = pool->slab_objects; i > 0; --i) {
+    void *object = slab->objects + (i - 1) * pool->object_size;
+    *(void **)object = pool->free_objects;
+    pool->free_objects = object;
+  }
+}
+
+void *pool_alloc(pool_t *pool) {
+  if (pool->free_objects == NULL)
+    pool_grow(pool);
+
+  void *object = pool->free_objects;
+  pool->free_objects = *(void **)object;
+  pool->in_use++;
+  return object;
+}
+
+void pool_release(pool_t *pool, void *object) {
+  if (object == NULL)
+    return;
+  *(void **)object = pool->free_objects;
+  pool->free_objects = object;
+  pool->in_use--;
+}
@@ -0,0 +1,41 @@
+#include "lib/queue.h"
+
+queue_t new_queue() {
+  return (queue_t){.head = NULL, .tail = NULL, .count = 0};
+}
+
+void queue_push(queue_t *queue, queue_link *link) {
+  link->prev = queue->tail;
+  link->next = NULL;
+  link->is_queued = TRUE;
+  if (queue->tail != NULL)
+    queue->tail->next = link;
+  else
+    queue->head = link;
+  queue->tail = link;
+  queue->count++;
+}
+
+queue_link *queue_pop(queue_t *queue) {
+  queue_link *link = queue->head;
+  if (link != NULL)
+    queue_remove(queue, link);
+  return link;
+}
+
+int queue_remove(queue_t *queue, queue_link *link) {
+  if (!link->is_queued)
+    return -1;
+  if (link->prev != NULL)
+    link->prev->next = link->next;
+  else
+    queue->head = link->next;
+  if (link->next != NULL)
+    link->next->prev = link->prev;
+  else
+    queue->tail = link->prev;
+  link->prev = link->next = NULL;
+  link->is_queued = FALSE;
+  queue->count--;
+  return 0;
+}
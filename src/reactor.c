@@ -0,0 +1,125 @@
+#include "lib/reactor.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+
+// NOTE: We use epoll in level-triggered mode, so any data that we do not
+// consume in one iteration will be reported again in the next one.
+static uint32_t to_epoll_events(int events) {
+  uint32_t epoll_events = 0;
+  if (events & REACTOR_READ)
+    epoll_events |= EPOLLIN | EPOLLRDHUP;
+  if (events & REACTOR_WRITE)
+    epoll_events |= EPOLLOUT;
+  return epoll_events;
+}
+
+int reactor_init() { return epoll_create1(EPOLL_CLOEXEC); }
+
+int reactor_add(int reactor, int fd, int events, uint64_t token) {
+  struct epoll_event ev = {.events = to_epoll_events(events),
+                           .data.u64 = token};
+  return epoll_ctl(reactor, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int reactor_mod(int reactor, int fd, int events, uint64_t token) {
+  struct epoll_event ev = {.events = to_epoll_events(events),
+                           .data.u64 = token};
+  return epoll_ctl(reactor, EPOLL_CTL_MOD, fd, &ev);
+}
+
+int reactor_del(int reactor, int fd) {
+  // NOTE: Kernels before 2.6.9 require a non-NULL event even though it is
+  // ignored.
+  struct epoll_event ev = {0};
+  return epoll_ctl(reactor, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int reactor_wait(int reactor, reactor_event *events, int max_events,
+                 int timeout_ms) {
+  struct epoll_event ready[REACTOR_MAX_EVENTS];
+  if (max_events > REACTOR_MAX_EVENTS)
+    max_events = REACTOR_MAX_EVENTS;
+
+  int count = epoll_wait(reactor, ready, max_events, timeout_ms);
+  for (int i = 0; i < count; ++i) {
+    events[i].token = ready[i].data.u64;
+    events[i].events = 0;
+    if (ready[i].events & EPOLLIN)
+      events[i].events |= REACTOR_READ;
+    if (ready[i].events & EPOLLOUT)
+      events[i].events |= REACTOR_WRITE;
+    if (ready[i].events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR))
+      events[i].events |= REACTOR_HUP;
+  }
+  return count;
+}
+
+#else
+#include <sys/event.h>
+#include <sys/time.h>
+
+// kqueue tracks reading and writing as two separate filters, so we always
+// register both and then just enable/disable them.
+static int kqueue_apply(int reactor, int fd, int events, uint64_t token) {
+  struct kevent changes[2];
+  EV_SET(&changes[0], fd, EVFILT_READ,
+         EV_ADD | (events & REACTOR_READ ? EV_ENABLE : EV_DISABLE), 0, 0,
+         (void *)(uintptr_t)token);
+  EV_SET(&changes[1], fd, EVFILT_WRITE,
+         EV_ADD | (events & REACTOR_WRITE ? EV_ENABLE : EV_DISABLE), 0, 0,
+         (void *)(uintptr_t)token);
+  return kevent(reactor, changes, 2, NULL, 0, NULL);
+}
+
+int reactor_init() { return kqueue(); }
+
+int reactor_add(int reactor, int fd, int events, uint64_t token) {
+  return kqueue_apply(reactor, fd, events, token);
+}
+
+int reactor_mod(int reactor, int fd, int events, uint64_t token) {
+  return kqueue_apply(reactor, fd, events, token);
+}
+
+int reactor_del(int reactor, int fd) {
+  struct kevent changes[2];
+  EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+  EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+  return kevent(reactor, changes, 2, NULL, 0, NULL);
+}
+
+int reactor_wait(int reactor, reactor_event *events, int max_events,
+                 int timeout_ms) {
+  struct kevent ready[REACTOR_MAX_EVENTS];
+  if (max_events > REACTOR_MAX_EVENTS)
+    max_events = REACTOR_MAX_EVENTS;
+
+  struct timespec timeout = {.tv_sec = timeout_ms / 1000,
+                             .tv_nsec = (timeout_ms % 1000) * 1000000L};
+  int count = kevent(reactor, NULL, 0, ready, max_events,
+                     timeout_ms < 0 ? NULL : &timeout);
+  for (int i = 0; i < count; ++i) {
+    events[i].token = (uint64_t)(uintptr_t)ready[i].udata;
+    events[i].events = ready[i].filter == EVFILT_WRITE ? REACTOR_WRITE
+                                                       : REACTOR_READ;
+    if (ready[i].flags & (EV_EOF | EV_ERROR))
+      events[i].events |= REACTOR_HUP;
+  }
+  return count;
+}
+#endif
+
+void reactor_free(int reactor) {
+  if (reactor != -1)
+    close(reactor);
+}
+
+uint64_t reactor_now_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
@@ -0,0 +1,36 @@
+#include "lib/resources.h"
+
+StringResource main_menu = "\x1b[;1mWelcome to XO Online!\n\n1)\tView Active "
+                           "Games\n2)\tCreate new Game\n3)\tQuit\x1b[0;0m\n";
+
+StringResource game_info_template = "%s's game\t[%d/2]\n";
+
+StringResource view_games =
+    "\x1b[32;1mThere %s currently %d "
+    "available %s.\n\r\n\x1b[0;1m(SPACE) Join Game\n(W) Watch a Game (type "
+    "its number first to pick one)\n(R) Refresh Games\n(N) Next Page\n(P) "
+    "Previous Page\n(B) Go back to Home Page\n(Q) Quit\x1b[0;0m\n\r\n";
+
+StringResource page_info = "\x1b[;3mShowing games %d-%d of %d\x1b[0;0m\n\r\n";
+
+StringResource waiting_room =
+    "\x1b[;1mYou're currently waiting for another player to join..\nB) Leave "
+    "Room\nQ) Quit\x1b[0;0m\n\r\n\x1b[;3mIf you don't want to wait for too "
+    "long, it might "
+    "be best to leave the room\nand join someone someone else's "
+    "game.\x1b[0;0m\n";
+
+StringResource playing_header =
+    "\x1b[;1mYou're playing against %s! (game #%u)\n";
+StringResource watching_header =
+    "\x1b[;1mYou're watching %s play against %s!\n(B) Stop Watching\n";
+
+StringResource board_label_template = "\x1b[30;1m%*d\x1b[0;0m";
+StringResource board_piece_template = "\x1b[3%d;1m%*c\x1b[0;0m";
+StringResource board_turn_template =
+    "\r\n\x1b[2K\x1b[;1mIt is %s your turn.\x1b[;0m";
+StringResource board_watch_template =
+    "\r\n\x1b[2K\x1b[;1mIt is %c's turn.\x1b[;0m";
+
+StringResource game_end =
+    "\x1b[2K\r\x1b[33;1mSorry, the game has ended!\r\n\x1b[0;0m";
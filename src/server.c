@@ -10,39 +10,185 @@ void server_sigint(int sig) {
   server_interrupted = 1;
 }
 
-char *accepted_name_s_string, *rejected_name_s_string;
-serialized_string accepted_player_s_string;
-char *game_destroy_s_string;
+// The screens that are sent as they are (alongside `wire_constants`)
+static const wire_constant clear_screen_frame = WIRE_CONSTANT(clear_screen);
+static const wire_constant current_player_turn_frame =
+    WIRE_CONSTANT(current_player_turn);
+static const wire_constant enemy_turn_frame = WIRE_CONSTANT(enemy_turn);
+static const wire_constant save_cursor_frame = WIRE_CONSTANT("\0337");
+static const wire_constant restore_cursor_frame = WIRE_CONSTANT("\0338");
+
+// The board before anyone has moved, which depends on its size so it's drawn
+// once when starting up (see `server_draw_prefilled`).
+static char prefilled[BOARD_TEXT_SIZE + 2];
+static wire_constant prefilled_frame;
+
+void server_draw_prefilled() {
+  char *cells[BOARD_CELLS] = {0};
+  int len = board_draw(prefilled, BOARD_TEXT_SIZE, cells);
+  memcpy(prefilled + len, "\r\n", 3);
+  prefilled_frame = (wire_constant){prefilled, len + 3};
+}
 
-/* pthread_t server_thread; */
-/* pthread_t game_handling_thread; */
+int server_thread_count() {
+  char *configured = getenv(SERVER_THREADS_ENV);
+  long count = configured != NULL ? strtol(configured, NULL, 10) : 0;
+  if (count < 1)
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+  return CLAMP(count, 1, 64);
+}
 
-int main() {
+enum MATCHMAKER_MODE server_matchmaker_mode() {
+  char *configured = getenv(MATCHMAKING_ENV);
+  int mode = configured != NULL ? matchmaker_mode_from_name(configured) : -1;
+  return mode != -1 ? mode : MATCH_FIFO;
+}
 
-  accepted_name_s_string = serialize_int(1);
-  rejected_name_s_string = serialize_int(-1);
-  game_destroy_s_string = serialize_int(GAME_SIG_EXIT);
-  accepted_player_s_string = serialize_string("joined");
+int server_match_interval() {
+  char *configured = getenv(MATCH_INTERVAL_ENV);
+  long interval = configured != NULL ? strtol(configured, NULL, 10) : 0;
+  return CLAMP(interval, 0, 10000);
+}
 
-  // Initialize the server
-  server_t *server = server_init(PORT);
-  int listen_status = server_listen(server);
-  if (listen_status != 0) {
-    handle_sock_error(errno);
-    exit(1);
+int server_bot_delay() {
+  char *configured = getenv(BOT_DELAY_ENV);
+  long delay = configured != NULL ? strtol(configured, NULL, 10) : 0;
+  return CLAMP(delay, 0, 24 * 60 * 60 * 1000);
+}
+
+int server_grace_period() {
+  char *configured = getenv(GRACE_PERIOD_ENV);
+  long period = configured != NULL ? strtol(configured, NULL, 10) : GRACE_PERIOD;
+  return CLAMP(period, 0, 24 * 60 * 60 * 1000);
+}
+
+// Reads one of the timeouts (ms) from the environment, which is `fallback` if
+// it isn't set
+int server_timeout(const char *name, int fallback) {
+  char *configured = getenv(name);
+  long timeout = configured != NULL ? strtol(configured, NULL, 10) : fallback;
+  return CLAMP(timeout, 0, 24 * 60 * 60 * 1000);
+}
+
+int server_journal_interval() {
+  char *configured = getenv(JOURNAL_INTERVAL_ENV);
+  long interval = configured != NULL ? strtol(configured, NULL, 10) : 0;
+  return interval > 0 ? CLAMP(interval, 1, 10000) : JOURNAL_COMMIT_INTERVAL;
+}
+
+int main() {
+
+  signal(SIGINT, server_sigint);
+  // A peer that has gone away must not take the whole server down with it,
+  // we'll notice the disconnect through the reactor instead.
+  signal(SIGPIPE, SIG_IGN);
+
+  // NOTE: Only the main thread should handle SIGINT, so we block it before
+  // creating the reactor threads (they inherit the mask) and then wait for it
+  // down below.
+  sigset_t interrupt_mask, previous_mask;
+  sigemptyset(&interrupt_mask);
+  sigaddset(&interrupt_mask, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &interrupt_mask, &previous_mask);
+
+  server_draw_prefilled();
+  bot_init();
+
+  // Initialize the shards
+  int shard_count = server_thread_count();
+  server_shared_t *shared = server_shared_init(shard_count);
+  for (int i = 0; i < shard_count; ++i) {
+    server_t *server = server_init(PORT, shared, i);
+    int listen_status = server_listen(server);
+    if (listen_status != 0) {
+      handle_sock_error(errno);
+      exit(1);
+    }
+    shared->shards[i] = server;
   }
+  server_recover_games(shared);
+
+  // Start the servers and wait for connections
+  for (int i = 0; i < shard_count; ++i)
+    server_start(shared->shards[i]);
+
+  while (!server_interrupted)
+    sigsuspend(&previous_mask);
+
+  for (int i = 0; i < shard_count; ++i)
+    server_wake(shared->shards[i]);
+  for (int i = 0; i < shard_count; ++i)
+    pthread_join(shared->shards[i]->thread, NULL);
 
-  // Start the server and wait for connections
-  server_start(server);
-  server_unbind(server);
+  for (int i = 0; i < shard_count; ++i)
+    server_unbind(shared->shards[i]);
+  server_shared_free(shared);
+
+  printf("\x1b[33;1mAttempting to kill server instance now\x1b[0;0m\n");
   return 0;
 }
 
-server_t *server_init(short port) {
-  printf("\x1b[33;1mAttempting to initialise server on port %d\x1b[0m\n", port);
+server_shared_t *server_shared_init(int shard_count) {
+  server_shared_t *shared = calloc(1, sizeof(server_shared_t));
+  pthread_mutex_init(&shared->lock, NULL);
+  printf("\x1b[33;1mAttempting to create spaces for %d clients.\x1b[0m\n",
+         MAX_CLIENTS);
+  shared->client_ids = id_allocator_init(MAX_CLIENTS);
+  matchmaker_init(&shared->matchmaker, server_matchmaker_mode());
+  shared->match_interval = server_match_interval();
+  shared->bot_delay = server_bot_delay();
+  shared->lobby_timeout = server_timeout(LOBBY_TIMEOUT_ENV, LOBBY_TIMEOUT);
+  shared->move_timeout = server_timeout(MOVE_TIMEOUT_ENV, MOVE_TIMEOUT);
+  shared->idle_timeout = server_timeout(IDLE_TIMEOUT_ENV, IDLE_TIMEOUT);
+  shared->stall_timeout = server_timeout(STALL_TIMEOUT_ENV, STALL_TIMEOUT);
+  shared->running = new_slot_map();
+  shared->away = new_slot_map();
+  shared->grace_period = server_grace_period();
+  shared->sessions = new_slot_map();
+  shared->lobby = lobby_init();
+  // We don't really need to initialize the games
+  // hash here since we intiialize the client's hash on accept.
+  printf("\x1b[32;1mClient spaces created successfully\x1b[0m\n");
+  shared->shards = calloc(shard_count, sizeof(server_t *));
+  shared->shard_count = shard_count;
+  return shared;
+}
+
+void server_shared_free(server_shared_t *shared) {
+  // The games from the journal that nobody came back to (the rest went with
+  // their players). They stay in the journal for next time.
+  while (shared->away.count > 0) {
+    client_t *away = shared->away.values[shared->away.count - 1];
+    game_t *game = away->game;
+    for (int i = 0; i < 2; ++i) {
+      if (game->players[i]->handle != SLOT_HANDLE_NONE)
+        slot_map_remove(&shared->away, game->players[i]->handle);
+      free(game->players[i]->client_name);
+      free(game->players[i]);
+    }
+    free(game);
+  }
+  if (shared->journal != NULL)
+    journal_close(shared->journal);
+
+  id_allocator_free(shared->client_ids);
+  free_slot_map(&shared->running);
+  free_slot_map(&shared->away);
+  free_slot_map(&shared->sessions);
+  lobby_free(shared->lobby);
+  pthread_mutex_destroy(&shared->lock);
+  free(shared->shards);
+  free(shared);
+}
+
+server_t *server_init(short port, server_shared_t *shared, int shard_id) {
+  printf("\x1b[33;1mAttempting to initialise server %d on port %d\x1b[0m\n",
+         shard_id, port);
   server_t *server;
-  server = malloc(sizeof(server_t));
+  server = calloc(1, sizeof(server_t));
   server->port = port;
+  server->shard_id = shard_id;
+  server->shared = shared;
   // We want to create a socket for the server
   int socket_fd = socket(AF_INET, SOCK_STREAM, TCP);
   if (socket_fd == -1) {
@@ -60,6 +206,12 @@ server_t *server_init(short port) {
   server->socket = socket_fd;
   printf("\x1b[32;1mSocket created successfully\x1b[0m\n");
 
+  server->reactor = reactor_init();
+  if (server->reactor == -1) {
+    handle_sock_error(errno);
+    exit(1);
+  }
+
   // Bind the socket to the address
   printf("\x1b[33;1mAttempting to bind socket to address %hu\x1b[0m\n",
          htons(server_addr.sin_port));
@@ -72,9 +224,16 @@ server_t *server_init(short port) {
     exit(1);
   }
 
-  // Set the socket to reuse the address
+  // Set the socket to reuse the address.
+  // Every shard binds its own socket to the same port, SO_REUSEPORT lets the
+  // kernel balance the incoming connections between them.
   int optval = 1;
   setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+  if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &optval,
+                 sizeof(optval)) == -1) {
+    handle_sock_error(errno);
+    exit(1);
+  }
 
   int bind_status =
       bind(socket_fd, (struct sockaddr *)&server_addr, sizeof(server_addr));
@@ -85,15 +244,31 @@ server_t *server_init(short port) {
 
   printf("\x1b[32;1mSocket bound successfully\x1b[0m\n");
 
-  printf("\x1b[33;1mAttempting to create %d spaces for clients.\x1b[0m\n",
-         MAX_CLIENTS);
-  HashMap clients = new_hashmap(MAX_CLIENTS);
-  server->clients = clients;
-  server->games = init_list();
-  // We don't really need to initialize the games
-  // hash here since we intiialize the client's hash on accept.
+  server->clients = new_slot_map();
+  server->subscribers = new_slot_map();
+  server->seekers = new_slot_map();
+  timer_wheel_init(&server->timers, reactor_now_ms());
+  server->graced = new_slot_map();
+  atomic_init(&server->has_lobby_changed, FALSE);
 
-  printf("\x1b[32;1mClient spaces created successfully\x1b[0m\n");
+  // Set up the inbox that other shards use to hand clients over to us.
+  if (pipe(server->wake_pipe) == -1) {
+    handle_sock_error(errno);
+    exit(1);
+  }
+  for (int i = 0; i < 2; ++i) {
+    flags = fcntl(server->wake_pipe[i], F_GETFL, 0);
+    fcntl(server->wake_pipe[i], F_SETFL, flags | O_NONBLOCK);
+  }
+  if (reactor_add(server->reactor, server->wake_pipe[0], REACTOR_READ,
+                  WAKE_TOKEN) == -1) {
+    handle_sock_error(errno);
+    exit(1);
+  }
+  pthread_mutex_init(&server->inbox_lock, NULL);
+  server->inbox_pool = pool_init(sizeof(struct node), 0);
+  server->inbox = init_pooled_list(server->inbox_pool);
+  conn_batch_init(&server->batch);
 
   return server;
 }
@@ -107,298 +282,561 @@ int server_listen(server_t *server) {
     handle_sock_error(errno);
     exit(1);
   }
+  if (reactor_add(server->reactor, server->socket, REACTOR_READ,
+                  LISTEN_TOKEN) == -1) {
+    handle_sock_error(errno);
+    exit(1);
+  }
+  server->state = ACCEPTING;
   printf("\x1b[32;1mSocket listening successfully\x1b[0m\n");
   return listen_status;
 }
 
 client_t *server_accept(server_t *server) {
-  client_t *client = malloc(sizeof(client_t));
+  server_shared_t *shared = server->shared;
+  pthread_mutex_lock(&shared->lock);
+  BOOL is_full = id_allocator_is_full(shared->client_ids);
+  pthread_mutex_unlock(&shared->lock);
+  if (is_full) {
+    server_set_accepting(server, NOT_ACCEPTING);
+    return NULL;
+  }
+
   struct sockaddr_in client_addr;
   socklen_t client_addr_len = sizeof(client_addr);
 
   int client_socket =
       accept(server->socket, (struct sockaddr *)&client_addr, &client_addr_len);
   if (client_socket == -1) {
-    handle_sock_error(errno);
-    exit(1);
+    // The backlog has been drained (or the client gave up before we got to
+    // them), neither of which are fatal.
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED &&
+        errno != EINTR)
+      handle_sock_error(errno);
+    return NULL;
   }
 
+  client_t *client = malloc(sizeof(client_t));
+
   printf("\x1b[33;1mAttempting to accept client\x1b[0m\n");
   client->socket = client_socket;
   client->addr = client_addr;
   client->client_name = NULL;
   client->player_type = SPECTATOR;
   client->game = NULL;
-  client->last_sent_game_hash = 0;
+  client->last_seen_epoch = 0;
+  client->lobby_cursor = 0;
+  client->subscription = SLOT_HANDLE_NONE;
+  client->seeking = SLOT_HANDLE_NONE;
+  client->rating = MATCHMAKER_DEFAULT_RATING;
+  client->is_bot = FALSE;
+  client->watching = NULL;
+  client->spectator = SLOT_HANDLE_NONE;
+  client->shard = server;
+  client->session = SLOT_HANDLE_NONE;
+  client->resume_secret = 0;
+  timer_init(&client->idle_timer, &server_idle_expired);
+  timer_init(&client->grace_timer, &server_grace_expired);
+  timer_init(&client->stall_timer, &server_stall_expired);
   client->screen_state = SETUP_PAGE;
+  client->conn = conn_init(client_socket);
 
-  // We need to set the socket to blocking
+  // The reactor only ever tells us a socket is ready, so it has to be
+  // non-blocking for a read or write to never stall the whole shard
   int flags = fcntl(client_socket, F_GETFL, 0);
   int ret = fcntl(client_socket, F_SETFL, flags | O_NONBLOCK);
   if (ret == -1) {
     // We cannot accept the socket.
     close(client_socket);
+    conn_free(client->conn);
     free(client);
     return NULL;
   }
 
   // We need to get the next available ID
-  // Since the entry_ids are ordered in ascending
-  // we can just loop over them and find the first
-  // available ID
-  struct node *current = server->clients.entry_ids->head;
-  uint next_id = 1;
-
-  // If there are no available IDs in gaps,
-  // we can use the tail + 1
-  if (current == NULL) {
-    next_id = 1;
-  } else {
-    while (current != NULL) {
-      if ((uint)current->data.i_value != next_id) {
-        break;
-      }
-      next_id++;
-      current = current->next;
-    }
+  // NOTE: IDs are shared between all of the shards, as clients can move
+  // between them.
+  pthread_mutex_lock(&shared->lock);
+  client->client_id = id_alloc(shared->client_ids);
+  pthread_mutex_unlock(&shared->lock);
+  if (client->client_id == -1) {
+    // Another shard took the last ID since we checked
+    server_set_accepting(server, NOT_ACCEPTING);
+    close(client_socket);
+    conn_free(client->conn);
+    free(client);
+    return NULL;
   }
 
-  client->client_id = next_id;
+  client->handle = slot_map_insert(&server->clients, client);
+  if (server_attach(server, client) == -1) {
+    handle_sock_error(errno);
+    slot_map_remove(&server->clients, client->handle);
+    pthread_mutex_lock(&shared->lock);
+    id_release(shared->client_ids, client->client_id);
+    pthread_mutex_unlock(&shared->lock);
+    close(client_socket);
+    conn_free(client->conn);
+    free(client);
+    return NULL;
+  }
 
+  server_touch(server, client);
   printf("\x1b[32;1mClient %d accepted successfully\x1b[0m\n",
          client->client_id);
-
-  // We need to handle client/user creation
-  // The ID of the client is assigned by popping the next
-  // available ID from the stack
-  put(&server->clients, client->client_id, (BucketValue){.client = client});
   return client;
 }
 
 void server_serve(server_t *server) {
-  printf("\x1b[33;1mAttempting to serve clients\x1b[0m\n");
-  server->state = ACCEPTING;
-
-  // We want to use `poll` to check for new connections
-  struct pollfd fds[1];
-  fds[0].fd = server->socket;
-  fds[0].events = POLLIN;
-
-  char peek_buf[1] = {0};
-  char buf[1024] = {};
-
-  // If there is a new connection, we want to call
-  // `server_accept` and add the client to the list of clients
-  loop {
-    signal(SIGINT, server_sigint);
-    if (server_interrupted) {
-      server_unbind(server);
+  printf("\x1b[33;1mAttempting to serve clients on shard %d\x1b[0m\n",
+         server->shard_id);
+
+  // NOTE: Only sockets that are actually ready are handed back to us, so we
+  // never have to walk over idle clients. The main thread wakes us up through
+  // the `wake_pipe` once the server is interrupted, meaning that we don't need
+  // a timeout to notice it.
+  reactor_event events[REACTOR_MAX_EVENTS];
+
+  while (!server_interrupted) {
+    // NOTE: The only reasons we have to wake up by ourselves are to push the
+    // changes to the lobby that have been held back (see
+    // `server_push_lobby`), to match the next batch of seekers and for the
+    // nearest of the timers (idle clients, move clocks, games waiting in the
+    // lobby and clients that haven't come back in time).
+    int timeouts[] = {
+        server_lobby_timeout(server), server_match_timeout(server),
+        timer_wheel_timeout(&server->timers, reactor_now_ms())};
+    int timeout = -1;
+    for (size_t i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); ++i)
+      if (timeouts[i] != -1 && (timeout == -1 || timeouts[i] < timeout))
+        timeout = timeouts[i];
+    int ready =
+        reactor_wait(server->reactor, events, REACTOR_MAX_EVENTS, timeout);
+    if (ready == -1) {
+      if (errno != EINTR)
+        handle_sock_error(errno);
+      continue;
     }
 
-    // NOTE: First we need to poll the currently used file descriptors
-    // This is because we want to get the next available id BEFORE there is a
-    // connection rather than AFTER the connection. We can find the file
-    // descriptors in the map (server->clients->entry_ids) to check if there
-    // have been any disconnects After we have done this, we can begin
-    // handling connections.
-
-    struct node entry_id;
-    struct node *head = server->clients.entry_ids->head;
-    // Pointer to next entry id
-    struct node **next_entry_id = NULL;
-    BucketValue ret;
-    client_t *client;
-    while (head != NULL) {
-      entry_id = *head;
-      if (entry_id.next == NULL) {
-        next_entry_id = NULL;
-      } else {
-        next_entry_id = &entry_id.next;
-      }
-      // NOTE: Do not mistake this for `client->client_id`, they are not
-      // necessarily the same (depends on the hashing function)
-      int client_id = entry_id.data.i_value;
-      ret = get(server->clients, client_id);
-      if (ret.err == -1) {
-        head = entry_id.next;
+    for (int i = 0; i < ready; ++i) {
+      if (events[i].token == LISTEN_TOKEN) {
+        // Accept everything in the backlog, the listen socket is
+        // non-blocking so we'll stop once there is nobody left.
+        client_t *client;
+        while (server->state == ACCEPTING &&
+               (client = server_accept(server)) != NULL) {
+          printf("\x1b[32;1mClient %d connected successfully\x1b[0m\n",
+                 client->client_id);
+          client_send_text(client, "%d", client->client_id);
+        }
         continue;
-      }
-      client = ret.client;
-
-      // Check if the client has disconnected
-      int recv_status = recv(client->socket, peek_buf, 1, MSG_PEEK);
-
-      // The client has connected.
-      if (recv_status > 0) {
-        int received =
-            smart_recv(client->socket, buf, 1024); // Accept the whole buffer
-
-        // If the client does not have a name, we can assume that the buffer
-        // contains their name.
-        if (client->client_name == NULL) {
-          handle_client_name_set(client, buf);
-        } else if (deserialize_int(buf) == 1 &&
-                   (client->screen_state == HOME_PAGE ||
-                    client->screen_state ==
-                        GAME_VIEW_PAGE)) { // Also check for `GAME_VIEW_PAGE`,
-                                           // as the client might be requesting
-                                           // a refresh.
-          // The `render_games_page` function returns `-3` to let us know that
-          // we need to skip the iteration.
-          if (render_games_page(server, client) == -3)
-            continue;
-        } else if (!strcmp(buf, "b")) {
-          switch (client->screen_state) {
-          case IN_GAME_PAGE:
-            // We need to destroy the game.
-            handle_game_unbind(server, client);
-            client->screen_state = GAME_VIEW_PAGE;
-            client->last_sent_game_hash = 0;
-            render_games_page(server, client);
-            break;
-          default:
-            client->screen_state = HOME_PAGE;
-            client->last_sent_game_hash = 0;
+      } else if (events[i].token == WAKE_TOKEN) {
+        char drain[64];
+        while (read(server->wake_pipe[0], drain, sizeof(drain)) > 0)
+          ;
+
+        // Pick up any of the clients that have been handed to us
+        NodeValue arrival;
+        loop {
+          pthread_mutex_lock(&server->inbox_lock);
+          arrival = pop_node(server->inbox);
+          pthread_mutex_unlock(&server->inbox_lock);
+          if (arrival.err == -1)
             break;
-          }
-        } else if (!strcmp(buf, serialize_string(" ").str) &&
-                   client->screen_state == GAME_VIEW_PAGE) {
-          // The `handle_game_join` function returns `-3` to let us know that
-          // we need to skip the iteration.
-          if (handle_game_join(server, client) == -3)
-            continue;
-        } else if (deserialize_int(buf) == 2 &&
-                   client->screen_state == HOME_PAGE) {
-          handle_game_create(server, client);
-        } else if (client->game != NULL && is_game_sig(buf[0])) {
-          game_t *game = client->game;
-          int sig_type = buf[0];
-          int buf_len = buf[1] + 3;
-          int is_sender_player =
-              game->players[game->isCurrentPlayerTurn]->socket ==
-              client->socket;
-          if (sig_type == GAME_SIG_CHECK && is_sender_player) {
-            smart_send(game->players[!game->isCurrentPlayerTurn]->socket, buf,
-                       buf_len);
-          } else if (sig_type == GAME_SIG_CONFIRM && !is_sender_player) {
-            smart_send(game->players[game->isCurrentPlayerTurn]->socket, buf,
-                       buf_len);
-            game->isCurrentPlayerTurn ^= 1;
-          } else if (sig_type == GAME_SIG_WIN || sig_type == GAME_SIG_DRAW) {
-            smart_send(game->players[game->isCurrentPlayerTurn]->socket, buf,
-                       buf_len);
-          } else if (sig_type == GAME_SIG_CONFIRM_END) {
-            smart_send(game->players[!game->isCurrentPlayerTurn]->socket, buf,
-                       buf_len);
-            if (deserialize_bool(buf)) { // The game has ended.
-              game->players[0]->screen_state = game->players[1]->screen_state =
-                  GAME_VIEW_PAGE;
-              game->players[0]->last_sent_game_hash =
-                  game->players[1]->last_sent_game_hash = 0;
-              handle_game_unbind(server, game->players[0]);
-            }
-          }
+          handle_client_arrival(server, arrival.pointer);
         }
-        if (received > 0)
-          bzero(buf, received);
-      } else if (recv_status == 0) {
-        handle_client_disconnect(server, client, client_id);
+
+        // Another shard might have freed up a space for us
+        if (server->state == NOT_ACCEPTING)
+          server_set_accepting(server, ACCEPTING);
+        continue;
       }
 
-      // Set memory location of entry_id to the next entry id
-      if (next_entry_id == &entry_id.next)
-        head = entry_id.next;
-      else
-        head = NULL;
+      // NOTE: Do not mistake this for `client->client_id`, the token is the
+      // handle of the client in our slot map.
+      client_t *client = slot_map_get(&server->clients, events[i].token);
+      if (client == NULL)
+        continue; // The client was removed earlier in this iteration
+
+      // Carry on with anything that could not be written straight away
+      if (events[i].events & REACTOR_WRITE)
+        conn_flush(client->conn);
+      if (events[i].events & (REACTOR_READ | REACTOR_HUP))
+        handle_client_readable(server, client);
     }
 
-    if (poll(fds, 1, 100) > 0) {
-      if (fds[0].revents & POLLIN) {
-        if (server->clients.used_buckets == MAX_CLIENTS) {
-          continue;
-        } else {
-          server->state = ACCEPTING;
-        }
+    server_match_seekers(server);
+    timer_wheel_advance(&server->timers, reactor_now_ms(), server);
+    server_push_lobby(server);
 
-        client_t *client = server_accept(server);
-        printf("\x1b[32;1mClient %d connected successfully\x1b[0m\n",
-               client->client_id);
-        int length = snprintf(NULL, 0, "%d", client->client_id) + 1;
-        char *client_id = calloc(length, sizeof(char));
-        sprintf(client_id, "%d", client->client_id);
-        smart_send(client->socket, client_id, length);
-        free(client_id);
-      } else if (fds[0].revents & POLLERR) {
-        printf("\x1b[31;1mError occurred\x1b[0m\n");
-      }
+    // Everything that was sent during this iteration goes out now, meaning
+    // that a whole screen leaves in (at most) one write per client.
+    conn_batch_flush(&server->batch);
+  }
+}
+
+void server_wake(server_t *server) {
+  char byte = 1;
+  // NOTE: If the pipe is full, the reactor is already going to wake up.
+  if (write(server->wake_pipe[1], &byte, 1) == -1 && errno != EAGAIN)
+    handle_sock_error(errno);
+}
+
+void server_migrate_client(server_t *server, client_t *client,
+                           server_t *target) {
+  server_unsubscribe(server, client);
+  server_unwatch(client);
+  server_unseek(server, client);
+  // NOTE: The timers of a client are only ever in the wheel of its shard.
+  server_stop_timers(server, client);
+  conn_detach(client->conn);
+  slot_map_remove(&server->clients, client->handle);
+
+  pthread_mutex_lock(&target->inbox_lock);
+  push_node(target->inbox, (NodeValue){.pointer = client});
+  pthread_mutex_unlock(&target->inbox_lock);
+  // NOTE: This only changes once the client is in the inbox, so that a
+  // resume token sent after it (see `server_resume_session`) finds the client
+  // already there.
+  pthread_mutex_lock(&server->shared->lock);
+  client->shard = target;
+  pthread_mutex_unlock(&server->shared->lock);
+  server_wake(target);
+}
+
+void handle_client_arrival(server_t *server, client_t *client) {
+  client->handle = slot_map_insert(&server->clients, client);
+  if (server_attach(server, client) == -1) {
+    handle_sock_error(errno);
+    handle_client_disconnect(server, client, client->client_id);
+    return;
+  }
+  server_touch(server, client);
+
+  // A client is only ever handed over to join or watch a game owned by this
+  // shard, or to resume a session that this shard owns.
+  if (client->client_name == NULL) {
+    if (server_resume_session(server, client) != CLIENT_MOVED)
+      handle_client_frames(server, client);
+    return;
+  }
+  if (client->screen_state == SPECTATOR_PAGE) {
+    server_watch_game(server, client);
+    return;
+  }
+  game_t *game = client->game;
+  if (game == NULL) {
+    handle_client_frames(server, client);
+    return;
+  }
+
+  // NOTE: A game from the journal already has both of its players (one of
+  // which the client is coming back as), anything else is being joined.
+  pthread_mutex_lock(&server->shared->lock);
+  game->pending--;
+  BOOL is_valid = game->validConnections;
+  BOOL is_joining = game->players[1] == NULL;
+  if (is_valid && is_joining) {
+    game->players[1] = client;
+  } else if (!is_valid) {
+    // The game was ended while the player was on their way.
+    client->game = NULL;
+    if (game->pending == 0)
+      free(game);
+  }
+  pthread_mutex_unlock(&server->shared->lock);
+
+  if (is_valid && is_joining) {
+    handle_game_start(server, game);
+  } else if (is_valid) {
+    server_take_seat(client);
+  } else {
+    client->last_seen_epoch = 0;
+    render_games_page(server, client);
+  }
+
+  // The client may have sent more while it was being handed over, which has
+  // already been read off the socket (so the reactor won't tell us about it).
+  handle_client_frames(server, client);
+}
+
+void handle_client_readable(server_t *server, client_t *client) {
+  int received = conn_read(client->conn);
+
+  if (received == 0) {
+    handle_client_disconnect(server, client, client->client_id);
+    return;
+  } else if (received < 0) {
+    // Nothing to read just yet (spurious wake-up)
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return;
+    handle_client_disconnect(server, client, client->client_id);
+    return;
+  }
+
+  server_touch(server, client);
+  handle_client_frames(server, client);
+}
+
+void handle_client_frames(server_t *server, client_t *client) {
+  char *buf;
+  int len;
+  while ((len = conn_next_frame(client->conn, &buf)) != CONN_FRAME_INCOMPLETE) {
+    if (len == CONN_FRAME_INVALID) {
+      // We can't recover the stream from here.
+      handle_client_disconnect(server, client, client->client_id);
+      return;
     }
+    // NOTE: The client might have been handed over to another shard, in
+    // which case the rest of its frames are handled over there.
+    if (handle_client_message(server, client, buf, len) == CLIENT_MOVED)
+      return;
   }
 }
 
-void server_start(server_t *server) {
-  printf("\x1b[33;1mAttempting to start server\x1b[0m\n");
+int handle_client_message(server_t *server, client_t *client, char *buf,
+                          int len) {
+  // NOTE: The message is decoded in place, the reader never copies it.
+  wire_reader reader = wire_reader_init(buf, len);
+  int type = wire_peek(&reader);
+  int request = type == INT_SERIALIZE_FLAG ? wire_read_int(&reader) : -1;
+
+  // If the client does not have a name, we can assume that the buffer
+  // contains their name.
+  if (client->client_name == NULL && type == RESUME_FLAG) {
+    return handle_client_resume(server, client, &reader);
+  } else if (client->client_name == NULL) {
+    return handle_client_name_set(server, client, &reader);
+  } else if (request == 1 &&
+             (client->screen_state == HOME_PAGE ||
+              client->screen_state ==
+                  GAME_VIEW_PAGE)) { // Also check for `GAME_VIEW_PAGE`,
+                                     // as the client might be requesting
+                                     // a refresh.
+    // NOTE: Everyone starts from the first page.
+    if (client->screen_state == HOME_PAGE)
+      client->lobby_cursor = 0;
+    render_games_page(server, client);
+  } else if (type == LOBBY_DELTA_FLAG &&
+             client->screen_state == GAME_VIEW_PAGE) {
+    handle_lobby_paging(server, client, &reader);
+  } else if (!strcmp(buf, "b")) {
+    switch (client->screen_state) {
+    case IN_GAME_PAGE:
+      // We need to destroy the game.
+      handle_game_unbind(server, client);
+      client->screen_state = GAME_VIEW_PAGE;
+      client->last_seen_epoch = 0;
+      render_games_page(server, client);
+      break;
+    case SPECTATOR_PAGE:
+      // Only the spectator leaves, the game carries on without them.
+      server_unwatch(client);
+      client->screen_state = GAME_VIEW_PAGE;
+      client->last_seen_epoch = 0;
+      render_games_page(server, client);
+      break;
+    default:
+      server_unseek(server, client);
+      client->screen_state = HOME_PAGE;
+      client->last_seen_epoch = 0;
+      break;
+    }
+  } else if (type == STRING_SERIALIZE_FLAG &&
+             client->screen_state == GAME_VIEW_PAGE) {
+    const char *key = wire_read_string(&reader, NULL);
+    if (key != NULL && !strcmp(key, " "))
+      return handle_game_join(server, client);
+    if (key != NULL && !strcmp(key, "w")) {
+      // NOTE: The game can be picked by its number, which follows the key.
+      int id = wire_peek(&reader) == INT_SERIALIZE_FLAG ? wire_read_int(&reader)
+                                                        : 0;
+      return handle_game_watch(server, client, id > 0 ? id : 0);
+    }
+  } else if (request == 2 && client->screen_state == HOME_PAGE) {
+    handle_game_create(server, client);
+  } else if (client->game != NULL && buf[0] == GAME_SIG_MOVE) {
+    handle_game_play(server, client, buf, len);
+  }
+  return 0;
+}
+
+void server_set_accepting(server_t *server, enum SERVER_STATE state) {
+  if (server->state == state)
+    return;
+  server->state = state;
+
+  // NOTE: The listen socket is level-triggered, so while we are full we have
+  // to stop listening for it. Otherwise we would be woken up constantly by
+  // the connections waiting in the backlog.
+  reactor_mod(server->reactor, server->socket,
+              state == ACCEPTING ? REACTOR_READ : 0, LISTEN_TOKEN);
+}
+
+void *server_thread(void *server) {
   server_serve(server);
+  return NULL;
+}
+
+void server_start(server_t *server) {
+  printf("\x1b[33;1mAttempting to start server %d\x1b[0m\n",
+         server->shard_id);
+  if (pthread_create(&server->thread, NULL, server_thread, server) != 0) {
+    fprintf(stderr, "\x1b[31;1mCould not start the server thread\x1b[0m\n");
+    exit(1);
+  }
+}
+
+int client_send(client_t *client, const void *data, int data_length) {
+  if (client->conn == NULL)
+    return 0;
+  return conn_send(client->conn, data, data_length);
+}
+
+wire_writer client_frame(client_t *client, int max_length) {
+  if (client->conn == NULL)
+    return wire_writer_fixed(NULL, 0);
+  return wire_writer_fixed(conn_frame_begin(client->conn, max_length),
+                           max_length);
+}
+
+int client_frame_end(client_t *client, wire_writer *writer) {
+  if (client->conn == NULL)
+    return 0;
+  // Whatever was written of a failed frame is just left behind unsent
+  if (writer->has_failed)
+    return -1;
+  return conn_frame_end(client->conn, writer->len);
+}
+
+int client_send_constant(client_t *client, wire_constant constant) {
+  return client_send(client, constant.data, constant.len);
+}
+
+int client_send_text(client_t *client, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(NULL, 0, format, args) + 1;
+  va_end(args);
+
+  wire_writer writer = client_frame(client, length);
+  va_start(args, format);
+  wire_write_vtext(&writer, format, args);
+  va_end(args);
+  return client_frame_end(client, &writer);
 }
 
-void smart_broadcast(client_t **clients, size_t amount, char *message,
+void smart_broadcast(client_t **clients, size_t amount, const char *message,
                      size_t len) {
   size_t index = 0;
   client_t *client = NULL;
   while (index < amount) {
     client = *(clients + index);
     if (client != NULL)
-      smart_send(client->socket, message, len);
+      client_send(client, message, len);
     index += 1;
   }
 }
 
 int server_unbind(server_t *server) {
-  NodeValue entry_id;
-
-  // NOTE: This block is almost identical
-  // To the `free_hashmap(&map)` function, with the difference
-  // being that we get the client from the map and then close it.
-  while ((entry_id = pop_node(server->clients.entry_ids)).err != -1) {
-    client_t *client;
-    client = get(server->clients, entry_id.i_value).client;
+  // NOTE: Removing a client moves the last one into its place, so we always
+  // take the last one.
+  while (server->clients.count > 0) {
+    client_t *client = server->clients.values[server->clients.count - 1];
+    // NOTE: This has to happen while the connection is still around, as the
+    // other player is told that the game is over.
+    handle_game_unbind(server, client);
+    server_unsubscribe(server, client);
+    server_unseek(server, client);
+    server_unwatch(client);
+    server_stop_timers(server, client);
+    client->game = NULL;
+    conn_flush(client->conn);
+    conn_detach(client->conn);
     while (recv(client->socket, NULL, 1024, 0) > 0)
       ;
     close(client->socket);
+    conn_free(client->conn);
     free(client->client_name);
-    handle_game_unbind(server, client);
-    client->game = NULL;
     printf("\x1b[32;1mClosed connection from Client %d\x1b[0;0m\n",
            client->client_id);
-    remove_value(&server->clients, entry_id.i_value);
+    slot_map_remove(&server->clients, client->handle);
+    free(client);
   }
 
-  free_hashmap(&server->clients);
-  if (server->games != NULL)
-    free_list(server->games);
-  free(server);
-
-  free(accepted_name_s_string);
-  free(rejected_name_s_string);
-  free(game_destroy_s_string);
-  free(accepted_player_s_string.str);
+  // Anybody that we were holding on to (the ones with a game go with it)
+  while (server->graced.count > 0) {
+    client_t *client = server->graced.values[server->graced.count - 1];
+    slot_map_remove(&server->graced, client->handle);
+    client->handle = SLOT_HANDLE_NONE;
+    timer_cancel(&server->timers, &client->grace_timer);
+    if (client->game != NULL) {
+      handle_game_unbind(server, client);
+    } else {
+      free(client->client_name);
+      free(client);
+    }
+  }
 
-  printf("\x1b[33;1mAttempting to kill server instance now\x1b[0;0m\n");
-  exit(0);
+  // Anybody that was still on their way to us
+  NodeValue arrival;
+  while ((arrival = pop_node(server->inbox)).err != -1) {
+    client_t *client = arrival.pointer;
+    game_t *game = client->game;
+    if (game != NULL && !game->validConnections && --game->pending == 0)
+      free(game); // The game has already ended
+    close(client->socket);
+    conn_free(client->conn);
+    free(client->client_name);
+    free(client);
+  }
+  free_list(server->inbox);
+  pool_free(server->inbox_pool);
+  pthread_mutex_destroy(&server->inbox_lock);
+  close(server->wake_pipe[0]);
+  close(server->wake_pipe[1]);
+
+  free_slot_map(&server->clients);
+  free_slot_map(&server->subscribers);
+  free_slot_map(&server->seekers);
+  free_slot_map(&server->graced);
+  conn_batch_free(&server->batch);
+  free(server->match_seekers);
+  free(server->match_games);
+  free(server->match_profiles);
+  reactor_free(server->reactor);
+  close(server->socket);
+  // NOTE: The shards that are unbound after us must not try to wake us up.
+  server->shared->shards[server->shard_id] = NULL;
+  free(server);
+  return 0;
 }
 
-void handle_client_name_set(client_t *client, char *buf) {
-  char *name = deserialize_string(buf);
-  uint8_t name_length = strlen(name);
+int handle_client_name_set(server_t *server, client_t *client,
+                           wire_reader *reader) {
+  size_t name_length;
+  const char *encoded_name = wire_read_string(reader, &name_length);
+  if (encoded_name == NULL || name_length > MAX_CLIENT_NAME_LENGTH) {
+    client_send_constant(client, wire_constants[WIRE_NAME_REJECTED]);
+    return 0;
+  }
+
+  // NOTE: The name is trimmed on the stack, and only copied out once we know
+  // that we're keeping it (for as long as the client is connected).
+  char name[MAX_CLIENT_NAME_LENGTH + 1];
+  memcpy(name, encoded_name, name_length + 1);
   uint8_t trimmed_length = trim_whitespace(name);
 
-  if (trimmed_length == name_length || name_length > MAX_CLIENT_NAME_LENGTH) {
-    smart_send(client->socket, rejected_name_s_string, 7);
-  } else {
-    client->client_name = name;
-    smart_send(client->socket, accepted_name_s_string, 7);
-    printf("Say hello to %s!\n", client->client_name);
-    client->screen_state = HOME_PAGE;
+  if (trimmed_length == name_length) {
+    client_send_constant(client, wire_constants[WIRE_NAME_REJECTED]);
+    return 0;
   }
+  client->client_name = strdup(name);
+  client_send_constant(client, wire_constants[WIRE_NAME_ACCEPTED]);
+  printf("Say hello to %s!\n", client->client_name);
+  client->screen_state = HOME_PAGE;
+  server_start_session(server, client);
+  return 0;
 }
 
 void handle_game_create(server_t *server, client_t *client) {
@@ -412,107 +850,358 @@ void handle_game_create(server_t *server, client_t *client) {
   game->players[0] = client;
   game->validConnections = TRUE;
   game->isCurrentPlayerTurn = TRUE;
+  game->shard = server;
+  timer_init(&game->lobby_timer, &server_lobby_expired);
+  timer_init(&game->clock, &server_move_expired);
+
+  match_profile profile = server_profile(server, client);
+  pthread_mutex_lock(&server->shared->lock);
+  matchmaker_add(&server->shared->matchmaker, &game->waiting, profile);
+  game->lobby_id = lobby_add(server->shared->lobby, client->client_name);
+  game->id = ++server->shared->next_game_id;
+  pthread_mutex_unlock(&server->shared->lock);
+  server_lobby_changed(server);
+  server_journal(server, JOURNAL_CREATE, game, client->client_name,
+                 strlen(client->client_name));
+  // NOTE: A bot joins before the game would have been closed.
+  int wait = server->shared->bot_delay > 0 ? server->shared->bot_delay
+                                           : server->shared->lobby_timeout;
+  if (wait > 0)
+    timer_arm(&server->timers, &game->lobby_timer, reactor_now_ms() + wait);
+  client->game = game;
+  client->screen_state = IN_GAME_PAGE;
+  server_journal_secret(server, client);
+}
 
-  push_node(server->games, (NodeValue){.pointer = game});
-  server->current_game_hash = hash_games_list(server->games);
+match_profile server_profile(server_t *server, client_t *client) {
+  // NOTE: Asking the kernel for the RTT is a syscall, so it's only done when
+  // it's going to be used.
+  BOOL is_rtt_needed = server->shared->matchmaker.mode == MATCH_RTT;
+  return (match_profile){.rating = client->rating,
+                         .rtt = is_rtt_needed ? conn_rtt(client->conn) : -1};
+}
+
+game_t *server_claim_game(server_t *server, client_t *client,
+                          match_profile profile) {
+  server_shared_t *shared = server->shared;
+  match_entry *entry = matchmaker_match(&shared->matchmaker, profile);
+  if (entry == NULL)
+    return NULL;
+
+  game_t *game = queue_entry(entry, game_t, waiting);
+  lobby_remove(shared->lobby, game->lobby_id, LOBBY_GAME_FILLED);
+  game->handle = slot_map_insert(&shared->running, game);
+
+  game->isFull = TRUE;
+  game->isCurrentPlayerTurn = FALSE;
   client->game = game;
   client->screen_state = IN_GAME_PAGE;
+
+  if (game->shard != server) {
+    // The game belongs to another shard, so the player has to move over to
+    // it. The game is reserved for them until they arrive.
+    game->pending++;
+  } else {
+    game->players[1] = client;
+  }
+  return game;
+}
+
+int server_enter_game(server_t *server, client_t *client, game_t *game) {
+  if (game->shard != server) {
+    server_migrate_client(server, client, game->shard);
+    return CLIENT_MOVED;
+  }
+  handle_game_start(server, game);
+  return 0;
 }
 
 int handle_game_join(server_t *server, client_t *client) {
-  // Dequeue Game (FIFO)
-  NodeValue node = pop_node(server->games);
+  server_shared_t *shared = server->shared;
+
+  if (shared->match_interval > 0) {
+    // They're matched alongside everyone else that is waiting (see
+    // `server_match_seekers`).
+    if (client->seeking == SLOT_HANDLE_NONE) {
+      if (server->seekers.count == 0)
+        server->next_match = reactor_now_ms() + shared->match_interval;
+      client->seeking = slot_map_insert(&server->seekers, client);
+    }
+    return 0;
+  }
+
+  match_profile profile = server_profile(server, client);
+  pthread_mutex_lock(&shared->lock);
+  game_t *game = server_claim_game(server, client, profile);
+  pthread_mutex_unlock(&shared->lock);
 
-  // Register that we need to re-render.
-  server->current_game_hash = 13;
   //  There are no games.
-  if (node.err == -1) {
+  if (game == NULL) {
+    // NOTE: The client waits for an answer, so it's sent the page even if it
+    // already has it.
+    client->last_seen_epoch = 0;
     render_games_page(server, client);
-    return -3; // This will be evaluated and used to continue the loop it was
-               // called in
+    return 0;
   }
 
-  game_t *game = node.pointer;
+  server_lobby_changed(server);
+  return server_enter_game(server, client, game);
+}
 
-  game->isFull = TRUE;
-  game->players[1] = client;
-  game->isCurrentPlayerTurn = FALSE;
-  client->game = game;
+void handle_game_start(server_t *server, game_t *game) {
+  timer_cancel(&server->timers, &game->lobby_timer);
+  server_start_clock(server, game);
+  // NOTE: A game against a bot isn't worth picking up again, so it's ended
+  // as far as the journal is concerned.
+  client_t *guest = game->players[1];
+  if (client_is_bot(guest))
+    server_journal(server, JOURNAL_END, game, NULL, 0);
+  else {
+    server_journal(server, JOURNAL_JOIN, game, guest->client_name,
+                   strlen(guest->client_name));
+    server_journal_secret(server, guest);
+  }
 
   // Acknowledge to the second client that we have started and
   // notify the host of a player joining.
-  smart_broadcast(game->players, 2, accepted_player_s_string.str,
-                  accepted_player_s_string.len + 1);
-
-  smart_broadcast(game->players, 2, clear_screen, strlen(clear_screen) + 1);
-
-  unsigned int player_one_len = strlen(game->players[0]->client_name);
-  unsigned int player_two_len = strlen(game->players[1]->client_name);
-
-  // Doing this means that we can use the same memory and just overwrite it.
-  size_t formatted_length =
-      strlen(playing_header) + MAX(player_one_len, player_two_len) + 1;
-  char *formatted = calloc(formatted_length, sizeof(char));
-
-  if (player_two_len > player_one_len) {
-    // We will send the shorter string first (player 1)
-    snprintf(formatted, formatted_length, playing_header,
-             game->players[0]->client_name);
-    smart_send(game->players[1]->socket, formatted,
-               strlen(playing_header) + player_one_len + 1);
-
-    // Then we send the longer string (it will override the shorter one, meaning
-    // we can use the same memory space)
-    snprintf(formatted, formatted_length, playing_header,
-             game->players[1]->client_name);
-    smart_send(game->players[0]->socket, formatted, formatted_length);
-    free(formatted);
-  } else {
-    snprintf(formatted, formatted_length, playing_header,
-             game->players[1]->client_name);
-    smart_send(game->players[0]->socket, formatted,
-               strlen(playing_header) + player_two_len + 1);
+  wire_constant joined = wire_constants[WIRE_GAME_JOINED];
+  smart_broadcast(game->players, 2, joined.data, joined.len);
 
-    snprintf(formatted, formatted_length, playing_header,
-             game->players[0]->client_name);
-    smart_send(game->players[1]->socket, formatted, formatted_length);
-    free(formatted);
-  }
+  smart_broadcast(game->players, 2, clear_screen_frame.data,
+                  clear_screen_frame.len);
+
+  // Let each of them know who they're playing against
+  client_send_text(game->players[0], playing_header,
+                   game->players[1]->client_name, game->id);
+  client_send_text(game->players[1], playing_header,
+                   game->players[0]->client_name, game->id);
 
   // Instruct the client to print the prefilled board and then reset their
   // position.
-  smart_broadcast(game->players, 2, "\0337", 3); // Save
-  smart_broadcast(game->players, 2, prefilled, strlen(prefilled) + 1);
+  smart_broadcast(game->players, 2, save_cursor_frame.data,
+                  save_cursor_frame.len);
+  smart_broadcast(game->players, 2, prefilled_frame.data, prefilled_frame.len);
 
   // Send the header for the current player turn.
-  smart_send(game->players[0]->socket, current_player_turn,
-             strlen(current_player_turn) + 1);
-  smart_send(game->players[1]->socket, enemy_turn, strlen(enemy_turn) + 1);
+  client_send_constant(game->players[0], current_player_turn_frame);
+  client_send_constant(game->players[1], enemy_turn_frame);
+
+  smart_broadcast(game->players, 2, restore_cursor_frame.data,
+                  restore_cursor_frame.len);
+}
+
+// The running game with `id`, or one that is worth watching if `id` is 0.
+// NOTE: The shared lock must be held.
+static game_t *server_find_game(server_shared_t *shared, uint32_t id) {
+  slot_map *running = &shared->running;
+  for (uint32_t i = running->count; i > 0; --i) {
+    game_t *game = running->values[i - 1];
+    if (id != 0 ? game->id == id : !game->has_bot && game->away_players == 0)
+      return game;
+  }
+  return NULL;
+}
+
+int handle_game_watch(server_t *server, client_t *client, uint32_t game_id) {
+  // NOTE: The game is found again by its handle once the client is on its
+  // shard, as it might have ended by then.
+  pthread_mutex_lock(&server->shared->lock);
+  game_t *game = server_find_game(server->shared, game_id);
+  server_t *owner = game != NULL ? game->shard : NULL;
+  client->spectator = game != NULL ? game->handle : SLOT_HANDLE_NONE;
+  pthread_mutex_unlock(&server->shared->lock);
+
+  if (game == NULL) {
+    client->last_seen_epoch = 0;
+    render_games_page(server, client);
+    return 0;
+  }
 
-  smart_broadcast(game->players, 2, "\0338", 3); // Restore.
+  client->screen_state = SPECTATOR_PAGE;
+  if (owner != server) {
+    server_migrate_client(server, client, owner);
+    return CLIENT_MOVED;
+  }
+  server_watch_game(server, client);
   return 0;
 }
 
+void server_watch_game(server_t *server, client_t *client) {
+  pthread_mutex_lock(&server->shared->lock);
+  game_t *game = slot_map_get(&server->shared->running, client->spectator);
+  pthread_mutex_unlock(&server->shared->lock);
+  client->spectator = SLOT_HANDLE_NONE;
+  if (game == NULL || game->shard != server) {
+    // The game ended while they were on their way
+    client->screen_state = GAME_VIEW_PAGE;
+    client->last_seen_epoch = 0;
+    render_games_page(server, client);
+    return;
+  }
+
+  if (game->spectators.slots == NULL)
+    game->spectators = new_slot_map();
+  client->watching = game;
+  client->spectator = slot_map_insert(&game->spectators, client);
+
+  client_send_constant(client, wire_constants[WIRE_GAME_WATCHED]);
+  client_send_constant(client, clear_screen_frame);
+  // NOTE: The second player might still be on their way over.
+  client_t *guest = game->players[1];
+  client_send_text(client, watching_header, game->players[0]->client_name,
+                   guest != NULL ? guest->client_name : "somebody");
+  client_send_constant(client, save_cursor_frame);
+  client_send_constant(client, prefilled_frame);
+  client_send_constant(client, restore_cursor_frame);
+  server_send_board(client, game);
+}
+
+void server_send_board(client_t *client, game_t *game) {
+  int cells[2][BOARD_CELLS], counts[2] = {0, 0};
+  for (int cell = 1; cell <= BOARD_CELLS; ++cell) {
+    int bit = board_bit(cell);
+    for (int player = 0; player < 2; ++player)
+      if (game->board.pieces[player].words[bit / 64] >> (bit % 64) & 1)
+        cells[player][counts[player]++] = cell;
+  }
+  for (int i = 0; i < counts[0] + counts[1]; ++i) {
+    char move[] = {GAME_SIG_MOVE, 0x02, cells[i % 2][i / 2], BOARD_PLAYING};
+    client_send(client, move, sizeof(move));
+  }
+}
+
+void server_unwatch(client_t *client) {
+  game_t *game = client->watching;
+  if (game == NULL)
+    return;
+  slot_map_remove(&game->spectators, client->spectator);
+  client->watching = NULL;
+  client->spectator = SLOT_HANDLE_NONE;
+}
+
+void server_broadcast_game(game_t *game, const char *data, int len) {
+  int playerCount = game->players[1] != NULL ? 2 : 1;
+  if (game->spectators.count == 0) {
+    smart_broadcast(game->players, playerCount, data, len);
+    return;
+  }
+
+  conn_shared *frame = conn_shared_init(CONN_HEADER_SIZE + len);
+  conn_shared_append(frame, data, len);
+  for (int i = 0; i < playerCount; ++i)
+    if (game->players[i]->conn != NULL)
+      conn_send_shared(game->players[i]->conn, frame);
+  for (uint32_t i = 0; i < game->spectators.count; ++i)
+    conn_send_shared(((client_t *)game->spectators.values[i])->conn, frame);
+  conn_shared_release(frame);
+}
+
+void handle_game_play(server_t *server, client_t *client, const char *buf,
+                      int len) {
+  game_t *game = client->game;
+  // NOTE: The second player might still be on their way over from another
+  // shard, in which case the game hasn't started yet.
+  if (len < 3 || buf[1] != 0x01 || game->players[1] == NULL ||
+      game->players[game->isCurrentPlayerTurn] != client)
+    return;
+
+  int player = game->isCurrentPlayerTurn;
+  int outcome = board_play(&game->board, player, (unsigned char)buf[2]);
+  if (outcome == -1)
+    return;
+  game->isCurrentPlayerTurn ^= 1;
+  if (!client_is_bot(game->players[1]))
+    server_journal(server, JOURNAL_MOVE, game, &buf[2], 1);
+
+  // Both are sent the same move, and each of them know whose it was from
+  // whose turn it was.
+  char move[] = {GAME_SIG_MOVE, 0x02, buf[2], outcome};
+  server_broadcast_game(game, move, sizeof(move));
+  client_t *opponent = game->players[!player];
+  if (outcome == BOARD_PLAYING) {
+    server_start_clock(server, game);
+    if (client_is_bot(opponent)) {
+      char reply[] = {GAME_SIG_MOVE, 0x01, bot_move(&game->board, !player)};
+      handle_game_play(server, opponent, reply, sizeof(reply));
+    }
+    return;
+  }
+
+  // NOTE: Games against a bot don't count towards the rating.
+  if (outcome == BOARD_WON && !client_is_bot(client) &&
+      !client_is_bot(opponent))
+    matchmaker_rate(&client->rating, &opponent->rating);
+  handle_game_unbind(server, client);
+}
+
 void handle_game_unbind(server_t *server, client_t *client) {
   if (client->game != NULL) {
     // We need to shut down the game if they're playing in one
     game_t *game = client->game;
-    game->validConnections = FALSE;
-    int playerCount = game->isFull ? 2 : 1;
-    // Broadcast to the players that they must leave
-    smart_broadcast(game->players, playerCount, game_destroy_s_string, 7);
-    remove_node(server->games, (NodeValue){.pointer = game});
+    timer_cancel(&server->timers, &game->lobby_timer);
+    timer_cancel(&server->timers, &game->clock);
+    // NOTE: The games that are cut off by the server going down are kept, so
+    // that they can carry on once it's back up.
+    if (!server_interrupted)
+      server_journal(server, JOURNAL_END, game, NULL, 0);
+    // NOTE: A player might still be on their way over from another shard, in
+    // which case they're not in `players` yet.
+    int playerCount = game->players[1] != NULL ? 2 : 1;
+    // Broadcast to the players (and spectators) that they must leave
+    wire_constant game_exit = wire_constants[WIRE_GAME_EXIT];
+    server_broadcast_game(game, game_exit.data, game_exit.len);
+    for (uint32_t i = 0; i < game->spectators.count; ++i) {
+      client_t *spectator = game->spectators.values[i];
+      spectator->watching = NULL;
+      spectator->spectator = SLOT_HANDLE_NONE;
+      spectator->screen_state = GAME_VIEW_PAGE;
+      spectator->last_seen_epoch = 0;
+    }
+    free_slot_map(&game->spectators);
 
-    server->current_game_hash =
-        1; // Reset the hash to force a rehash of the games
+    pthread_mutex_lock(&server->shared->lock);
+    game->validConnections = FALSE;
+    BOOL was_open = FALSE;
+    if (matchmaker_remove(&server->shared->matchmaker, &game->waiting) == 0)
+      was_open = lobby_remove(server->shared->lobby, game->lobby_id,
+                              LOBBY_GAME_CLOSED) == 0;
+    else
+      slot_map_remove(&server->shared->running, game->handle);
+    // Nobody can come back to the game anymore
+    for (int i = 0; i < playerCount; ++i) {
+      client_t *player = game->players[i];
+      if (client_is_away(player) && player->session == SLOT_HANDLE_NONE &&
+          player->handle != SLOT_HANDLE_NONE)
+        slot_map_remove(&server->shared->away, player->handle);
+    }
+    // The arriving players will clean the game up once they get here.
+    BOOL is_pending = game->pending > 0;
+    pthread_mutex_unlock(&server->shared->lock);
+    if (was_open)
+      server_lobby_changed(server);
 
     // Remove both (or just the host) from the game
+    // NOTE: They'll be asking for the games page, which they must be sent
+    // even if it hasn't changed since they last saw it.
+    client_t *players[2] = {game->players[0], game->players[1]};
     for (int i = 0; i < playerCount; ++i) {
-      game->players[i]->game = NULL;
-      game->players[i]->screen_state = GAME_VIEW_PAGE;
+      players[i]->game = NULL;
+      players[i]->screen_state = GAME_VIEW_PAGE;
+      players[i]->last_seen_epoch = 0;
     }
-    free(client->game);
+    if (!is_pending)
+      free(game);
     client->game = NULL;
+
+    // NOTE: A bot (or an away player) only ever lives in its game, which
+    // might be the client.
+    for (int i = 0; i < playerCount; ++i) {
+      if (players[i]->conn == NULL) {
+        server_end_session(server, players[i]);
+        free(players[i]->client_name);
+        free(players[i]);
+      }
+    }
   }
 }
 
@@ -522,119 +1211,772 @@ void handle_client_disconnect(server_t *server, client_t *client,
   printf("\x1b[31;1mClient %d (%s) has disconnected\x1b[0m\n",
          client->client_id, client->client_name);
 
+  // NOTE: Anyone with a name gets the chance to come back, unless the server
+  // is going down.
+  if (client->session != SLOT_HANDLE_NONE && server->shared->grace_period > 0 &&
+      !server_interrupted) {
+    server_grace(server, client);
+    server_release_id(server, client_id);
+    return;
+  }
+  server_end_session(server, client);
   handle_game_unbind(server, client);
+  server_unsubscribe(server, client);
+  server_unseek(server, client);
+  server_unwatch(client);
+  server_stop_timers(server, client);
 
   // Close the socket
+  conn_detach(client->conn);
   while (recv(client->socket, NULL, 1024, 0) > 0)
     ;
   close(client->socket);
+  conn_free(client->conn);
+  client->conn = NULL;
 
   if (client->client_name != NULL)
     free(client->client_name);
   client->client_name = NULL;
 
+  // Remove the client from the slot map
+  slot_map_remove(&server->clients, client->handle);
   free(client);
   client = NULL;
-  // Remove the client from the hashmap
-  remove_value(&server->clients, client_id);
+  server_release_id(server, client_id);
 }
 
-int render_games_page(server_t *server, client_t *client) {
+void server_release_id(server_t *server, int client_id) {
+  server_shared_t *shared = server->shared;
+  pthread_mutex_lock(&shared->lock);
+  BOOL was_full = id_allocator_is_full(shared->client_ids);
+  id_release(shared->client_ids, client_id);
+  pthread_mutex_unlock(&shared->lock);
+
+  // We have freed up a space, so we (and any other full shard) can start
+  // accepting again.
+  server_set_accepting(server, ACCEPTING);
+  if (was_full) {
+    for (int i = 0; i < shared->shard_count; ++i)
+      if (shared->shards[i] != server)
+        server_wake(shared->shards[i]);
+  }
+}
 
-  if (client->last_sent_game_hash !=
-          0 && // If it is not 0, the user has already had it rendered
-               // at some point
-      client->last_sent_game_hash == server->current_game_hash) {
+int render_games_page(server_t *server, client_t *client) {
+  server_shared_t *shared = server->shared;
+  // NOTE: From here on, the client is pushed anything that changes.
+  server_subscribe(server, client);
+  pthread_mutex_lock(&shared->lock);
+
+  // The client already has the latest page
+  if (client->last_seen_epoch == shared->lobby->epoch) {
+    pthread_mutex_unlock(&shared->lock);
     return -3;
   }
 
-  struct node *head = server->games->head;
-  game_t *game;
+  // NOTE: The first page is the same for everyone, so this is just another
+  // reference to it (it's only put together again after a change).
+  conn_shared *page = lobby_page(shared->lobby, client->lobby_cursor);
+  uint64_t epoch = shared->lobby->epoch;
+  pthread_mutex_unlock(&shared->lock);
 
-  int formatted_length = 0;
-  char *formatted = NULL;
+  conn_send_shared(client->conn, page);
+  conn_shared_release(page);
 
-  unsigned long game_count = 0;
-  LinkedList *games_string = init_list();
-  while (head != NULL) {
-    serialized *s = malloc(sizeof(serialized));
+  client->last_seen_epoch = epoch;
+  client->screen_state = GAME_VIEW_PAGE;
 
-    game = head->data.pointer;
-    if (game == NULL) {
-      NEXT_ITER(head);
-      continue;
-    } else if (!game->validConnections) {
-      // We need to shutdown the game
-
-      // We need to keep track of the next one
-      // as the current will be freed and unavailable to read from.
-      struct node *next_head = head->next;
-      remove_node(server->games, (NodeValue){.pointer = game});
-      server->current_game_hash = hash_games_list(server->games);
-      free(game);
-      game = NULL;
+  return 0;
+}
 
-      head = next_head;
-      continue;
+void handle_lobby_paging(server_t *server, client_t *client,
+                         wire_reader *reader) {
+  int id;
+  int kind = wire_read_delta(reader, &id);
+  if (kind == LOBBY_PAGE_FROM) {
+    client->lobby_cursor = id;
+  } else if (kind == LOBBY_PAGE_BEFORE) {
+    pthread_mutex_lock(&server->shared->lock);
+    client->lobby_cursor = lobby_cursor_before(server->shared->lobby, id);
+    pthread_mutex_unlock(&server->shared->lock);
+  } else {
+    return;
+  }
+  client->last_seen_epoch = 0;
+  render_games_page(server, client);
+}
+
+void server_unseek(server_t *server, client_t *client) {
+  if (client->seeking == SLOT_HANDLE_NONE)
+    return;
+  slot_map_remove(&server->seekers, client->seeking);
+  client->seeking = SLOT_HANDLE_NONE;
+}
+
+void server_add_bot(server_t *server, game_t *game) {
+  // NOTE: A player on another shard might have been matched into the game
+  // since, and is on their way over to it.
+  server_shared_t *shared = server->shared;
+  pthread_mutex_lock(&shared->lock);
+  BOOL is_waiting = matchmaker_remove(&shared->matchmaker, &game->waiting) == 0;
+  if (is_waiting) {
+    lobby_remove(shared->lobby, game->lobby_id, LOBBY_GAME_FILLED);
+    game->handle = slot_map_insert(&shared->running, game);
+    game->has_bot = TRUE;
+  }
+  pthread_mutex_unlock(&shared->lock);
+  if (!is_waiting)
+    return;
+
+  server_lobby_changed(server);
+  game->isFull = TRUE;
+  game->isCurrentPlayerTurn = FALSE;
+  game->players[1] = server_player_init(game, BOT_NAME);
+  game->players[1]->is_bot = TRUE;
+  handle_game_start(server, game);
+}
+
+void server_lobby_expired(wheel_timer *timer, void *server) {
+  game_t *game = timer_entry(timer, game_t, lobby_timer);
+  server_shared_t *shared = ((server_t *)server)->shared;
+  if (shared->bot_delay > 0) {
+    server_add_bot(server, game);
+    return;
+  }
+
+  pthread_mutex_lock(&shared->lock);
+  BOOL is_waiting = !game->isFull;
+  pthread_mutex_unlock(&shared->lock);
+  if (!is_waiting)
+    return;
+  // NOTE: The host is sent back to the games page, as if they had left.
+  printf("\x1b[33;1mNobody joined %s's game\x1b[0m\n",
+         game->players[0]->client_name);
+  handle_game_unbind(server, game->players[0]);
+}
+
+void server_start_clock(server_t *server, game_t *game) {
+  if (server->shared->move_timeout > 0 && game->players[1] != NULL)
+    timer_arm(&server->timers, &game->clock,
+              reactor_now_ms() + server->shared->move_timeout);
+}
+
+void server_move_expired(wheel_timer *timer, void *server) {
+  game_t *game = timer_entry(timer, game_t, clock);
+  client_t *player = game->players[game->isCurrentPlayerTurn];
+  client_t *opponent = game->players[!game->isCurrentPlayerTurn];
+  printf("\x1b[33;1m%s ran out of time against %s\x1b[0m\n",
+         player->client_name, opponent->client_name);
+  // NOTE: It counts the same as the other player having won.
+  if (!client_is_bot(player) && !client_is_bot(opponent))
+    matchmaker_rate(&opponent->rating, &player->rating);
+  handle_game_unbind(server, player);
+}
+
+void server_touch(server_t *server, client_t *client) {
+  if (server->shared->idle_timeout > 0)
+    timer_arm(&server->timers, &client->idle_timer,
+              reactor_now_ms() + server->shared->idle_timeout);
+}
+
+int server_attach(server_t *server, client_t *client) {
+  // NOTE: The shard is passed along rather than read from `client->shard`,
+  // which the shard handing the client over might still be writing to.
+  conn_on_congestion(client->conn, &server_congestion, server);
+  if (conn_attach(client->conn, server->reactor, client->handle,
+                  &server->batch) == -1)
+    return -1;
+  // NOTE: It might have still been backed up when it left its last shard.
+  if (client->conn->congestion != CONN_DRAINED)
+    server_congestion(client->conn, client->conn->congestion, server);
+  return 0;
+}
+
+void server_stop_timers(server_t *server, client_t *client) {
+  timer_cancel(&server->timers, &client->idle_timer);
+  timer_cancel(&server->timers, &client->stall_timer);
+}
+
+void server_congestion(conn_t *conn, int congestion, void *arg) {
+  server_t *server = arg;
+  // NOTE: The connection is attached with the handle of its client.
+  client_t *client = slot_map_get(&server->clients, conn->token);
+  if (client == NULL || client->conn != conn)
+    return;
+  if (congestion == CONN_DRAINED) {
+    timer_cancel(&server->timers, &client->stall_timer);
+    // It was passed over by the lobby pushes while it was backed up
+    if (client->subscription != SLOT_HANDLE_NONE)
+      atomic_store(&server->has_lobby_changed, TRUE);
+  } else if (congestion == CONN_OVERFLOWED) {
+    // NOTE: It can't be disconnected from in here, as it's in the middle of
+    // being sent something, so it goes as soon as the timers are run.
+    timer_arm(&server->timers, &client->stall_timer, 0);
+  } else if (server->shared->stall_timeout > 0 &&
+             !client->stall_timer.is_armed) {
+    timer_arm(&server->timers, &client->stall_timer,
+              reactor_now_ms() + server->shared->stall_timeout);
+  }
+}
+
+void server_stall_expired(wheel_timer *timer, void *server) {
+  client_t *client = timer_entry(timer, client_t, stall_timer);
+  printf("\x1b[31;1mClient %d isn't keeping up with what it's sent\x1b[0m\n",
+         client->client_id);
+  // NOTE: Holding on to them would only have them come back for more of the
+  // same, so they aren't given a grace period.
+  server_end_session(server, client);
+  handle_client_disconnect(server, client, client->client_id);
+}
+
+void server_idle_expired(wheel_timer *timer, void *server) {
+  client_t *client = timer_entry(timer, client_t, idle_timer);
+  if (client->screen_state == IN_GAME_PAGE ||
+      client->screen_state == SPECTATOR_PAGE) {
+    server_touch(server, client);
+    return;
+  }
+  printf("\x1b[31;1mClient %d has been idle for too long\x1b[0m\n",
+         client->client_id);
+  // NOTE: They went quiet rather than dropping, so they aren't held on to.
+  server_end_session(server, client);
+  handle_client_disconnect(server, client, client->client_id);
+}
+
+client_t *server_player_init(game_t *game, const char *name) {
+  client_t *player = calloc(1, sizeof(client_t));
+  player->socket = -1;
+  player->client_id = -1;
+  player->client_name = strdup(name);
+  player->player_type = SPECTATOR;
+  player->screen_state = IN_GAME_PAGE;
+  player->game = game;
+  player->handle = SLOT_HANDLE_NONE;
+  player->subscription = SLOT_HANDLE_NONE;
+  player->seeking = SLOT_HANDLE_NONE;
+  player->spectator = SLOT_HANDLE_NONE;
+  player->rating = MATCHMAKER_DEFAULT_RATING;
+  timer_init(&player->idle_timer, &server_idle_expired);
+  timer_init(&player->grace_timer, &server_grace_expired);
+  timer_init(&player->stall_timer, &server_stall_expired);
+  return player;
+}
+
+void server_journal(server_t *server, int type, game_t *game,
+                    const void *payload, int length) {
+  journal_t *journal = server->shared->journal;
+  if (journal != NULL &&
+      journal_append(journal, type, game->id, payload, length) == -1)
+    fprintf(stderr, "\x1b[31;1mCould not write game %u to the journal\x1b[0m\n",
+            game->id);
+}
+
+void server_journal_secret(server_t *server, client_t *client) {
+  journal_t *journal = server->shared->journal;
+  game_t *game = client->game;
+  if (journal != NULL && game != NULL &&
+      journal_append_secret(journal, game->id, game->players[1] == client,
+                            client->resume_secret) == -1)
+    fprintf(stderr, "\x1b[31;1mCould not write game %u to the journal\x1b[0m\n",
+            game->id);
+}
+
+void server_recover_games(server_shared_t *shared) {
+  char *path = getenv(JOURNAL_ENV);
+  if (path == NULL || path[0] == '\0')
+    return;
+  journal_t *journal = journal_open(path);
+  if (journal == NULL) {
+    fprintf(stderr, "\x1b[31;1mCould not open the journal %s\x1b[0m\n", path);
+    return;
+  }
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  journal_close(journal);
+
+  // NOTE: The journal starts over with just the games that are still being
+  // played, which replaces the old one in one go once it's on the disk.
+  char fresh_path[PATH_MAX];
+  snprintf(fresh_path, sizeof(fresh_path), "%s.new", path);
+  unlink(fresh_path);
+  journal = journal_open(fresh_path);
+  for (int i = 0; journal != NULL && i < count; ++i)
+    journal_append_game(journal, &games[i]);
+  if (journal == NULL || journal_commit(journal) == -1 ||
+      rename(fresh_path, path) == -1) {
+    fprintf(stderr, "\x1b[31;1mCould not start a new journal\x1b[0m\n");
+    if (journal != NULL)
+      journal_close(journal);
+    journal_games_free(games, count);
+    return;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    game_t *game = calloc(1, sizeof(game_t));
+    game->id = games[i].id;
+    game->board = games[i].board;
+    game->isCurrentPlayerTurn = games[i].turn;
+    game->validConnections = TRUE;
+    game->isFull = TRUE;
+    timer_init(&game->lobby_timer, &server_lobby_expired);
+    timer_init(&game->clock, &server_move_expired);
+    // NOTE: Nobody is on any of the shards yet, so they're just shared out.
+    game->shard = shared->shards[i % shared->shard_count];
+    game->handle = slot_map_insert(&shared->running, game);
+    game->away_players = 2;
+    for (int player = 0; player < 2; ++player) {
+      client_t *away = server_player_init(game, games[i].names[player]);
+      away->resume_secret = games[i].secrets[player];
+      away->handle = slot_map_insert(&shared->away, away);
+      game->players[player] = away;
     }
-    if (game->isFull) {
-      NEXT_ITER(head);
-      continue;
+    if (game->id > shared->next_game_id)
+      shared->next_game_id = game->id;
+  }
+  printf("\x1b[32;1mPicked %d game(s) back up from the journal\x1b[0m\n",
+         count);
+  journal_games_free(games, count);
+
+  shared->journal = journal;
+  journal_start(journal, server_journal_interval());
+}
+
+int server_resume(server_t *server, client_t *client) {
+  server_shared_t *shared = server->shared;
+  game_t *game = NULL;
+  pthread_mutex_lock(&shared->lock);
+  for (uint32_t i = 0; i < shared->away.count; ++i) {
+    client_t *away = shared->away.values[i];
+    // NOTE: A player from before the secrets were journaled can't get back
+    // in, rather than anybody being let in as them.
+    if (away->resume_secret != 0 &&
+        away->resume_secret == client->resume_secret) {
+      // NOTE: The seat is held for the client (see `server_take_seat`), as
+      // they might have to move over to the shard of the game first.
+      slot_map_remove(&shared->away, away->handle);
+      away->handle = SLOT_HANDLE_NONE;
+      game = away->game;
+      client->client_name = strdup(away->client_name);
+      if (game->shard != server)
+        game->pending++;
+      break;
     }
-    formatted_length =
-        snprintf(NULL, 0, game_info_template, game->players[0]->client_name,
-                 game->isFull ? 2 : 1) +
-        1;
-    formatted = calloc(formatted_length, sizeof(char));
-    sprintf(formatted, game_info_template, game->players[0]->client_name,
-            game->isFull ? 2 : 1);
-    s->str = serialize_string(formatted);
-
-    push_node(games_string, (NodeValue){.pointer = &s->str});
-    game_count++;
-    free(formatted);
-    formatted_length = 0;
-
-    NEXT_ITER(head);
-  }
-
-  smart_send(client->socket, clear_screen, strlen(clear_screen) + 1);
-  size_t header_length =
-      snprintf(NULL, 0, view_games, HEADER_VERB, game_count, HEADER_GAME) + 1;
-  char *header = calloc(header_length, sizeof(char));
-  sprintf(header, view_games, HEADER_VERB, game_count, HEADER_GAME);
-  smart_send(client->socket, header, header_length);
-  free(header);
-
-  NodeValue val;
-  while ((val = pop_node(games_string)).err != -1) {
-    serialized_string *str = val.pointer;
-    smart_send(client->socket, str->str,
-               str->len +
-                   2); // + 2 accounts for len param and serialized type param
-    free(str->str);
-    free(str);
-  }
-  free_list(games_string);
-  client->last_sent_game_hash = server->current_game_hash;
-  client->screen_state = GAME_VIEW_PAGE;
+  }
+  pthread_mutex_unlock(&shared->lock);
+  if (game == NULL)
+    return -1;
 
+  printf("Say hello again to %s!\n", client->client_name);
+  client->game = game;
+  client->screen_state = IN_GAME_PAGE;
+  if (game->shard != server) {
+    server_migrate_client(server, client, game->shard);
+    return CLIENT_MOVED;
+  }
+  server_take_seat(client);
   return 0;
 }
 
-unsigned long hash_games_list(LinkedList *games) {
-  unsigned long hash = 0;
-  unsigned int index = 0;
+void server_take_seat(client_t *client) {
+  game_t *game = client->game;
+  int seat = 0;
+  while (seat < 2 && !(client_is_away(game->players[seat]) &&
+                       game->players[seat]->handle == SLOT_HANDLE_NONE &&
+                       game->players[seat]->resume_secret ==
+                           client->resume_secret))
+    seat++;
+  if (seat == 2) {
+    // They have to start over with a name
+    free(client->client_name);
+    client->client_name = NULL;
+    client->game = NULL;
+    client->screen_state = SETUP_PAGE;
+    client_send_constant(client, wire_constants[WIRE_RESUME_REJECTED]);
+    return;
+  }
+  client_t *away = game->players[seat];
+  game->players[seat] = client;
+  server_shared_t *shared = ((server_t *)game->shard)->shared;
+  pthread_mutex_lock(&shared->lock);
+  game->away_players--;
+  pthread_mutex_unlock(&shared->lock);
+  free(away->client_name);
+  free(away);
+  // NOTE: The clock of a game from the journal only starts once somebody is
+  // back to play it.
+  if (!game->clock.is_armed)
+    server_start_clock(game->shard, game);
+  // NOTE: The secret that got them in is no good anymore, so the journal
+  // only lets the new one back in.
+  client_send_constant(client, wire_constants[WIRE_RESUMED]);
+  server_start_session(game->shard, client);
+  server_journal_secret(game->shard, client);
+  server_send_seat(client);
+}
 
-  struct node *curr = games->head;
+void server_send_seat(client_t *client) {
+  game_t *game = client->game;
+  int seat = game->players[1] == client;
+  char resumed[] = {GAME_SIG_MOVE, 0x03, seat};
+  client_send(client, resumed, sizeof(resumed));
+  client_send_constant(client, clear_screen_frame);
+  // NOTE: Nobody has joined the host yet (or they're still on their way).
+  if (game->players[1] == NULL) {
+    client_send_text(client, "%s", waiting_room);
+    return;
+  }
+
+  // The other player might be away, in which case the client waits for them
+  // if it's their turn.
+  client_send_text(client, playing_header,
+                   game->players[!seat]->client_name, game->id);
+  client_send_constant(client, save_cursor_frame);
+  client_send_constant(client, prefilled_frame);
+  client_send_constant(client, game->isCurrentPlayerTurn == seat
+                                   ? current_player_turn_frame
+                                   : enemy_turn_frame);
+  client_send_constant(client, restore_cursor_frame);
+  server_send_board(client, game);
+}
 
-  while (curr != NULL) {
-    game_t *game;
-    game = curr->data.pointer;
-    hash = (hash * 31) + index * hash_string(game->players[0]->client_name, 67);
-    hash += game->isFull ? index : 0;
-    index++;
-    NEXT_ITER(curr);
+// A secret that can't be guessed from the ones handed out before it
+uint64_t server_secret() {
+  uint64_t secret;
+  if (getrandom(&secret, sizeof(secret), 0) != sizeof(secret))
+    secret = reactor_now_ms() * 6364136223846793005ull ^ (uintptr_t)&secret;
+  return secret;
+}
+
+// Sends the client the token of its session (see RESUME_FLAG)
+static void server_send_token(client_t *client) {
+  wire_writer writer = client_frame(client, WIRE_RESUME_SIZE);
+  wire_write_resume(&writer, (resume_token){.session = client->session,
+                                            .secret = client->resume_secret});
+  client_frame_end(client, &writer);
+}
+
+void server_start_session(server_t *server, client_t *client) {
+  server_shared_t *shared = server->shared;
+  // NOTE: With a journal, the token also gets a player their game back after
+  // a restart (see `server_resume`).
+  if (shared->grace_period == 0 && shared->journal == NULL)
+    return;
+  pthread_mutex_lock(&shared->lock);
+  client->session = slot_map_insert(&shared->sessions, client);
+  client->resume_secret = server_secret();
+  pthread_mutex_unlock(&shared->lock);
+  server_send_token(client);
+}
+
+void server_end_session(server_t *server, client_t *client) {
+  if (client->session == SLOT_HANDLE_NONE)
+    return;
+  pthread_mutex_lock(&server->shared->lock);
+  slot_map_remove(&server->shared->sessions, client->session);
+  pthread_mutex_unlock(&server->shared->lock);
+  client->session = SLOT_HANDLE_NONE;
+  timer_cancel(&server->timers, &client->grace_timer);
+  // NOTE: A client that is being held on to is always on the shard of its
+  // game, which is us.
+  if (client->conn == NULL &&
+      slot_map_get(&server->graced, client->handle) == client) {
+    slot_map_remove(&server->graced, client->handle);
+    client->handle = SLOT_HANDLE_NONE;
+  }
+}
+
+int handle_client_resume(server_t *server, client_t *client,
+                         wire_reader *reader) {
+  resume_token token;
+  if (wire_read_resume(reader, &token) == -1) {
+    client_send_constant(client, wire_constants[WIRE_RESUME_REJECTED]);
+    return 0;
+  }
+  client->session = token.session;
+  client->resume_secret = token.secret;
+  return server_resume_session(server, client);
+}
+
+int server_resume_session(server_t *server, client_t *client) {
+  server_shared_t *shared = server->shared;
+  pthread_mutex_lock(&shared->lock);
+  client_t *old = slot_map_get(&shared->sessions, client->session);
+  if (old != NULL && old->resume_secret != client->resume_secret)
+    old = NULL;
+  server_t *owner = old != NULL ? old->shard : NULL;
+  // NOTE: The session might be on its way over to us, in which case it's
+  // already in the inbox (ahead of the client).
+  BOOL is_here =
+      owner == server &&
+      (slot_map_get(&server->clients, old->handle) == old ||
+       slot_map_get(&server->graced, old->handle) == old);
+  pthread_mutex_unlock(&shared->lock);
+
+  if (old == NULL) {
+    // It might be for a seat in a game from the journal instead
+    client->session = SLOT_HANDLE_NONE;
+    int status = server_resume(server, client);
+    if (status != -1)
+      return status;
+    // They have to start over with a name
+    client_send_constant(client, wire_constants[WIRE_RESUME_REJECTED]);
+    return 0;
+  }
+  if (!is_here) {
+    server_migrate_client(server, client, owner);
+    return CLIENT_MOVED;
+  }
+  server_rebind(server, old, client);
+  return CLIENT_MOVED;
+}
+
+void server_rebind(server_t *server, client_t *client, client_t *resumer) {
+  server_shared_t *shared = server->shared;
+  conn_detach(resumer->conn);
+  slot_map_remove(&server->clients, resumer->handle);
+  server_stop_timers(server, resumer);
+  server_stop_timers(server, client);
+
+  BOOL was_away = client->conn == NULL;
+  if (client->conn != NULL) {
+    // We hadn't noticed that the old connection had dropped yet
+    conn_detach(client->conn);
+    close(client->socket);
+    conn_free(client->conn);
+    server_release_id(server, client->client_id);
+  } else {
+    printf("\x1b[32;1mClient %s is back\x1b[0m\n", client->client_name);
+    timer_cancel(&server->timers, &client->grace_timer);
+    slot_map_remove(&server->graced, client->handle);
+    client->handle = slot_map_insert(&server->clients, client);
+  }
+  client->conn = resumer->conn;
+  client->socket = resumer->socket;
+  client->addr = resumer->addr;
+  client->client_id = resumer->client_id;
+  free(resumer);
+
+  // NOTE: The token that was just used is no good anymore.
+  pthread_mutex_lock(&shared->lock);
+  client->resume_secret = server_secret();
+  if (was_away && client->game != NULL)
+    ((game_t *)client->game)->away_players--;
+  pthread_mutex_unlock(&shared->lock);
+  server_journal_secret(server, client);
+  if (server_attach(server, client) == -1) {
+    handle_sock_error(errno);
+    handle_client_disconnect(server, client, client->client_id);
+    return;
+  }
+  server_touch(server, client);
+
+  // Anything other than their game starts over from the home page
+  server_unsubscribe(server, client);
+  server_unseek(server, client);
+  server_unwatch(client);
+  client_send_constant(client, wire_constants[WIRE_RESUMED]);
+  server_send_token(client);
+  if (client->game != NULL) {
+    client->screen_state = IN_GAME_PAGE;
+    server_send_seat(client);
+  } else {
+    client->screen_state = HOME_PAGE;
+  }
+  handle_client_frames(server, client);
+}
+
+void server_grace(server_t *server, client_t *client) {
+  printf("\x1b[33;1mHolding on to %s for %dms\x1b[0m\n", client->client_name,
+         server->shared->grace_period);
+  server_unsubscribe(server, client);
+  server_unseek(server, client);
+  server_unwatch(client);
+  // NOTE: Nobody should join a game that its host has left, so only the
+  // games that have started are held on to.
+  game_t *game = client->game;
+  if (game != NULL && !game->isFull)
+    handle_game_unbind(server, client);
+  if (client->game == NULL) {
+    client->screen_state = HOME_PAGE;
+  } else {
+    pthread_mutex_lock(&server->shared->lock);
+    ((game_t *)client->game)->away_players++;
+    pthread_mutex_unlock(&server->shared->lock);
+  }
+
+  server_stop_timers(server, client);
+  conn_detach(client->conn);
+  while (recv(client->socket, NULL, 1024, 0) > 0)
+    ;
+  close(client->socket);
+  conn_free(client->conn);
+  client->conn = NULL;
+  client->socket = -1;
+  client->client_id = -1;
+
+  slot_map_remove(&server->clients, client->handle);
+  client->handle = slot_map_insert(&server->graced, client);
+  timer_arm(&server->timers, &client->grace_timer,
+            reactor_now_ms() + server->shared->grace_period);
+}
+
+void server_grace_expired(wheel_timer *timer, void *server) {
+  client_t *client = timer_entry(timer, client_t, grace_timer);
+  printf("\x1b[31;1mGave up on %s\x1b[0m\n", client->client_name);
+  server_end_session(server, client);
+  // NOTE: A client without a connection lives in its game, and is freed
+  // alongside it.
+  if (client->game != NULL) {
+    handle_game_unbind(server, client);
+  } else {
+    free(client->client_name);
+    free(client);
+  }
+}
+
+int server_match_timeout(server_t *server) {
+  if (server->seekers.count == 0)
+    return -1;
+  uint64_t now = reactor_now_ms();
+  return server->next_match > now ? (int)(server->next_match - now) : 0;
+}
+
+void server_match_seekers(server_t *server) {
+  uint32_t count = server->seekers.count;
+  if (count == 0 || reactor_now_ms() < server->next_match)
+    return;
+
+  if (count > server->match_capacity) {
+    uint32_t capacity = server->match_capacity > 0 ? server->match_capacity : 16;
+    while (capacity < count)
+      capacity *= 2;
+    server->match_seekers =
+        realloc(server->match_seekers, capacity * sizeof(client_t *));
+    server->match_games =
+        realloc(server->match_games, capacity * sizeof(game_t *));
+    server->match_profiles =
+        realloc(server->match_profiles, capacity * sizeof(match_profile));
+    server->match_capacity = capacity;
+  }
+
+  // NOTE: The seekers are taken out first, as a client that is matched into a
+  // game on another shard is moved over to it (and isn't ours anymore).
+  client_t **seekers = server->match_seekers;
+  game_t **games = server->match_games;
+  match_profile *profiles = server->match_profiles;
+  memcpy(seekers, server->seekers.values, count * sizeof(client_t *));
+  for (uint32_t i = 0; i < count; ++i) {
+    server_unseek(server, seekers[i]);
+    profiles[i] = server_profile(server, seekers[i]);
+  }
+
+  server_shared_t *shared = server->shared;
+  BOOL has_matched = FALSE;
+  pthread_mutex_lock(&shared->lock);
+  for (uint32_t i = 0; i < count; ++i) {
+    games[i] = server_claim_game(server, seekers[i], profiles[i]);
+    has_matched |= games[i] != NULL;
+  }
+  pthread_mutex_unlock(&shared->lock);
+  if (has_matched)
+    server_lobby_changed(server);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (games[i] != NULL) {
+      server_enter_game(server, seekers[i], games[i]);
+    } else {
+      seekers[i]->last_seen_epoch = 0;
+      render_games_page(server, seekers[i]);
+    }
+  }
+}
+
+void server_subscribe(server_t *server, client_t *client) {
+  if (client->subscription == SLOT_HANDLE_NONE)
+    client->subscription = slot_map_insert(&server->subscribers, client);
+}
+
+void server_unsubscribe(server_t *server, client_t *client) {
+  if (client->subscription == SLOT_HANDLE_NONE)
+    return;
+  slot_map_remove(&server->subscribers, client->subscription);
+  client->subscription = SLOT_HANDLE_NONE;
+}
+
+void server_lobby_changed(server_t *server) {
+  server_shared_t *shared = server->shared;
+  for (int i = 0; i < shared->shard_count; ++i) {
+    server_t *shard = shared->shards[i];
+    if (shard == NULL)
+      continue;
+    // NOTE: A shard that has already been told is going to push everything
+    // up to the latest change anyway, so it isn't woken up again.
+    if (!atomic_exchange(&shard->has_lobby_changed, TRUE) && shard != server)
+      server_wake(shard);
+  }
+}
+
+int server_lobby_timeout(server_t *server) {
+  if (!atomic_load(&server->has_lobby_changed))
+    return -1;
+  uint64_t now = reactor_now_ms();
+  return server->next_lobby_push > now ? (int)(server->next_lobby_push - now)
+                                       : 0;
+}
+
+void server_push_lobby(server_t *server) {
+  if (!atomic_load(&server->has_lobby_changed))
+    return;
+  uint64_t now = reactor_now_ms();
+  if (now < server->next_lobby_push)
+    return;
+  atomic_store(&server->has_lobby_changed, FALSE);
+  server->next_lobby_push = now + LOBBY_PUSH_INTERVAL;
+
+  // Let go of anyone that has left the page since
+  for (uint32_t i = server->subscribers.count; i > 0; --i) {
+    client_t *client = server->subscribers.values[i - 1];
+    if (client->screen_state != GAME_VIEW_PAGE)
+      server_unsubscribe(server, client);
+  }
+  if (server->subscribers.count == 0)
+    return;
+
+  // NOTE: Almost everyone has the page from the last push, so the changes
+  // since then are only put together once. Anybody else (e.g. those that
+  // subscribed in between) is sent the whole of the page that they're on.
+  server_shared_t *shared = server->shared;
+  pthread_mutex_lock(&shared->lock);
+  uint64_t epoch = shared->lobby->epoch;
+  uint64_t base = epoch;
+  // NOTE: Anybody that is backed up is passed over until they've caught up
+  // (see `server_congestion`).
+  for (uint32_t i = 0; i < server->subscribers.count && base == epoch; ++i) {
+    client_t *client = server->subscribers.values[i];
+    if (client->conn->congestion == CONN_DRAINED)
+      base = client->last_seen_epoch;
+  }
+  if (base == epoch) {
+    // Everyone is already up to date
+    pthread_mutex_unlock(&shared->lock);
+    return;
+  }
+
+  conn_shared *deltas = lobby_deltas(shared->lobby, base);
+  pthread_mutex_unlock(&shared->lock);
+
+  for (uint32_t i = 0; i < server->subscribers.count; ++i) {
+    client_t *client = server->subscribers.values[i];
+    if (client->last_seen_epoch == epoch ||
+        client->conn->congestion != CONN_DRAINED)
+      continue;
+    if (deltas != NULL && client->last_seen_epoch == base) {
+      conn_send_shared(client->conn, deltas);
+      client->last_seen_epoch = epoch;
+    } else {
+      client->last_seen_epoch = 0;
+      render_games_page(server, client);
+    }
   }
-  return hash + 17; // Just to ensure that it is never 0
+  conn_shared_release(deltas);
 }
@@ -0,0 +1,83 @@
+#include "lib/slot_map.h"
+
+#define NO_SLOT UINT32_MAX
+
+#define HANDLE(slot, generation) (((uint64_t)(generation) << 32) | (slot))
+#define HANDLE_SLOT(handle) ((uint32_t)(handle))
+#define HANDLE_GENERATION(handle) ((uint32_t)((handle) >> 32))
+
+slot_map new_slot_map() {
+  slot_map map = {.slots = calloc(SLOT_MAP_INITIAL_SIZE, sizeof(slot_t)),
+                  .slot_count = 0,
+                  .free_slot = NO_SLOT,
+                  .capacity = SLOT_MAP_INITIAL_SIZE,
+                  .values = calloc(SLOT_MAP_INITIAL_SIZE, sizeof(void *)),
+                  .value_slots =
+                      calloc(SLOT_MAP_INITIAL_SIZE, sizeof(uint32_t)),
+                  .count = 0};
+  return map;
+}
+
+void free_slot_map(slot_map *map) {
+  free(map->slots);
+  free(map->values);
+  free(map->value_slots);
+  map->slots = NULL;
+  map->values = NULL;
+  map->value_slots = NULL;
+  map->count = map->slot_count = map->capacity = 0;
+}
+
+slot_handle slot_map_insert(slot_map *map, void *value) {
+  uint32_t slot = map->free_slot;
+  if (slot != NO_SLOT) {
+    map->free_slot = map->slots[slot].index;
+  } else {
+    // There are never more values than slots, so one check covers both.
+    if (map->slot_count == map->capacity) {
+      map->capacity *= 2;
+      map->slots = realloc(map->slots, map->capacity * sizeof(slot_t));
+      map->values = realloc(map->values, map->capacity * sizeof(void *));
+      map->value_slots =
+          realloc(map->value_slots, map->capacity * sizeof(uint32_t));
+    }
+    slot = map->slot_count++;
+    map->slots[slot].generation = 1;
+  }
+
+  map->slots[slot].index = map->count;
+  map->values[map->count] = value;
+  map->value_slots[map->count] = slot;
+  map->count++;
+  return HANDLE(slot, map->slots[slot].generation);
+}
+
+void *slot_map_get(slot_map *map, slot_handle handle) {
+  uint32_t slot = HANDLE_SLOT(handle);
+  if (slot >= map->slot_count ||
+      map->slots[slot].generation != HANDLE_GENERATION(handle))
+    return NULL;
+  return map->values[map->slots[slot].index];
+}
+
+void *slot_map_remove(slot_map *map, slot_handle handle) {
+  void *value = slot_map_get(map, handle);
+  if (value == NULL)
+    return NULL;
+
+  // Move the last value into the gap
+  uint32_t slot = HANDLE_SLOT(handle);
+  uint32_t index = map->slots[slot].index;
+  uint32_t last = --map->count;
+  map->values[index] = map->values[last];
+  map->value_slots[index] = map->value_slots[last];
+  map->slots[map->value_slots[index]].index = index;
+
+  // Invalidate any handles to the slot before it is reused
+  // NOTE: A generation of 0 would make the handle look like SLOT_HANDLE_NONE
+  if (++map->slots[slot].generation == 0)
+    map->slots[slot].generation = 1;
+  map->slots[slot].index = map->free_slot;
+  map->free_slot = slot;
+  return value;
+}
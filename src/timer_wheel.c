@@ -0,0 +1,164 @@
+#include "lib/timer_wheel.h"
+#include <limits.h>
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static void timer_list_init(timer_link *list) {
+  list->prev = list;
+  list->next = list;
+}
+
+static void timer_unlink(timer_link *link) {
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->prev = link;
+  link->next = link;
+}
+
+// Moves everything in `from` over to `to` (which is overwritten)
+static void timer_splice(timer_link *from, timer_link *to) {
+  if (from->next == from) {
+    timer_list_init(to);
+    return;
+  }
+  to->next = from->next;
+  to->prev = from->prev;
+  to->next->prev = to;
+  to->prev->next = to;
+  timer_list_init(from);
+}
+
+// Puts an armed timer into the slot that it's due in, from where the wheel is
+static void timer_place(timer_wheel *wheel, wheel_timer *timer) {
+  uint64_t expires = timer->expires < wheel->tick ? wheel->tick : timer->expires;
+  // NOTE: Too far off to fit, so it goes as late as it can and is put back in
+  // when it comes around (see `timer_wheel_advance`).
+  if ((expires ^ wheel->tick) >= TIMER_WHEEL_SPAN)
+    expires = wheel->tick | (TIMER_WHEEL_SPAN - 1);
+
+  // The lowest level that the timer is due in the current turn of
+  int level = 0;
+  while ((expires ^ wheel->tick) >> (TIMER_WHEEL_BITS * (level + 1)) != 0)
+    level++;
+  timer_link *slot =
+      &wheel->slots[level]
+                   [(expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+
+  timer->link.prev = slot->prev;
+  timer->link.next = slot;
+  slot->prev->next = &timer->link;
+  slot->prev = &timer->link;
+}
+
+void timer_wheel_init(timer_wheel *wheel, uint64_t now_ms) {
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot)
+      timer_list_init(&wheel->slots[level][slot]);
+  wheel->tick = now_ms / TIMER_WHEEL_TICK;
+  wheel->count = 0;
+}
+
+void timer_init(wheel_timer *timer, timer_callback fire) {
+  timer_list_init(&timer->link);
+  timer->expires = 0;
+  timer->is_armed = 0;
+  timer->fire = fire;
+}
+
+void timer_arm(timer_wheel *wheel, wheel_timer *timer, uint64_t deadline_ms) {
+  if (timer->is_armed)
+    timer_unlink(&timer->link);
+  else
+    wheel->count++;
+  timer->is_armed = 1;
+  // Rounded up, so that it never fires early
+  timer->expires = (deadline_ms + TIMER_WHEEL_TICK - 1) / TIMER_WHEEL_TICK;
+  timer_place(wheel, timer);
+}
+
+int timer_cancel(timer_wheel *wheel, wheel_timer *timer) {
+  if (!timer->is_armed)
+    return -1;
+  timer_unlink(&timer->link);
+  timer->is_armed = 0;
+  wheel->count--;
+  return 0;
+}
+
+int timer_wheel_advance(timer_wheel *wheel, uint64_t now_ms, void *context) {
+  uint64_t until = now_ms / TIMER_WHEEL_TICK;
+  int fired = 0;
+  while (wheel->tick <= until) {
+    if (wheel->count == 0) {
+      // Nothing to cascade or fire on the way
+      wheel->tick = until + 1;
+      break;
+    }
+
+    // The levels whose slot starts on this tick are moved down, the highest
+    // first so that anything it moves into the next level down is moved
+    // again straight away if needs be.
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; --level) {
+      int shift = TIMER_WHEEL_BITS * level;
+      if (wheel->tick & (((uint64_t)1 << shift) - 1))
+        continue;
+      timer_link moving;
+      timer_splice(
+          &wheel->slots[level][(wheel->tick >> shift) & TIMER_WHEEL_MASK],
+          &moving);
+      while (moving.next != &moving) {
+        wheel_timer *timer = timer_entry(moving.next, wheel_timer, link);
+        timer_unlink(&timer->link);
+        timer_place(wheel, timer);
+      }
+    }
+
+    timer_link due;
+    timer_splice(&wheel->slots[0][wheel->tick & TIMER_WHEEL_MASK], &due);
+    uint64_t tick = wheel->tick++;
+    while (due.next != &due) {
+      wheel_timer *timer = timer_entry(due.next, wheel_timer, link);
+      timer_unlink(&timer->link);
+      if (timer->expires > tick) {
+        timer_place(wheel, timer); // It was put in early (see TIMER_WHEEL_SPAN)
+        continue;
+      }
+      timer->is_armed = 0;
+      wheel->count--;
+      timer->fire(timer, context);
+      fired++;
+    }
+  }
+  return fired;
+}
+
+int timer_wheel_timeout(const timer_wheel *wheel, uint64_t now_ms) {
+  if (wheel->count == 0)
+    return -1;
+
+  // A level only has timers that are due later on in the turn that it's on
+  // (which is after everything in the levels below it), so the first slot
+  // with anything in it is the soonest.
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+    int shift = TIMER_WHEEL_BITS * level;
+    uint64_t index = wheel->tick >> shift;
+    // NOTE: The current slot of a level above 0 has already been cascaded,
+    // unless the wheel is sitting right at the start of it.
+    if (level > 0 && (wheel->tick & (((uint64_t)1 << shift) - 1)) != 0)
+      index++;
+    for (; index == wheel->tick >> shift || (index & TIMER_WHEEL_MASK) != 0;
+         ++index) {
+      const timer_link *slot = &wheel->slots[level][index & TIMER_WHEEL_MASK];
+      if (slot->next == slot)
+        continue;
+      uint64_t start = index << shift;
+      if (start < wheel->tick)
+        start = wheel->tick;
+      uint64_t at = start * TIMER_WHEEL_TICK;
+      if (at <= now_ms)
+        return 0;
+      return at - now_ms > INT_MAX ? INT_MAX : (int)(at - now_ms);
+    }
+  }
+  return 0; // NOTE: Only if the wheel has lost track of a timer
+}
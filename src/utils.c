@@ -1,4 +1,8 @@
 #include "lib/utils.h"
+#include "lib/pool.h"
+#include "lib/wire.h"
+#include <limits.h>
+#include <sys/uio.h>
 
 #define _malloc malloc
 #ifdef DEBUG
@@ -10,18 +14,36 @@
 #define _malloc(e) __malloc(e, __FILE__, __LINE__);
 #endif
 
-LinkedList *init_list() {
+// Nodes come from the pool of the list if it has one
+static struct node *alloc_node(pool_t *pool) {
+  if (pool != NULL)
+    return pool_alloc(pool);
+  return (struct node *)_malloc(sizeof(struct node));
+}
+
+static void release_node(pool_t *pool, struct node *node) {
+  if (pool != NULL) {
+    pool_release(pool, node);
+  } else {
+    free(node);
+  }
+}
+
+LinkedList *init_list() { return init_pooled_list(NULL); }
+
+LinkedList *init_pooled_list(pool_t *pool) {
   // LinkedList uses a head for the first node and a tail for the next
   // node to be added.
   // Initially, the head and tail are NULL
   // We can say a list is empty if head == NULL
   LinkedList *list = calloc(1, sizeof(LinkedList));
   list->head = list->tail = NULL;
+  list->pool = pool;
   return list;
 }
 
 int push_node(LinkedList *list, NodeValue value) {
-  struct node *new_node = (struct node *)_malloc(sizeof(struct node));
+  struct node *new_node = alloc_node(list->pool);
   new_node->data = value;
   new_node->next = NULL;
 
@@ -39,7 +61,7 @@ int push_node(LinkedList *list, NodeValue value) {
 
 // Push a node at a specific (0-based) index
 int push_node_at(LinkedList *list, NodeValue value, int index) {
-  struct node *new_node = (struct node *)_malloc(sizeof(struct node));
+  struct node *new_node = alloc_node(list->pool);
   new_node->data = value;
   new_node->next = NULL;
 
@@ -81,7 +103,7 @@ NodeValue pop_node(LinkedList *list) {
   struct node *head_copy = list->head;
   NodeValue data = head_copy->data;
   list->head = list->head->next;
-  free(head_copy);
+  release_node(list->pool, head_copy);
   return data;
 }
 
@@ -112,7 +134,7 @@ NodeValue remove_node(LinkedList *list, NodeValue predicate) {
         list->tail = prev;
       }
       ret = head->data;
-      free(head);
+      release_node(list->pool, head);
       head = NULL;
       return ret;
     }
@@ -183,125 +205,195 @@ void free_stack(stck_t *stack) {
   free(stack);
 }
 
-HashMap new_hashmap(int map_size) {
-  HashMap map = {.bucket_count = map_size,
-                 .used_buckets = 0,
-                 .buckets = calloc(map_size, sizeof(Bucket)),
-                 .entry_ids = init_list()};
-  ZERO_HASHMAP(map);
-  return map;
+static uint32_t hash_key(int key) {
+  // NOTE: This is the finaliser of MurmurHash3. Our keys are mostly small,
+  // sequential IDs, which would otherwise all land next to each other.
+  uint32_t hash = (uint32_t)key;
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+  return hash;
 }
 
-void free_hashmap(HashMap *map) {
-  NodeValue entry_id;
-  while ((entry_id = pop_node(map->entry_ids)).err != -1) {
-    remove_value(map, entry_id.i_value);
+static Bucket *table_find(Bucket *buckets, int bucket_count, int key) {
+  if (buckets == NULL)
+    return NULL;
+
+  uint32_t mask = bucket_count - 1;
+  uint32_t index = hash_key(key) & mask;
+  for (uint32_t distance = 1;; ++distance) {
+    Bucket *bucket = &buckets[index];
+    // If the key were here, it would have taken the place of any entry that
+    // is closer to its own bucket (and empty buckets have a distance of 0).
+    if (bucket->distance < distance)
+      return NULL;
+    if (bucket->key == key)
+      return bucket;
+    index = (index + 1) & mask;
   }
+}
 
-  free(map->buckets);
-  free(map->entry_ids);
+// NOTE: The key must not already be in the table, and the table must have at
+// least one empty bucket.
+static void table_insert(Bucket *buckets, int bucket_count, Bucket entry) {
+  uint32_t mask = bucket_count - 1;
+  uint32_t index = hash_key(entry.key) & mask;
+  entry.distance = 1;
+  while (buckets[index].distance != 0) {
+    if (buckets[index].distance < entry.distance) {
+      Bucket displaced = buckets[index];
+      buckets[index] = entry;
+      entry = displaced;
+    }
+    index = (index + 1) & mask;
+    entry.distance++;
+  }
+  buckets[index] = entry;
+}
+
+// Removes the entry by shifting the rest of its cluster back by one, so we
+// never need tombstones.
+static void table_erase(Bucket *buckets, int bucket_count, Bucket *bucket) {
+  uint32_t mask = bucket_count - 1;
+  uint32_t index = bucket - buckets;
+  uint32_t next = (index + 1) & mask;
+  while (buckets[next].distance > 1) {
+    buckets[index] = buckets[next];
+    buckets[index].distance--;
+    index = next;
+    next = (next + 1) & mask;
+  }
+  buckets[index] = (Bucket){
+      .key = NO_VALUE, .distance = 0, .value = (BucketValue){.err = -1}};
 }
 
-void put(HashMap *map, int key, BucketValue value) {
-  int hash = HASH(key, map->bucket_count);
-  Bucket *curr = &map->buckets[hash];
-  if (curr->key == NO_VALUE) {
-    *curr = (Bucket){.key = key, .value = value, .next = NULL};
-    // We want to insert the key into the entry_ids list
-    // but in an ordered fashion
-    // The entry_ids list is a linked list
-    // in ascending order
-    // We need to get the node before the node that is greater than key
-    // and insert the node after that node
-    uint insert_pos = 0;
-    struct node *curr = map->entry_ids->head;
-    while (curr != NULL && curr->data.i_value < key) {
-      curr = curr->next;
-      insert_pos++;
+static void rehash_step(HashMap *map, int amount) {
+  while (map->old_buckets != NULL) {
+    Bucket *bucket = &map->old_buckets[map->rehash_index];
+    if (bucket->distance != 0) {
+      table_insert(map->buckets, map->bucket_count, *bucket);
+      amount--;
+    }
+    // NOTE: Emptying a bucket in the middle of a cluster would hide the
+    // entries after it from `table_find`. We started on an empty bucket and
+    // only ever stop in front of one, so it is always whole clusters that
+    // disappear from the old table.
+    bucket->distance = 0;
+    map->rehash_index = (map->rehash_index + 1) & (map->old_bucket_count - 1);
+
+    if (--map->rehash_left == 0) {
+      free(map->old_buckets);
+      map->old_buckets = NULL;
+      map->old_bucket_count = 0;
+      return;
     }
+    if (amount <= 0 && map->old_buckets[map->rehash_index].distance == 0)
+      return;
+  }
+}
 
-    // We have the position to insert the node
-    push_node_at(map->entry_ids, (NodeValue){.i_value = key}, insert_pos);
+static void grow_hashmap(HashMap *map) {
+  // We can only grow out of one table at a time
+  if (map->old_buckets != NULL)
+    rehash_step(map, INT_MAX);
 
-    map->used_buckets++;
-    return;
+  map->old_buckets = map->buckets;
+  map->old_bucket_count = map->bucket_count;
+  map->bucket_count *= GROWTH_FACTOR;
+  map->buckets = calloc(map->bucket_count, sizeof(Bucket));
+
+  // The table is never full, so there is always an empty bucket to start on.
+  int start = 0;
+  while (map->old_buckets[start].distance != 0)
+    start++;
+  map->rehash_index = start;
+  map->rehash_left = map->old_bucket_count;
+}
+
+HashMap new_hashmap(int map_size) {
+  int bucket_count = INITIAL_MAP_SIZE;
+  while (bucket_count < map_size)
+    bucket_count <<= 1;
+
+  HashMap map = {.bucket_count = bucket_count,
+                 .used_buckets = 0,
+                 .buckets = calloc(bucket_count, sizeof(Bucket)),
+                 .old_buckets = NULL,
+                 .old_bucket_count = 0};
+  return map;
+}
+
+void free_hashmap(HashMap *map) {
+  free(map->buckets);
+  if (map->old_buckets != NULL) {
+    free(map->old_buckets);
   }
+  map->buckets = map->old_buckets = NULL;
+  map->used_buckets = 0;
+}
 
-  // NOTE: If we get here, we have a collision
-  while (curr->next != NULL && curr->key != key)
-    curr = curr->next;
+void put(HashMap *map, int key, BucketValue value) {
+  rehash_step(map, REHASH_STEP);
 
-  if (curr->key == key) {
-    curr->value = value;
-  } else {
-    Bucket *new = malloc(sizeof(Bucket));
-    *new = (Bucket){.key = key, .value = value, .next = NULL};
-    curr->next = new;
-    push_node(map->entry_ids, (NodeValue){.i_value = key});
+  Bucket *bucket = table_find(map->buckets, map->bucket_count, key);
+  if (bucket == NULL)
+    bucket = table_find(map->old_buckets, map->old_bucket_count, key);
+  if (bucket != NULL) {
+    bucket->value = value;
     return;
   }
+
+  if (SHOULD_MAP_EXPAND(map->used_buckets + 1, map->bucket_count))
+    grow_hashmap(map);
+  table_insert(map->buckets, map->bucket_count,
+               (Bucket){.key = key, .value = value});
+  map->used_buckets++;
 }
 
 BucketValue get(HashMap map, int key) {
-  int hash = HASH(key, map.bucket_count);
-  Bucket *curr = &map.buckets[hash];
-  if (curr->key == NO_VALUE)
-    return (BucketValue){.err = -1};
-
-  while (curr != NULL && curr->key != key)
-    curr = curr->next;
+  Bucket *bucket = table_find(map.buckets, map.bucket_count, key);
+  if (bucket == NULL)
+    bucket = table_find(map.old_buckets, map.old_bucket_count, key);
 
-  if (curr == NULL) {
+  if (bucket == NULL)
     return (BucketValue){.err = -1};
-  } else {
-    return curr->value;
-  }
+  return bucket->value;
 }
 
 void remove_value(HashMap *map, int key) {
-  int hash = HASH(key, map->bucket_count);
-  Bucket *curr = &map->buckets[hash];
-  if (curr == NULL)
-    return;
-
-  // If the bucket is empty
-  if (curr->key == NO_VALUE)
-    return;
+  rehash_step(map, REHASH_STEP);
 
-  // If the bucket is the only one in the chain
-  if (curr->next == NULL) {
-    *curr = (Bucket){
-        .key = NO_VALUE, .value = (BucketValue){.err = -1}, .next = NULL};
-    remove_node(map->entry_ids, (NodeValue){.i_value = key});
-    map->used_buckets--;
-    return;
+  Bucket *bucket = table_find(map->buckets, map->bucket_count, key);
+  if (bucket != NULL) {
+    table_erase(map->buckets, map->bucket_count, bucket);
+  } else {
+    bucket = table_find(map->old_buckets, map->old_bucket_count, key);
+    if (bucket == NULL)
+      return;
+    // NOTE: This only shifts entries within the same (not yet moved) cluster,
+    // so the old table stays consistent with `rehash_index`.
+    table_erase(map->old_buckets, map->old_bucket_count, bucket);
   }
 
-  // If the bucket is the first in the chain
-  if (curr->key == key) {
-    Bucket *next = curr->next;
-    *curr = *next;
-    free(next);
-    remove_node(map->entry_ids, (NodeValue){.i_value = key});
-    map->used_buckets--;
-    return;
-  }
+  map->used_buckets--;
+}
 
-  // If the bucket is in the middle of the chain
-  Bucket *prev = curr;
-  curr = curr->next;
-  while (curr != NULL && curr->key != key) {
-    prev = curr;
-    curr = curr->next;
+Bucket *next_bucket(HashMap map, int *cursor) {
+  // NOTE: The entries that have been moved out of the old table were emptied
+  // there, so each entry is only in one of the tables.
+  int total = map.bucket_count + map.old_bucket_count;
+  for (; *cursor < total; ++*cursor) {
+    Bucket *bucket = *cursor < map.bucket_count
+                         ? &map.buckets[*cursor]
+                         : &map.old_buckets[*cursor - map.bucket_count];
+    if (bucket->distance != 0) {
+      ++*cursor;
+      return bucket;
+    }
   }
-
-  if (curr == NULL)
-    return;
-
-  prev->next = curr->next;
-  free(curr);
-  map->used_buckets--;
-  remove_node(map->entry_ids, (NodeValue){.i_value = key});
+  return NULL;
 }
 
 void handle_sock_error(int err) {
@@ -554,76 +646,25 @@ int deserialize_enum(const char *buf) {
 }
 
 char *serialize_client(client_t *client) {
-  unsigned int buf_length =
-      2 + 1; // 2 for the type & len, 1 for the null terminator.
-
-  // Serialize the Socket Field
-  char *client_socket_f = serialize_int(client->socket); // Adds 6 bytes.
-  buf_length += 6;
-
-  // Serialize the Client ID Field
-  char *client_id_f = serialize_int(client->client_id); // Another 6 bytes.
-  buf_length += 6;
-
-  // Serialize the Client Name Field
-  serialized_string client_name_f = serialize_string(client->client_name);
-  // `.len` is the length of the contained string (including null byte.)
-  // We want to ignore the null byte.
-  buf_length +=
-      client_name_f.len + 2; // +2 for the type & len, -1 to remove null byte.
-
-  // Serialize the Addr Fields.
-  // Serialize the Addr Port.
-  char *client_sin_port_f = serialize_int(client->addr.sin_port);
-  buf_length += 6;
-
-  // Serialize the Addr Family.
-  char *client_sin_family_f = serialize_int(client->addr.sin_family);
-  buf_length += 6;
-
-  // Serialize the Addr Address
-  char *client_sin_addr_f = serialize_int(client->addr.sin_addr.s_addr);
-  buf_length += 6;
-
-  char *buf = calloc(buf_length, sizeof(char));
-  buf[0] = CLIENT_SERIALIZE_FLAG;
-  buf[1] =
-      buf_length - 2 - 1; // Get rid of the length field and the null terminator
-  // Move the Socket Field into the Buffer.
-  unsigned int buf_offset = 2;
-  memcpy(buf + buf_offset, client_socket_f, 6);
-  buf_offset += 6;
-
-  // Move the Client ID Field into the Buffer.
-  memcpy(buf + buf_offset, client_id_f, 6);
-  buf_offset += 6;
-
-  // Move the Addr Fields into the Buffer.
-  // Move the Addr Port field into the Buffer.
-  memcpy(buf + buf_offset, client_sin_port_f, 6);
-  buf_offset += 6;
-
-  // Move the Addr Family field into the Buffer.
-  memcpy(buf + buf_offset, client_sin_family_f, 6);
-  buf_offset += 6;
-
-  // Move the Addr Address field into the Buffer.
-  memcpy(buf + buf_offset, client_sin_addr_f, 6);
-  buf_offset += 6;
-
-  // Move the Client Name Field into the Buffer.
-  memcpy(buf + buf_offset, client_name_f.str, client_name_f.len + 2 - 1);
-  buf_offset += client_name_f.len + 2;
-
-  // Free the intermediate values.
-  free(client_socket_f);
-  free(client_id_f);
-  free(client_sin_port_f);
-  free(client_sin_family_f);
-  free(client_sin_addr_f);
-  free(client_name_f.str);
-
-  return buf;
+  // The fields are written one after the other (see utils.h), straight into
+  // the one buffer.
+  wire_writer writer = wire_writer_growable(64);
+  wire_write_raw(&writer, (char[]){CLIENT_SERIALIZE_FLAG, 0}, 2);
+  wire_write_int(&writer, client->socket);
+  wire_write_int(&writer, client->client_id);
+  wire_write_int(&writer, client->addr.sin_port);
+  wire_write_int(&writer, client->addr.sin_family);
+  wire_write_int(&writer, client->addr.sin_addr.s_addr);
+  wire_write_string(&writer, client->client_name);
+  wire_write_raw(&writer, "", 1); // NULL Terminator
+
+  if (writer.has_failed) {
+    free(writer.buf);
+    return NULL;
+  }
+  // Get rid of the type & length fields and the null terminator
+  writer.buf[1] = writer.len - 2 - 1;
+  return writer.buf;
 }
 
 client_t *deserialize_client(const char *buf) {
@@ -701,21 +742,67 @@ BOOL is_valid_input_key(char c) {
 }
 
 int smart_send(int socket, const void *data, int data_length) {
+  // The length and the payload are written with one syscall, so that the
+  // peer never sees the length without the rest of the frame.
   int len = data_length;
-  int ret = send(socket, &len, sizeof(len), 0);
-  if (ret < 0)
-    return ret;
-  return send(socket, data, len, 0);
+  struct iovec iov[2] = {{.iov_base = &len, .iov_len = sizeof(len)},
+                         {.iov_base = (void *)data, .iov_len = len}};
+  int iov_index = 0;
+  size_t remaining = sizeof(len) + len;
+  while (remaining > 0) {
+    ssize_t ret = writev(socket, iov + iov_index, 2 - iov_index);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return ret;
+    }
+    remaining -= ret;
+    // Skip over whatever has been written (short writes)
+    while (iov_index < 2 && (size_t)ret >= iov[iov_index].iov_len) {
+      ret -= iov[iov_index].iov_len;
+      iov_index++;
+    }
+    if (iov_index < 2) {
+      iov[iov_index].iov_base = (char *)iov[iov_index].iov_base + ret;
+      iov[iov_index].iov_len -= ret;
+    }
+  }
+  return data_length;
+}
+
+// Reads exactly `length` bytes, unless the peer disconnects or errors.
+static int recv_exact(int socket, void *buffer, int length) {
+  int received = 0;
+  while (received < length) {
+    int ret = recv(socket, (char *)buffer + received, length - received, 0);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return ret;
+    received += ret;
+  }
+  return received;
 }
 
 int smart_recv(int socket, const void *buffer, int buffer_size) {
   int len;
-  int ret = recv(socket, &len, sizeof(len), 0);
-  if (ret < 0)
+  int ret = recv_exact(socket, &len, sizeof(len));
+  if (ret <= 0) // 0 means that the peer has disconnected
     return ret;
-  if (len > buffer_size)
+  if (len < 0)
+    return -1;
+  if (len > buffer_size) {
+    // Throw the frame away, so that the next one can still be read.
+    char discard[256];
+    while (len > 0) {
+      int chunk = len > (int)sizeof(discard) ? (int)sizeof(discard) : len;
+      if (recv_exact(socket, discard, chunk) <= 0)
+        break;
+      len -= chunk;
+    }
     return -1;
-  return recv(socket, buffer, len, 0);
+  }
+  return recv_exact(socket, (void *)buffer, len);
 }
 
 unsigned int hash_string(const char *buf, unsigned int mod) {
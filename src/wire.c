@@ -0,0 +1,277 @@
+#include "lib/wire.h"
+
+// Returns where the next `len` bytes go, or NULL if they do not fit.
+static char *wire_reserve(wire_writer *writer, size_t len) {
+  if (writer->has_failed)
+    return NULL;
+
+  if (writer->len + len > writer->cap) {
+    if (!writer->is_growable) {
+      writer->has_failed = TRUE;
+      return NULL;
+    }
+    size_t cap = writer->cap > 0 ? writer->cap : 16;
+    while (writer->len + len > cap)
+      cap *= 2;
+    char *buf = realloc(writer->buf, cap);
+    if (buf == NULL) {
+      writer->has_failed = TRUE;
+      return NULL;
+    }
+    writer->buf = buf;
+    writer->cap = cap;
+  }
+
+  char *out = writer->buf + writer->len;
+  writer->len += len;
+  return out;
+}
+
+wire_writer wire_writer_fixed(char *buf, size_t cap) {
+  return (wire_writer){.buf = buf,
+                       .len = 0,
+                       .cap = buf != NULL ? cap : 0,
+                       .is_growable = FALSE,
+                       .has_failed = buf == NULL};
+}
+
+wire_writer wire_writer_growable(size_t cap) {
+  return (wire_writer){.buf = malloc(cap),
+                       .len = 0,
+                       .cap = cap,
+                       .is_growable = TRUE,
+                       .has_failed = FALSE};
+}
+
+void wire_write_int(wire_writer *writer, int i) {
+  char *out = wire_reserve(writer, WIRE_INT_SIZE);
+  if (out == NULL)
+    return;
+  out[0] = INT_SERIALIZE_FLAG;
+  out[1] = 0x04;
+  out[2] = (i >> 24) & 0xFF;
+  out[3] = (i >> 16) & 0xFF;
+  out[4] = (i >> 8) & 0xFF;
+  out[5] = i & 0xFF;
+}
+
+void wire_write_bool(wire_writer *writer, BOOL b) {
+  char *out = wire_reserve(writer, WIRE_BOOL_SIZE);
+  if (out == NULL)
+    return;
+  out[0] = BOOL_SERIALIZE_FLAG;
+  out[1] = 0x01;
+  out[2] = b ? 0x01 : 0x00;
+}
+
+void wire_write_enum(wire_writer *writer, int e) {
+  char *out = wire_reserve(writer, WIRE_ENUM_SIZE);
+  if (out == NULL)
+    return;
+  out[0] = ENUM_SERIALIZE_FLAG;
+  out[1] = 0x01;
+  out[2] = e;
+}
+
+void wire_write_string(wire_writer *writer, const char *str) {
+  size_t len = strlen(str);
+  if (len == 0 || len > WIRE_MAX_STRING) {
+    writer->has_failed = TRUE;
+    return;
+  }
+  char *out = wire_reserve(writer, WIRE_STRING_SIZE(len));
+  if (out == NULL)
+    return;
+  out[0] = STRING_SERIALIZE_FLAG;
+  out[1] = len + 1;
+  memcpy(out + 2, str, len + 1);
+}
+
+void wire_write_stringf(wire_writer *writer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if (len <= 0 || len > WIRE_MAX_STRING) {
+    writer->has_failed = TRUE;
+    return;
+  }
+
+  char *out = wire_reserve(writer, WIRE_STRING_SIZE(len));
+  if (out == NULL)
+    return;
+  out[0] = STRING_SERIALIZE_FLAG;
+  out[1] = len + 1;
+  va_start(args, format);
+  vsnprintf(out + 2, len + 1, format, args);
+  va_end(args);
+}
+
+void wire_write_vtext(wire_writer *writer, const char *format, va_list args) {
+  va_list measure;
+  va_copy(measure, args);
+  int len = vsnprintf(NULL, 0, format, measure);
+  va_end(measure);
+  if (len < 0) {
+    writer->has_failed = TRUE;
+    return;
+  }
+
+  char *out = wire_reserve(writer, len + 1);
+  if (out == NULL)
+    return;
+  vsnprintf(out, len + 1, format, args);
+}
+
+void wire_write_text(wire_writer *writer, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  wire_write_vtext(writer, format, args);
+  va_end(args);
+}
+
+void wire_write_raw(wire_writer *writer, const void *data, size_t len) {
+  char *out = wire_reserve(writer, len);
+  if (out == NULL)
+    return;
+  memcpy(out, data, len);
+}
+
+void wire_write_delta(wire_writer *writer, int kind, int id) {
+  char *out = wire_reserve(writer, WIRE_DELTA_SIZE);
+  if (out == NULL)
+    return;
+  out[0] = LOBBY_DELTA_FLAG;
+  out[1] = kind;
+  out[2] = (id >> 24) & 0xFF;
+  out[3] = (id >> 16) & 0xFF;
+  out[4] = (id >> 8) & 0xFF;
+  out[5] = id & 0xFF;
+}
+
+void wire_write_resume(wire_writer *writer, resume_token token) {
+  char *out = wire_reserve(writer, WIRE_RESUME_SIZE);
+  if (out == NULL)
+    return;
+  out[0] = RESUME_FLAG;
+  for (int i = 0; i < 8; ++i) {
+    out[1 + i] = (token.session >> (56 - 8 * i)) & 0xFF;
+    out[9 + i] = (token.secret >> (56 - 8 * i)) & 0xFF;
+  }
+}
+
+wire_reader wire_reader_init(const char *buf, size_t len) {
+  return (wire_reader){
+      .buf = buf, .len = len, .pos = 0, .has_failed = buf == NULL};
+}
+
+int wire_peek(wire_reader *reader) {
+  if (reader->has_failed || reader->pos >= reader->len)
+    return -1;
+  return (unsigned char)reader->buf[reader->pos];
+}
+
+// Returns the next value of the given type (with `size` bytes), or NULL if
+// it isn't one.
+static const unsigned char *wire_take(wire_reader *reader, int type,
+                                      size_t size) {
+  if (wire_peek(reader) != type || reader->len - reader->pos < size) {
+    reader->has_failed = TRUE;
+    return NULL;
+  }
+  const unsigned char *in = (const unsigned char *)reader->buf + reader->pos;
+  reader->pos += size;
+  return in;
+}
+
+int wire_read_int(wire_reader *reader) {
+  const unsigned char *in =
+      wire_take(reader, INT_SERIALIZE_FLAG, WIRE_INT_SIZE);
+  if (in == NULL)
+    return -1;
+  return (int)((uint32_t)in[2] << 24 | (uint32_t)in[3] << 16 |
+               (uint32_t)in[4] << 8 | (uint32_t)in[5]);
+}
+
+int wire_read_bool(wire_reader *reader) {
+  const unsigned char *in =
+      wire_take(reader, BOOL_SERIALIZE_FLAG, WIRE_BOOL_SIZE);
+  if (in == NULL)
+    return -1;
+  return in[2] == 0x01;
+}
+
+int wire_read_enum(wire_reader *reader) {
+  const unsigned char *in =
+      wire_take(reader, ENUM_SERIALIZE_FLAG, WIRE_ENUM_SIZE);
+  if (in == NULL)
+    return -1;
+  return in[2];
+}
+
+int wire_read_delta(wire_reader *reader, int *id) {
+  const unsigned char *in =
+      wire_take(reader, LOBBY_DELTA_FLAG, WIRE_DELTA_SIZE);
+  if (in == NULL)
+    return -1;
+  if (id != NULL)
+    *id = (int)((uint32_t)in[2] << 24 | (uint32_t)in[3] << 16 |
+                (uint32_t)in[4] << 8 | (uint32_t)in[5]);
+  return in[1];
+}
+
+int wire_read_resume(wire_reader *reader, resume_token *token) {
+  const unsigned char *in = wire_take(reader, RESUME_FLAG, WIRE_RESUME_SIZE);
+  if (in == NULL)
+    return -1;
+  *token = (resume_token){0, 0};
+  for (int i = 0; i < 8; ++i) {
+    token->session = token->session << 8 | in[1 + i];
+    token->secret = token->secret << 8 | in[9 + i];
+  }
+  return 0;
+}
+
+const char *wire_read_string(wire_reader *reader, size_t *len) {
+  if (wire_peek(reader) != STRING_SERIALIZE_FLAG ||
+      reader->len - reader->pos < 2) {
+    reader->has_failed = TRUE;
+    return NULL;
+  }
+
+  // NOTE: The length includes the terminator, which might have been left off
+  // (see `wire_reader_init`).
+  size_t str_len = (unsigned char)reader->buf[reader->pos + 1];
+  const char *str = reader->buf + reader->pos + 2;
+  if (str_len < 1 || reader->len - reader->pos - 2 < str_len - 1 ||
+      str[str_len - 1] != '\0' || memchr(str, '\0', str_len - 1) != NULL) {
+    reader->has_failed = TRUE;
+    return NULL;
+  }
+
+  reader->pos += 2 + str_len;
+  if (reader->pos > reader->len)
+    reader->pos = reader->len;
+  if (len != NULL)
+    *len = str_len - 1;
+  return str;
+}
+
+const wire_constant wire_constants[WIRE_CONSTANT_COUNT] = {
+    [WIRE_VIEW_GAMES] = WIRE_CONSTANT("\x01\x04\x00\x00\x00\x01"),
+    [WIRE_CREATE_GAME] = WIRE_CONSTANT("\x01\x04\x00\x00\x00\x02"),
+    [WIRE_JOIN] = WIRE_CONSTANT("\x03\x02 "),
+    [WIRE_WATCH] = WIRE_CONSTANT("\x03\x02w"),
+    [WIRE_BACK] = WIRE_CONSTANT("b"),
+    [WIRE_NAME_ACCEPTED] = WIRE_CONSTANT("\x01\x04\x00\x00\x00\x01"),
+    [WIRE_NAME_REJECTED] = WIRE_CONSTANT("\x01\x04\xff\xff\xff\xff"),
+    [WIRE_GAME_JOINED] = WIRE_CONSTANT("\x03\x07"
+                                       "joined"),
+    [WIRE_GAME_WATCHED] = WIRE_CONSTANT("\x03\x09"
+                                        "watching"),
+    [WIRE_GAME_EXIT] = WIRE_CONSTANT("\x01\x04\xff\xff\xff\xf6"),
+    [WIRE_RESUMED] = WIRE_CONSTANT("\x03\x08"
+                                   "resumed"),
+    [WIRE_RESUME_REJECTED] = WIRE_CONSTANT("\x03\x08"
+                                           "expired"),
+};
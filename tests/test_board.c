@@ -0,0 +1,176 @@
+#include "../src/lib/board.h"
+#include "generics.h"
+
+TestResult test_lines() {
+  // Every row, column & diagonal
+  int lines[8][3] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}, {1, 4, 7},
+                     {2, 5, 8}, {3, 6, 9}, {1, 5, 9}, {3, 5, 7}};
+  for (int i = 0; i < 8; ++i) {
+    board_t board = {0};
+    EXPECT_EQ(board_play(&board, 1, lines[i][0]), BOARD_PLAYING);
+    EXPECT_EQ(board_play(&board, 1, lines[i][1]), BOARD_PLAYING);
+    EXPECT_EQ(board_play(&board, 1, lines[i][2]), BOARD_WON);
+  }
+
+  // Three in a row that isn't a line
+  board_t board = {0};
+  board_play(&board, 0, 3);
+  board_play(&board, 0, 4);
+  EXPECT_EQ(board_play(&board, 0, 5), BOARD_PLAYING);
+  return SUCCESS;
+}
+
+TestResult test_invalid() {
+  board_t board = {0};
+  EXPECT_EQ(board_play(&board, 0, 0), -1);
+  EXPECT_EQ(board_play(&board, 0, BOARD_CELLS + 1), -1);
+
+  // Taken by either player
+  EXPECT_EQ(board_play(&board, 0, 5), BOARD_PLAYING);
+  EXPECT_EQ(board_play(&board, 0, 5), -1);
+  EXPECT_EQ(board_play(&board, 1, 5), -1);
+  EXPECT(board.pieces[0].words[0] == (uint64_t)1 << board_bit(5));
+  EXPECT(board.pieces[1].words[0] == 0);
+  return SUCCESS;
+}
+
+TestResult test_draw() {
+  // x o x
+  // x o o
+  // o x x
+  board_t board = {0};
+  int moves[] = {1, 2, 3, 5, 4, 6, 8, 7};
+  for (int i = 0; i < 8; ++i)
+    EXPECT_EQ(board_play(&board, i % 2, moves[i]), BOARD_PLAYING);
+  EXPECT_EQ(board_play(&board, 0, 9), BOARD_DRAWN);
+
+  // Winning with the last cell is a win, not a draw
+  // x o x
+  // o o x
+  // o x x
+  board = (board_t){0};
+  int winning[] = {3, 2, 6, 4, 1, 5, 8, 7};
+  for (int i = 0; i < 8; ++i)
+    EXPECT_EQ(board_play(&board, i % 2, winning[i]), BOARD_PLAYING);
+  EXPECT_EQ(board_play(&board, 0, 9), BOARD_WON);
+  return SUCCESS;
+}
+
+// Puts pieces on a bitboard of any size, from (row, col) along (down, across)
+static void place(uint64_t *words, int size, int row, int col, int down,
+                  int across, int count) {
+  for (int i = 0; i < count; ++i) {
+    int bit = (row + i * down) * (size + 1) + col + i * across;
+    words[bit / 64] |= (uint64_t)1 << (bit % 64);
+  }
+}
+
+TestResult test_gomoku() {
+  // Across, down & both diagonals, including some that cross between words
+  int lines[][4] = {{0, 0, 0, 1},  {14, 10, 0, 1}, {3, 7, 1, 0},
+                    {10, 14, 1, 0}, {2, 2, 1, 1},  {10, 4, 1, -1}};
+  for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+    uint64_t words[BOARD_MAX_WORDS] = {0};
+    int *l = lines[i];
+    place(words, 15, l[0], l[1], l[2], l[3], 4);
+    EXPECT(!board_has_line(words, 15, 5));
+    place(words, 15, l[0], l[1], l[2], l[3], 5);
+    EXPECT(board_has_line(words, 15, 5));
+  }
+
+  // A row doesn't carry on into the next
+  uint64_t words[BOARD_MAX_WORDS] = {0};
+  place(words, 15, 0, 12, 0, 1, 3);
+  place(words, 15, 1, 0, 0, 1, 2);
+  EXPECT(!board_has_line(words, 15, 5));
+  // Nor does a diagonal
+  memset(words, 0, sizeof(words));
+  place(words, 15, 0, 2, 1, -1, 3);
+  place(words, 15, 3, 14, 1, -1, 2);
+  EXPECT(!board_has_line(words, 15, 5));
+
+  // Lengths that aren't a power of 2
+  memset(words, 0, sizeof(words));
+  place(words, 7, 1, 1, 1, 1, 6);
+  EXPECT(board_has_line(words, 7, 6));
+  EXPECT(!board_has_line(words, 7, 7));
+  return SUCCESS;
+}
+
+TestResult test_line_through() {
+  // Random games on a few board sizes, where the line found from the last
+  // piece must be the line that a check of the whole board finds.
+  int shapes[][2] = {{15, 5}, {7, 4}, {3, 3}, {9, 2}};
+  srand(17);
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+    int size = shapes[s][0], length = shapes[s][1];
+    for (int game = 0; game < 50; ++game) {
+      uint64_t words[BOARD_MAX_WORDS] = {0};
+      BOOL is_won = FALSE;
+      while (!is_won) {
+        int cell = rand() % (size * size) + 1;
+        int bit = (cell - 1) / size * (size + 1) + (cell - 1) % size;
+        if (words[bit / 64] >> (bit % 64) & 1)
+          continue;
+        words[bit / 64] |= (uint64_t)1 << (bit % 64);
+        is_won = board_has_line_through(words, size, length, cell);
+        EXPECT(is_won == board_has_line(words, size, length));
+      }
+    }
+  }
+
+  // From either end of a line, or the middle
+  uint64_t words[BOARD_MAX_WORDS] = {0};
+  place(words, 15, 4, 4, 1, 1, 5);
+  EXPECT(board_has_line_through(words, 15, 5, 4 * 15 + 5));
+  EXPECT(board_has_line_through(words, 15, 5, 6 * 15 + 7));
+  EXPECT(board_has_line_through(words, 15, 5, 8 * 15 + 9));
+  return SUCCESS;
+}
+
+TestResult test_taken() {
+  board_t board = {0};
+  board_play(&board, 0, 1);
+  board_play(&board, 1, 2);
+  // Moves that aren't allowed don't count
+  board_play(&board, 1, 2);
+  board_play(&board, 1, BOARD_CELLS + 1);
+  EXPECT_EQ(board.taken, 2);
+  return SUCCESS;
+}
+
+TestResult test_draw_text() {
+  // The empty board as it has always looked
+  char *cells[BOARD_CELLS] = {0};
+  char text[BOARD_TEXT_SIZE];
+  const char *expected =
+      " \x1b[30;1m1\x1b[0;0m | \x1b[30;1m2\x1b[0;0m | \x1b[30;1m3\x1b[0;0m\n"
+      "---+---+---\n"
+      " \x1b[30;1m4\x1b[0;0m | \x1b[30;1m5\x1b[0;0m | \x1b[30;1m6\x1b[0;0m\n"
+      "---+---+---\n"
+      " \x1b[30;1m7\x1b[0;0m | \x1b[30;1m8\x1b[0;0m | \x1b[30;1m9\x1b[0;0m\n";
+  EXPECT_EQ(board_draw(text, sizeof(text), cells), (int)strlen(expected));
+  EXPECT_EQ(strcmp(text, expected), 0);
+
+  cells[4] = "x";
+  board_draw(text, sizeof(text), cells);
+  EXPECT(strstr(text, "m4\x1b[0;0m | x | \x1b") != NULL);
+
+  EXPECT_EQ(board_draw(text, 10, cells), -1);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Lines", &test_lines),
+      new_test("Invalid", &test_invalid),
+      new_test("Draw", &test_draw),
+      new_test("Gomoku", &test_gomoku),
+      new_test("Line Through", &test_line_through),
+      new_test("Taken", &test_taken),
+      new_test("Draw Text", &test_draw_text),
+  };
+  Suite my_suite = new_suite("Board Tests", tests, 7);
+  run_suite(my_suite);
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "../src/lib/bot.h"
+#include "generics.h"
+
+// Plays the cells one after the other, starting with player 0
+static board_t played(const int *cells, int count) {
+  board_t board = {0};
+  for (int i = 0; i < count; ++i)
+    board_play(&board, i % 2, cells[i]);
+  return board;
+}
+
+TestResult test_scores() {
+  bot_init();
+  // Nobody can win with perfect play
+  EXPECT_EQ(bot_score(0, 0), 0);
+  // Winning straight away (with 4 cells left), rather than later on
+  EXPECT_EQ(bot_score(0x003, 0x018), 5);
+  // Having already lost, with nothing left to do about it
+  EXPECT_EQ(bot_score(0x018, 0x007), -(4 + 1));
+  // A full board without a line
+  // x o x
+  // x o o
+  // o x x
+  EXPECT_EQ(bot_score(0x072, 0x18D), 0);
+  return SUCCESS;
+}
+
+TestResult test_symmetry() {
+  bot_init();
+  // x in a corner & o next to it, then turned and flipped about, with x to
+  // move
+  // x o .    . . x    . . .    . o x
+  // . . .    . . o    . . .    . . .
+  // . . .    . . .    . o x    . . .
+  int scores[] = {bot_score(0x001, 0x002), bot_score(0x004, 0x020),
+                  bot_score(0x100, 0x080), bot_score(0x004, 0x002)};
+  for (int i = 1; i < 4; ++i)
+    EXPECT_EQ(scores[i], scores[0]);
+  // o going next to the corner loses
+  EXPECT(scores[0] > 0);
+  return SUCCESS;
+}
+
+TestResult test_win_block() {
+  bot_init();
+  // x x .
+  // o o .
+  // . . .
+  int winning[] = {1, 4, 2, 5};
+  board_t board = played(winning, 4);
+  EXPECT_EQ(bot_move(&board, 0), 3);
+
+  // o has to stop x
+  // x x .
+  // . o .
+  // . . .
+  int blocking[] = {1, 5, 2};
+  board = played(blocking, 3);
+  EXPECT_EQ(bot_move(&board, 1), 3);
+
+  // Nothing left
+  int full[] = {1, 2, 3, 5, 4, 6, 8, 7, 9};
+  board = played(full, 9);
+  EXPECT_EQ(bot_move(&board, 1), -1);
+  return SUCCESS;
+}
+
+// Plays a game where `bot` (0 or 1) is the bot, and the other player picks a
+// random free cell. Returns the player that won, or -1 for a draw.
+static int play_random(int bot) {
+  board_t board = {0};
+  for (int turn = 0;; turn ^= 1) {
+    int cell = turn == bot ? bot_move(&board, turn) : rand() % 9 + 1;
+    int outcome = board_play(&board, turn, cell);
+    if (outcome == -1)
+      turn ^= 1; // Try again
+    else if (outcome == BOARD_WON)
+      return turn;
+    else if (outcome == BOARD_DRAWN)
+      return -1;
+  }
+}
+
+TestResult test_never_loses() {
+  bot_init();
+  // Against itself it's always a draw
+  board_t board = {0};
+  int outcome = BOARD_PLAYING;
+  for (int turn = 0; outcome == BOARD_PLAYING; turn ^= 1)
+    outcome = board_play(&board, turn, bot_move(&board, turn));
+  EXPECT_EQ(outcome, BOARD_DRAWN);
+
+  srand(20);
+  for (int game = 0; game < 1000; ++game) {
+    int bot = game % 2;
+    int winner = play_random(bot);
+    EXPECT(winner == -1 || winner == bot);
+  }
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Scores", &test_scores),
+      new_test("Symmetry", &test_symmetry),
+      new_test("Win & Block", &test_win_block),
+      new_test("Never Loses", &test_never_loses),
+  };
+  Suite my_suite = new_suite("Bot Tests", tests, 4);
+  run_suite(my_suite);
+  return 0;
+}
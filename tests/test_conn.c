@@ -0,0 +1,409 @@
+#include "../src/lib/conn.h"
+#include "../src/lib/wire.h"
+#include "generics.h"
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Creates a connected pair of non-blocking sockets.
+void new_socket_pair(int fds[2]) {
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  for (int i = 0; i < 2; ++i)
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL, 0) | O_NONBLOCK);
+}
+
+TestResult test_single_frame() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+
+  EXPECT_EQ(conn_send(writer, "hello", 6), 0);
+  EXPECT_EQ(conn_read(reader), CONN_HEADER_SIZE + 6);
+
+  char *frame;
+  EXPECT_EQ(conn_next_frame(reader, &frame), 6);
+  EXPECT_EQ(strcmp(frame, "hello"), 0);
+  EXPECT_EQ(conn_next_frame(reader, &frame), CONN_FRAME_INCOMPLETE);
+
+  conn_free(writer);
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_split_frame() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *reader = conn_init(fds[1]);
+
+  // Write the length on its own, followed by the payload in two parts.
+  int len = 3;
+  char *frame;
+  send(fds[0], &len, sizeof(len), 0);
+  conn_read(reader);
+  EXPECT_EQ(conn_next_frame(reader, &frame), CONN_FRAME_INCOMPLETE);
+
+  send(fds[0], "a", 1, 0);
+  conn_read(reader);
+  EXPECT_EQ(conn_next_frame(reader, &frame), CONN_FRAME_INCOMPLETE);
+
+  send(fds[0], "b", 2, 0);
+  conn_read(reader);
+  EXPECT_EQ(conn_next_frame(reader, &frame), 3);
+  EXPECT_EQ(strcmp(frame, "ab"), 0);
+
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_many_frames() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+
+  // NOTE: These are not NULL terminated on the wire, the reader does that.
+  conn_send(writer, "one", 3);
+  conn_send(writer, "two", 3);
+  conn_send(writer, "three", 5);
+  conn_read(reader);
+
+  char *frame;
+  EXPECT_EQ(conn_next_frame(reader, &frame), 3);
+  EXPECT_EQ(strcmp(frame, "one"), 0);
+  EXPECT_EQ(conn_next_frame(reader, &frame), 3);
+  EXPECT_EQ(strcmp(frame, "two"), 0);
+  EXPECT_EQ(conn_next_frame(reader, &frame), 5);
+  EXPECT_EQ(strcmp(frame, "three"), 0);
+  EXPECT_EQ(conn_next_frame(reader, &frame), CONN_FRAME_INCOMPLETE);
+
+  conn_free(writer);
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_invalid_frame() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *reader = conn_init(fds[1]);
+
+  int len = CONN_MAX_FRAME + 1;
+  send(fds[0], &len, sizeof(len), 0);
+  conn_read(reader);
+
+  char *frame;
+  EXPECT_EQ(conn_next_frame(reader, &frame), CONN_FRAME_INVALID);
+
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_queued_writes() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+
+  // Keep writing until the socket buffer is full, the rest has to be queued.
+  char payload[CONN_MAX_FRAME] = {0};
+  int sent = 0;
+  while (writer->write_queued == 0) {
+    conn_send(writer, payload, sizeof(payload));
+    sent++;
+  }
+  EXPECT_EQ(conn_flush(writer), 1);
+
+  // Drain the reader, flushing the writer each time until it has caught up.
+  int received = 0;
+  char *frame;
+  while (received < sent) {
+    conn_flush(writer);
+    conn_read(reader);
+    int len;
+    while ((len = conn_next_frame(reader, &frame)) > 0) {
+      EXPECT_EQ(len, CONN_MAX_FRAME);
+      received++;
+    }
+  }
+  EXPECT_EQ(conn_flush(writer), 0);
+  EXPECT_EQ((int)writer->write_queued, 0);
+
+  conn_free(writer);
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_cork() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+
+  conn_cork(writer);
+  conn_send(writer, "one", 4);
+  conn_send(writer, "two", 4);
+  // Nothing has been written yet, and both frames share a chunk.
+  EXPECT_EQ(conn_read(reader), -1);
+  EXPECT(writer->write_head == writer->write_tail);
+  EXPECT_EQ((int)writer->write_queued, 2 * (CONN_HEADER_SIZE + 4));
+
+  EXPECT_EQ(conn_uncork(writer), 0);
+  EXPECT_EQ(conn_read(reader), 2 * (CONN_HEADER_SIZE + 4));
+
+  char *frame;
+  EXPECT_EQ(conn_next_frame(reader, &frame), 4);
+  EXPECT_EQ(strcmp(frame, "one"), 0);
+  EXPECT_EQ(conn_next_frame(reader, &frame), 4);
+  EXPECT_EQ(strcmp(frame, "two"), 0);
+
+  conn_free(writer);
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_batch() {
+  int first[2], second[2];
+  new_socket_pair(first);
+  new_socket_pair(second);
+  conn_batch batch = {0};
+  conn_t *writers[2] = {conn_init(first[0]), conn_init(second[0])};
+  conn_t *readers[2] = {conn_init(first[1]), conn_init(second[1])};
+  for (int i = 0; i < 2; ++i)
+    writers[i]->batch = &batch;
+
+  conn_send(writers[0], "a", 2);
+  conn_send(writers[1], "b", 2);
+  conn_send(writers[0], "c", 2);
+  EXPECT_EQ(conn_read(readers[0]), -1);
+  EXPECT_EQ(conn_read(readers[1]), -1);
+
+  conn_batch_flush(&batch);
+  EXPECT(batch.head == NULL);
+  EXPECT_EQ(conn_read(readers[0]), 2 * (CONN_HEADER_SIZE + 2));
+  EXPECT_EQ(conn_read(readers[1]), CONN_HEADER_SIZE + 2);
+
+  for (int i = 0; i < 2; ++i) {
+    conn_free(writers[i]);
+    conn_free(readers[i]);
+    close(first[i]);
+    close(second[i]);
+  }
+  return SUCCESS;
+}
+
+TestResult test_pooled_chunks() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_batch batch;
+  conn_batch_init(&batch);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+  writer->batch = &batch;
+
+  conn_shared *shared = conn_shared_init(64);
+  conn_shared_append(shared, "b", 2);
+  conn_send(writer, "a", 2);
+  conn_send_shared(writer, shared);
+  conn_send(writer, "c", 2);
+  EXPECT_EQ((int)batch.chunks->in_use, 2);
+  EXPECT_EQ((int)batch.shared_chunks->in_use, 1);
+  conn_batch_flush(&batch);
+  EXPECT_EQ((int)batch.chunks->in_use, 0);
+  EXPECT_EQ((int)batch.shared_chunks->in_use, 0);
+
+  // Whatever is still queued when it's detached is moved out of the pools
+  writer->batch = &batch;
+  conn_send(writer, "d", 2);
+  conn_send_shared(writer, shared);
+  conn_detach(writer);
+  EXPECT_EQ((int)batch.chunks->in_use, 0);
+  EXPECT_EQ((int)batch.shared_chunks->in_use, 0);
+  EXPECT_EQ(conn_flush(writer), 0);
+
+  char *frame;
+  const char *expected[] = {"a", "b", "c", "d", "b"};
+  EXPECT_EQ(conn_read(reader), 5 * (CONN_HEADER_SIZE + 2));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(conn_next_frame(reader, &frame), 2);
+    EXPECT_EQ(strcmp(frame, expected[i]), 0);
+  }
+
+  conn_shared_release(shared);
+  conn_free(writer);
+  conn_free(reader);
+  conn_batch_free(&batch);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_encoded_frame() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+
+  // Encode a frame straight into the write queue, with more room than it
+  // needs.
+  wire_writer wire = wire_writer_fixed(conn_frame_begin(writer, 64), 64);
+  wire_write_int(&wire, 42);
+  EXPECT_EQ(conn_frame_end(writer, wire.len), 0);
+
+  // A frame that is never ended is never sent
+  conn_frame_begin(writer, 64);
+  EXPECT_EQ(conn_flush(writer), 0);
+
+  EXPECT_EQ(conn_read(reader), CONN_HEADER_SIZE + WIRE_INT_SIZE);
+  char *frame;
+  EXPECT_EQ(conn_next_frame(reader, &frame), WIRE_INT_SIZE);
+  EXPECT_EQ(deserialize_int(frame), 42);
+
+  conn_free(writer);
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+TestResult test_shared_frames() {
+  int fds[2][2];
+  conn_t *writers[2], *readers[2];
+  for (int i = 0; i < 2; ++i) {
+    new_socket_pair(fds[i]);
+    writers[i] = conn_init(fds[i][0]);
+    readers[i] = conn_init(fds[i][1]);
+  }
+
+  conn_shared *shared = conn_shared_init(2 * CONN_HEADER_SIZE + 9);
+  EXPECT_EQ(conn_shared_append(shared, "one", 4), 0);
+  EXPECT_EQ(conn_shared_append(shared, "two", 4), 0);
+  // There is only room for one more byte
+  EXPECT_EQ(conn_shared_append(shared, "three", 6), -1);
+
+  // Both of them are sent the same buffer, corked so that it stays queued
+  for (int i = 0; i < 2; ++i) {
+    conn_cork(writers[i]);
+    EXPECT_EQ(conn_send_shared(writers[i], shared), 0);
+    conn_send(writers[i], "after", 6);
+  }
+  EXPECT_EQ(atomic_load(&shared->refs), 3);
+
+  char *frame;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(conn_uncork(writers[i]), 0);
+    conn_read(readers[i]);
+    EXPECT_EQ(conn_next_frame(readers[i], &frame), 4);
+    EXPECT_EQ(strcmp(frame, "one"), 0);
+    EXPECT_EQ(conn_next_frame(readers[i], &frame), 4);
+    EXPECT_EQ(strcmp(frame, "two"), 0);
+    EXPECT_EQ(conn_next_frame(readers[i], &frame), 6);
+    EXPECT_EQ(strcmp(frame, "after"), 0);
+  }
+  // The connections let go of it once it has been written
+  EXPECT_EQ(atomic_load(&shared->refs), 1);
+  conn_shared_release(shared);
+
+  for (int i = 0; i < 2; ++i) {
+    conn_free(writers[i]);
+    conn_free(readers[i]);
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+  return SUCCESS;
+}
+
+// The congestions that the writer has gone through
+static int congestions[4];
+static int congestion_count;
+
+static void on_congestion(conn_t *conn, int congestion, void *arg) {
+  (void)conn;
+  (void)arg;
+  if (congestion_count < 4)
+    congestions[congestion_count] = congestion;
+  congestion_count++;
+}
+
+TestResult test_watermarks() {
+  int fds[2];
+  new_socket_pair(fds);
+  conn_t *writer = conn_init(fds[0]);
+  conn_t *reader = conn_init(fds[1]);
+  congestion_count = 0;
+  conn_on_congestion(writer, &on_congestion, NULL);
+
+  char payload[CONN_MAX_FRAME] = {0};
+  while (writer->write_queued <= CONN_HIGH_WATERMARK) {
+    EXPECT_EQ(writer->congestion, CONN_DRAINED);
+    EXPECT_EQ(conn_send(writer, payload, sizeof(payload)), 0);
+  }
+  EXPECT_EQ(writer->congestion, CONN_CONGESTED);
+  EXPECT_EQ(congestion_count, 1);
+
+  // It stays congested until it has drained down to the low watermark
+  char *frame;
+  while (writer->write_queued > CONN_LOW_WATERMARK) {
+    EXPECT_EQ(writer->congestion, CONN_CONGESTED);
+    conn_read(reader);
+    while (conn_next_frame(reader, &frame) > 0)
+      ;
+    conn_flush(writer);
+  }
+  EXPECT_EQ(writer->congestion, CONN_DRAINED);
+  EXPECT_EQ(congestion_count, 2);
+
+  // Nobody reads it anymore, until it's full
+  int status;
+  while ((status = conn_send(writer, payload, sizeof(payload))) == 0)
+    EXPECT(writer->write_queued <= CONN_MAX_QUEUED);
+  EXPECT_EQ(status, -1);
+  EXPECT_EQ(writer->congestion, CONN_OVERFLOWED);
+  EXPECT_EQ(congestion_count, 4);
+  EXPECT_EQ(congestions[2], CONN_CONGESTED);
+  EXPECT_EQ(congestions[3], CONN_OVERFLOWED);
+  EXPECT_EQ((int)writer->write_queued, 0);
+
+  // Nothing more goes in, not even by reference
+  conn_shared *shared = conn_shared_init(CONN_HEADER_SIZE + 1);
+  conn_shared_append(shared, "", 1);
+  EXPECT_EQ(conn_send_shared(writer, shared), -1);
+  EXPECT(conn_frame_begin(writer, 1) == NULL);
+  conn_shared_release(shared);
+
+  conn_free(writer);
+  conn_free(reader);
+  close(fds[0]);
+  close(fds[1]);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Single Frame", &test_single_frame),
+      new_test("Split Frame", &test_split_frame),
+      new_test("Many Frames", &test_many_frames),
+      new_test("Invalid Frame", &test_invalid_frame),
+      new_test("Queued Writes", &test_queued_writes),
+      new_test("Cork", &test_cork),
+      new_test("Batch", &test_batch),
+      new_test("Pooled Chunks", &test_pooled_chunks),
+      new_test("Encoded Frame", &test_encoded_frame),
+      new_test("Shared Frames", &test_shared_frames),
+      new_test("Watermarks", &test_watermarks),
+  };
+  Suite my_suite = new_suite("Connection Tests", tests, 11);
+  run_suite(my_suite);
+  return 0;
+}
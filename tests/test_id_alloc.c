@@ -0,0 +1,68 @@
+#include "../src/lib/id_alloc.h"
+#include "generics.h"
+
+TestResult test_lowest_first() {
+  id_allocator *ids = id_allocator_init(10);
+  EXPECT_EQ(id_alloc(ids), 1);
+  EXPECT_EQ(id_alloc(ids), 2);
+  EXPECT_EQ(id_alloc(ids), 3);
+
+  // Gaps are filled in before anything new is handed out
+  id_release(ids, 2);
+  EXPECT_EQ(id_alloc(ids), 2);
+  EXPECT_EQ(id_alloc(ids), 4);
+
+  id_allocator_free(ids);
+  return SUCCESS;
+}
+
+TestResult test_full() {
+  id_allocator *ids = id_allocator_init(3);
+  for (int i = 1; i <= 3; ++i)
+    EXPECT_EQ(id_alloc(ids), i);
+  EXPECT(id_allocator_is_full(ids));
+  EXPECT_EQ(id_alloc(ids), -1);
+
+  id_release(ids, 3);
+  EXPECT(!id_allocator_is_full(ids));
+  EXPECT_EQ(id_alloc(ids), 3);
+
+  // Releasing the same ID twice must not free up an extra space
+  id_release(ids, 1);
+  id_release(ids, 1);
+  EXPECT_EQ(ids->used, 2);
+
+  id_allocator_free(ids);
+  return SUCCESS;
+}
+
+TestResult test_across_words() {
+  // Enough IDs that the bitmap needs more than one level
+  id_allocator *ids = id_allocator_init(1000);
+  EXPECT_EQ(ids->level_count, 2);
+  for (int i = 1; i <= 1000; ++i)
+    EXPECT_EQ(id_alloc(ids), i);
+  EXPECT_EQ(id_alloc(ids), -1);
+
+  id_release(ids, 700);
+  id_release(ids, 65);
+  id_release(ids, 999);
+  EXPECT_EQ(id_alloc(ids), 65);
+  EXPECT_EQ(id_alloc(ids), 700);
+  EXPECT_EQ(id_alloc(ids), 999);
+  EXPECT_EQ(id_alloc(ids), -1);
+
+  id_allocator_free(ids);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Lowest First", &test_lowest_first),
+      new_test("Full", &test_full),
+      new_test("Across Words", &test_across_words),
+  };
+  Suite my_suite = new_suite("ID Allocator Tests", tests, 3);
+  run_suite(my_suite);
+  return 0;
+}
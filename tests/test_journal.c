@@ -0,0 +1,211 @@
+#include "../src/lib/journal.h"
+#include "generics.h"
+#include <unistd.h>
+
+// A new (empty) journal file, which the caller unlinks
+static journal_t *open_empty(char *path) {
+  strcpy(path, "/tmp/xo_journal_XXXXXX");
+  close(mkstemp(path));
+  return journal_open(path);
+}
+
+static void move(journal_t *journal, uint32_t game, uint8_t cell) {
+  journal_append(journal, JOURNAL_MOVE, game, &cell, 1);
+}
+
+TestResult test_round_trip() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  EXPECT(journal != NULL);
+  journal_append(journal, JOURNAL_CREATE, 7, "alice", 5);
+  journal_append(journal, JOURNAL_JOIN, 7, "bob", 3);
+  move(journal, 7, 1);
+  move(journal, 7, 5);
+  move(journal, 7, 9);
+  journal_close(journal);
+
+  // Everything is still there once it's opened again
+  journal = journal_open(path);
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ((int)games[0].id, 7);
+  EXPECT_EQ(strcmp(games[0].names[0], "alice"), 0);
+  EXPECT_EQ(strcmp(games[0].names[1], "bob"), 0);
+  EXPECT_EQ(games[0].turn, 1);
+  EXPECT_EQ(games[0].board.taken, 3);
+  EXPECT(games[0].board.pieces[1].words[0] == (uint64_t)1 << board_bit(5));
+  journal_games_free(games, count);
+
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+TestResult test_finished() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  // Never joined
+  journal_append(journal, JOURNAL_CREATE, 1, "alice", 5);
+  // Ended
+  journal_append(journal, JOURNAL_CREATE, 2, "bob", 3);
+  journal_append(journal, JOURNAL_JOIN, 2, "carol", 5);
+  journal_append(journal, JOURNAL_END, 2, NULL, 0);
+  // Won
+  journal_append(journal, JOURNAL_CREATE, 3, "dave", 4);
+  journal_append(journal, JOURNAL_JOIN, 3, "erin", 4);
+  int cells[] = {1, 4, 2, 5, 3};
+  for (int i = 0; i < 5; ++i)
+    move(journal, 3, cells[i]);
+  // Still going, after the others
+  journal_append(journal, JOURNAL_CREATE, 4, "frank", 5);
+  journal_append(journal, JOURNAL_JOIN, 4, "grace", 5);
+  // Moves for games that don't exist are left alone
+  move(journal, 9, 1);
+
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ((int)games[0].id, 4);
+  journal_games_free(games, count);
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+TestResult test_torn_record() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  journal_append(journal, JOURNAL_CREATE, 1, "alice", 5);
+  journal_append(journal, JOURNAL_JOIN, 1, "bob", 3);
+  size_t end = journal->len;
+  move(journal, 1, 5);
+  // The move was only partly written when the server went down
+  journal->map[end + sizeof(journal_header)] = 0;
+  journal_close(journal);
+
+  journal = journal_open(path);
+  EXPECT(journal->len == end);
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ(games[0].board.taken, 0);
+  journal_games_free(games, count);
+
+  // Appending carries on from the last whole record
+  move(journal, 1, 3);
+  games = journal_replay(journal, &count);
+  EXPECT_EQ(games[0].board.taken, 1);
+  EXPECT_EQ(games[0].turn, 1);
+  journal_games_free(games, count);
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+TestResult test_growth() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  size_t size = journal->size;
+  // Games that end straight away, until the file has had to grow
+  uint32_t id = 0;
+  while (journal->size == size) {
+    id++;
+    EXPECT_EQ(journal_append(journal, JOURNAL_CREATE, id, "alice", 5), 0);
+    EXPECT_EQ(journal_append(journal, JOURNAL_JOIN, id, "bob", 3), 0);
+    EXPECT_EQ(journal_append(journal, JOURNAL_END, id, NULL, 0), 0);
+  }
+  journal_append(journal, JOURNAL_CREATE, id + 1, "carol", 5);
+  journal_append(journal, JOURNAL_JOIN, id + 1, "dave", 4);
+  EXPECT_EQ(journal_commit(journal), 0);
+  EXPECT(journal->synced == journal->len);
+
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  EXPECT_EQ(count, 1);
+  EXPECT_EQ(strcmp(games[0].names[0], "carol"), 0);
+  journal_games_free(games, count);
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+TestResult test_append_game() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  // x . o
+  // . x .
+  // o . .  (x to move)
+  journal_game game = {
+      .id = 3, .names = {"alice", "bob"}, .secrets = {0x1234, 0}};
+  int cells[] = {1, 3, 5, 7};
+  for (int i = 0; i < 4; ++i)
+    board_play(&game.board, i % 2, cells[i]);
+  EXPECT_EQ(journal_append_game(journal, &game), 0);
+
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  EXPECT_EQ(count, 1);
+  EXPECT(games[0].board.pieces[0].words[0] == game.board.pieces[0].words[0]);
+  EXPECT(games[0].board.pieces[1].words[0] == game.board.pieces[1].words[0]);
+  EXPECT_EQ(games[0].turn, 0);
+  EXPECT(games[0].secrets[0] == 0x1234 && games[0].secrets[1] == 0);
+  journal_games_free(games, count);
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+TestResult test_secrets() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  journal_append(journal, JOURNAL_CREATE, 1, "alice", 5);
+  journal_append_secret(journal, 1, 0, 0xa11ce);
+  journal_append(journal, JOURNAL_JOIN, 1, "bob", 3);
+  journal_append_secret(journal, 1, 1, 0xb0b);
+  // A player that came back has a new one
+  journal_append_secret(journal, 1, 0, 0xa11ce2);
+  // Anything that isn't a seat is ignored
+  journal_append_secret(journal, 1, 2, 0xbad);
+
+  int count;
+  journal_game *games = journal_replay(journal, &count);
+  EXPECT_EQ(count, 1);
+  EXPECT(games[0].secrets[0] == 0xa11ce2);
+  EXPECT(games[0].secrets[1] == 0xb0b);
+  journal_games_free(games, count);
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+TestResult test_commit_thread() {
+  char path[32];
+  journal_t *journal = open_empty(path);
+  journal_start(journal, 5);
+  journal_append(journal, JOURNAL_CREATE, 1, "alice", 5);
+  // Written out by the thread, without anybody asking
+  for (int i = 0; i < 200 && journal->synced != journal->len; ++i)
+    usleep(5000);
+  pthread_mutex_lock(&journal->lock);
+  EXPECT(journal->synced == journal->len);
+  pthread_mutex_unlock(&journal->lock);
+  journal_close(journal);
+  unlink(path);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Round Trip", &test_round_trip),
+      new_test("Finished Games", &test_finished),
+      new_test("Torn Record", &test_torn_record),
+      new_test("Growth", &test_growth),
+      new_test("Append Game", &test_append_game),
+      new_test("Secrets", &test_secrets),
+      new_test("Commit Thread", &test_commit_thread),
+  };
+  Suite my_suite = new_suite("Journal Tests", tests, 7);
+  run_suite(my_suite);
+  return 0;
+}
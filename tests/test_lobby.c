@@ -0,0 +1,238 @@
+#include "../src/lib/lobby.h"
+#include "generics.h"
+
+typedef struct {
+  int kind;
+  int id;
+  int offset;    // Only for LOBBY_RESET
+  char line[64]; // Only for LOBBY_GAME_OPENED
+} delta;
+
+// Reads the deltas of a page back out, returning how many there were.
+static int read_deltas(conn_shared *page, delta *deltas) {
+  int count = 0;
+  size_t pos = 0;
+  while (pos < page->len) {
+    int len;
+    memcpy(&len, page->data + pos, CONN_HEADER_SIZE);
+    wire_reader reader =
+        wire_reader_init(page->data + pos + CONN_HEADER_SIZE, len);
+    deltas[count].kind = wire_read_delta(&reader, &deltas[count].id);
+    deltas[count].line[0] = '\0';
+    if (deltas[count].kind == LOBBY_RESET)
+      deltas[count].offset = wire_read_int(&reader);
+    if (deltas[count].kind == LOBBY_GAME_OPENED)
+      strcpy(deltas[count].line, wire_read_string(&reader, NULL));
+    pos += CONN_HEADER_SIZE + len;
+    count++;
+  }
+  return count;
+}
+
+TestResult test_empty() {
+  lobby_t *lobby = lobby_init();
+  conn_shared *page = lobby_page(lobby, 0);
+  // Just the reset
+  delta deltas[1];
+  EXPECT_EQ(read_deltas(page, deltas), 1);
+  EXPECT_EQ(deltas[0].kind, LOBBY_RESET);
+  EXPECT_EQ(deltas[0].id, 0);
+  EXPECT_EQ(deltas[0].offset, 0);
+
+  conn_shared_release(page);
+  lobby_free(lobby);
+  return SUCCESS;
+}
+
+TestResult test_add_remove() {
+  lobby_t *lobby = lobby_init();
+  int games[3];
+  games[0] = lobby_add(lobby, "alice");
+  games[1] = lobby_add(lobby, "bob");
+  games[2] = lobby_add(lobby, "carol");
+
+  delta deltas[4];
+  conn_shared *page = lobby_page(lobby, 0);
+  EXPECT_EQ(read_deltas(page, deltas), 4);
+  EXPECT_EQ(deltas[1].kind, LOBBY_GAME_OPENED);
+  EXPECT_EQ(deltas[1].id, 1);
+  EXPECT_EQ(strcmp(deltas[1].line, "alice's game\t[1/2]\n"), 0);
+  EXPECT_EQ(deltas[3].id, 3);
+  EXPECT_EQ(strcmp(deltas[3].line, "carol's game\t[1/2]\n"), 0);
+  conn_shared_release(page);
+
+  EXPECT_EQ(lobby_remove(lobby, games[1], LOBBY_GAME_FILLED), 0);
+  EXPECT_EQ(lobby_remove(lobby, games[1], LOBBY_GAME_FILLED), -1);
+  page = lobby_page(lobby, 0);
+  EXPECT_EQ(read_deltas(page, deltas), 3);
+  EXPECT_EQ(strcmp(deltas[1].line, "alice's game\t[1/2]\n"), 0);
+  EXPECT_EQ(strcmp(deltas[2].line, "carol's game\t[1/2]\n"), 0);
+
+  conn_shared_release(page);
+  lobby_free(lobby);
+  return SUCCESS;
+}
+
+TestResult test_shared_page() {
+  lobby_t *lobby = lobby_init();
+  int game = lobby_add(lobby, "alice");
+
+  // Nothing has changed, so everyone gets the same page
+  conn_shared *first = lobby_page(lobby, 0);
+  conn_shared *second = lobby_page(lobby, 0);
+  EXPECT(first == second);
+  conn_shared_release(second);
+
+  // The old page is left alone for those still holding it
+  lobby_remove(lobby, game, LOBBY_GAME_CLOSED);
+  conn_shared *third = lobby_page(lobby, 0);
+  EXPECT(third != first);
+  delta deltas[2];
+  EXPECT_EQ(read_deltas(first, deltas), 2);
+  EXPECT_EQ(read_deltas(third, deltas), 1);
+
+  conn_shared_release(first);
+  conn_shared_release(third);
+  lobby_free(lobby);
+  return SUCCESS;
+}
+
+TestResult test_epoch() {
+  lobby_t *lobby = lobby_init();
+  uint64_t epoch = lobby->epoch;
+  EXPECT(epoch != 0);
+
+  // Every change moves it on, even one that ends up with the same games
+  int game = lobby_add(lobby, "alice");
+  EXPECT(lobby->epoch > epoch);
+  epoch = lobby->epoch;
+  lobby_remove(lobby, game, LOBBY_GAME_CLOSED);
+  game = lobby_add(lobby, "alice");
+  EXPECT_EQ((int)(lobby->epoch - epoch), 2);
+
+  // Asking for the page (or removing nothing) does not
+  epoch = lobby->epoch;
+  conn_shared_release(lobby_page(lobby, 0));
+  lobby_remove(lobby, 0, LOBBY_GAME_CLOSED);
+  EXPECT(lobby->epoch == epoch);
+
+  lobby_free(lobby);
+  return SUCCESS;
+}
+
+TestResult test_deltas() {
+  lobby_t *lobby = lobby_init();
+  int games[3];
+  games[0] = lobby_add(lobby, "alice");
+  uint64_t epoch = lobby->epoch;
+
+  // Nothing has changed
+  delta deltas[4];
+  conn_shared *changes = lobby_deltas(lobby, epoch);
+  EXPECT(changes != NULL);
+  EXPECT_EQ(read_deltas(changes, deltas), 0);
+  conn_shared_release(changes);
+
+  games[1] = lobby_add(lobby, "bob");
+  games[2] = lobby_add(lobby, "carol");
+  lobby_remove(lobby, games[0], LOBBY_GAME_FILLED);
+  // Opened & filled since `epoch`, so the viewer never needs to know about it
+  lobby_remove(lobby, games[1], LOBBY_GAME_FILLED);
+
+  changes = lobby_deltas(lobby, epoch);
+  EXPECT_EQ(read_deltas(changes, deltas), 2);
+  EXPECT_EQ(deltas[0].kind, LOBBY_GAME_OPENED);
+  EXPECT_EQ(deltas[0].id, 3);
+  EXPECT_EQ(strcmp(deltas[0].line, "carol's game\t[1/2]\n"), 0);
+  EXPECT_EQ(deltas[1].kind, LOBBY_GAME_FILLED);
+  EXPECT_EQ(deltas[1].id, 1);
+  conn_shared_release(changes);
+
+  // An epoch that was never seen, or is too old, needs the whole page
+  EXPECT(lobby_deltas(lobby, 0) == NULL);
+  EXPECT(lobby_deltas(lobby, lobby->epoch + 1) == NULL);
+  for (int i = 0; i < LOBBY_MAX_CHANGES; ++i) {
+    lobby_remove(lobby, games[2], LOBBY_GAME_CLOSED);
+    games[2] = lobby_add(lobby, "carol");
+  }
+  EXPECT(lobby_deltas(lobby, epoch) == NULL);
+
+  lobby_free(lobby);
+  return SUCCESS;
+}
+
+TestResult test_paging() {
+  lobby_t *lobby = lobby_init();
+  int games[LOBBY_PAGE_SIZE * 2 + 5];
+  char name[16];
+  for (int i = 0; i < LOBBY_PAGE_SIZE * 2 + 5; ++i) {
+    snprintf(name, sizeof(name), "player%d", i + 1);
+    games[i] = lobby_add(lobby, name);
+  }
+
+  // The first page, which says how many games there are
+  delta deltas[LOBBY_PAGE_SIZE + 1];
+  conn_shared *page = lobby_page(lobby, 0);
+  EXPECT_EQ(read_deltas(page, deltas), LOBBY_PAGE_SIZE + 1);
+  EXPECT_EQ(deltas[0].id, LOBBY_PAGE_SIZE * 2 + 5);
+  EXPECT_EQ(deltas[0].offset, 0);
+  EXPECT_EQ(deltas[1].id, 1);
+  // Any cursor before the first game is the same page
+  conn_shared *first = lobby_page(lobby, 1);
+  EXPECT(first == page);
+  conn_shared_release(first);
+  conn_shared_release(page);
+
+  // The next page starts after the last game of the first
+  page = lobby_page(lobby, LOBBY_PAGE_SIZE + 1);
+  EXPECT_EQ(read_deltas(page, deltas), LOBBY_PAGE_SIZE + 1);
+  EXPECT_EQ(deltas[0].offset, LOBBY_PAGE_SIZE);
+  EXPECT_EQ(deltas[1].id, LOBBY_PAGE_SIZE + 1);
+  conn_shared_release(page);
+
+  // The last page isn't full
+  page = lobby_page(lobby, LOBBY_PAGE_SIZE * 2 + 1);
+  EXPECT_EQ(read_deltas(page, deltas), 6);
+  EXPECT_EQ(deltas[0].offset, LOBBY_PAGE_SIZE * 2);
+  conn_shared_release(page);
+
+  // Going back from the last page
+  int cursor = lobby_cursor_before(lobby, LOBBY_PAGE_SIZE * 2 + 1);
+  EXPECT_EQ(cursor, LOBBY_PAGE_SIZE + 1);
+  EXPECT_EQ(lobby_cursor_before(lobby, cursor), 0);
+
+  // A game from an earlier page has gone, so the cursor is still the same
+  // game but it's now a game further along.
+  lobby_remove(lobby, games[0], LOBBY_GAME_FILLED);
+  page = lobby_page(lobby, cursor);
+  EXPECT_EQ(read_deltas(page, deltas), LOBBY_PAGE_SIZE + 1);
+  EXPECT_EQ(deltas[0].offset, LOBBY_PAGE_SIZE - 1);
+  EXPECT_EQ(deltas[1].id, cursor);
+  conn_shared_release(page);
+
+  // Everything from the cursor has gone, so it's the last page instead
+  for (int i = LOBBY_PAGE_SIZE * 2; i < LOBBY_PAGE_SIZE * 2 + 5; ++i)
+    lobby_remove(lobby, games[i], LOBBY_GAME_CLOSED);
+  page = lobby_page(lobby, LOBBY_PAGE_SIZE * 2 + 1);
+  EXPECT_EQ(read_deltas(page, deltas), LOBBY_PAGE_SIZE + 1);
+  EXPECT_EQ(deltas[0].offset, LOBBY_PAGE_SIZE * 2 - 1 - LOBBY_PAGE_SIZE);
+  EXPECT_EQ(deltas[LOBBY_PAGE_SIZE].id, LOBBY_PAGE_SIZE * 2);
+  conn_shared_release(page);
+
+  lobby_free(lobby);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Empty", &test_empty),
+      new_test("Add & Remove", &test_add_remove),
+      new_test("Shared Page", &test_shared_page),
+      new_test("Epoch", &test_epoch),
+      new_test("Deltas", &test_deltas),
+      new_test("Paging", &test_paging),
+  };
+  Suite my_suite = new_suite("Lobby Tests", tests, 6);
+  run_suite(my_suite);
+  return 0;
+}
@@ -92,71 +92,125 @@ TestResult test_remove_with_collisions() {
   return SUCCESS;
 }
 
-TestResult test_entry_ids_without_collisions() {
+// The keys (below 64) that walking over the map comes across, which is 0 if
+// any of them comes up twice.
+static uint64_t walk_keys(HashMap map) {
+  uint64_t keys = 0;
+  int cursor = 0;
+  Bucket *bucket;
+  while ((bucket = next_bucket(map, &cursor)) != NULL) {
+    uint64_t bit = (uint64_t)1 << bucket->key;
+    if (keys & bit)
+      return 0;
+    keys |= bit;
+  }
+  return keys;
+}
+
+TestResult test_entries_without_collisions() {
   HashMap map = new_hashmap(5);
   put(&map, 1, (BucketValue){.i_value = 1});
   put(&map, 2, (BucketValue){.i_value = 2});
   put(&map, 3, (BucketValue){.i_value = 3});
   put(&map, 4, (BucketValue){.i_value = 4});
   put(&map, 5, (BucketValue){.i_value = 5});
-
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 1);
-  EXPECT_EQ(map.entry_ids->head->next->data.i_value, 2);
-  EXPECT_EQ(map.entry_ids->head->next->next->data.i_value, 3);
-  EXPECT_EQ(map.entry_ids->head->next->next->next->data.i_value, 4);
-  EXPECT_EQ(map.entry_ids->head->next->next->next->next->data.i_value, 5);
+  EXPECT(walk_keys(map) == 0x3e);
 
   remove_value(&map, 2);
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 1);
-  EXPECT_EQ(map.entry_ids->head->next->data.i_value, 3);
-  EXPECT_EQ(map.entry_ids->head->next->next->data.i_value, 4);
-  EXPECT_EQ(map.entry_ids->head->next->next->next->data.i_value, 5);
+  EXPECT(walk_keys(map) == 0x3a);
 
   remove_value(&map, 5);
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 1);
-  EXPECT_EQ(map.entry_ids->head->next->data.i_value, 3);
-  EXPECT_EQ(map.entry_ids->head->next->next->data.i_value, 4);
+  EXPECT(walk_keys(map) == 0x1a);
 
   remove_value(&map, 1);
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 3);
-  EXPECT_EQ(map.entry_ids->head->next->data.i_value, 4);
-
   remove_value(&map, 4);
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 3);
-
-  free_hashmap(&map);
+  EXPECT(walk_keys(map) == 0x08);
 
-  map = new_hashmap(5);
-  for (int i = 5; i > 0; i--) {
-    put(&map, i, (BucketValue){.i_value = i});
-  }
-
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 1);
-  EXPECT_EQ(map.entry_ids->head->next->data.i_value, 2);
-  EXPECT_EQ(map.entry_ids->head->next->next->data.i_value, 3);
-  EXPECT_EQ(map.entry_ids->head->next->next->next->data.i_value, 4);
-  EXPECT_EQ(map.entry_ids->head->next->next->next->next->data.i_value, 5);
+  remove_value(&map, 3);
+  int cursor = 0;
+  EXPECT(next_bucket(map, &cursor) == NULL);
 
   free_hashmap(&map);
   return SUCCESS;
 }
 
-TestResult test_entry_ids_with_collisions() {
+TestResult test_entries_with_collisions() {
   HashMap map = new_hashmap(5);
   put(&map, 1, (BucketValue){.i_value = 1});
   put(&map, 6, (BucketValue){.i_value = 6});
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 1);
-  EXPECT_EQ(map.entry_ids->tail->data.i_value, 6);
+  EXPECT(walk_keys(map) == 0x42);
 
   remove_value(&map, 6);
-  EXPECT_EQ(map.entry_ids->tail->data.i_value, 1);
-  EXPECT_EQ(map.entry_ids->head->data.i_value, 1);
+  EXPECT(walk_keys(map) == 0x02);
 
   put(&map, 6, (BucketValue){.i_value = 6});
   remove_value(&map, 1);
+  EXPECT(walk_keys(map) == 0x40);
+
+  // The values come along with the keys
+  int cursor = 0;
+  EXPECT_EQ((int)next_bucket(map, &cursor)->value.i_value, 6);
 
-  EXPECT_EQ(map.entry_ids->head->data.i_value,
-            map.entry_ids->tail->data.i_value);
+  free_hashmap(&map);
+  return SUCCESS;
+}
+
+TestResult test_growing() {
+  HashMap map = new_hashmap(2);
+  for (int i = 1; i <= 1000; ++i)
+    put(&map, i, (BucketValue){.i_value = i * 2});
+
+  EXPECT_EQ(map.used_buckets, 1000);
+  EXPECT_EQ(map.bucket_count & (map.bucket_count - 1), 0);
+  EXPECT(map.bucket_count >= 1000);
+  for (int i = 1; i <= 1000; ++i)
+    EXPECT_EQ((int)get(map, i).i_value, i * 2);
+
+  for (int i = 2; i <= 1000; i += 2)
+    remove_value(&map, i);
+  EXPECT_EQ(map.used_buckets, 500);
+  for (int i = 1; i <= 1000; ++i) {
+    if (i % 2 == 0) {
+      EXPECT_EQ(get(map, i).err, -1);
+    } else {
+      EXPECT_EQ((int)get(map, i).i_value, i * 2);
+    }
+  }
+
+  free_hashmap(&map);
+  return SUCCESS;
+}
+
+TestResult test_get_while_growing() {
+  HashMap map = new_hashmap(INITIAL_MAP_SIZE);
+  int key = 0;
+  // Keep adding until some of the entries are still in the old table
+  while (map.old_buckets == NULL) {
+    key++;
+    put(&map, key, (BucketValue){.i_value = key});
+  }
+
+  for (int i = 1; i <= key; ++i)
+    EXPECT_EQ((int)get(map, i).i_value, i);
+  // Every entry is come across once, whichever of the tables it's in
+  if (key < 64) {
+    EXPECT(walk_keys(map) == (((uint64_t)1 << (key + 1)) - 2));
+  }
+
+  // Overwriting and removing has to work on both of the tables
+  for (int i = 1; i <= key; i += 3)
+    put(&map, i, (BucketValue){.i_value = i + 100});
+  for (int i = 2; i <= key; i += 3)
+    remove_value(&map, i);
+  for (int i = 1; i <= key; ++i) {
+    if (i % 3 == 1) {
+      EXPECT_EQ((int)get(map, i).i_value, i + 100);
+    } else if (i % 3 == 2) {
+      EXPECT_EQ(get(map, i).err, -1);
+    } else {
+      EXPECT_EQ((int)get(map, i).i_value, i);
+    }
+  }
 
   free_hashmap(&map);
   return SUCCESS;
@@ -169,11 +223,13 @@ int main() {
       new_test("Removing Values (NO COLLISIONS)",
                &test_remove_without_collisions),
       new_test("Removing Values (COLLISIONS)", &test_remove_with_collisions),
-      new_test("Test Entry IDs (NO COLLISIONS)",
-               &test_entry_ids_without_collisions),
-      new_test("Test Entry IDs (COLLISIONS)", &test_entry_ids_with_collisions),
+      new_test("Walking Entries (NO COLLISIONS)",
+               &test_entries_without_collisions),
+      new_test("Walking Entries (COLLISIONS)", &test_entries_with_collisions),
+      new_test("Growing", &test_growing),
+      new_test("Get While Growing", &test_get_while_growing),
   };
-  Suite my_suite = new_suite("HashMap Tests", tests, 6);
+  Suite my_suite = new_suite("HashMap Tests", tests, 8);
   run_suite(my_suite);
   return 0;
 }
@@ -0,0 +1,125 @@
+#include "../src/lib/matchmaker.h"
+#include "generics.h"
+
+static match_profile rated(int rating) {
+  return (match_profile){.rating = rating, .rtt = -1};
+}
+
+TestResult test_fifo() {
+  matchmaker_t matchmaker;
+  matchmaker_init(&matchmaker, MATCH_FIFO);
+  match_entry entries[3];
+  // Ratings make no difference
+  matchmaker_add(&matchmaker, &entries[0], rated(2000));
+  matchmaker_add(&matchmaker, &entries[1], rated(500));
+  matchmaker_add(&matchmaker, &entries[2], rated(1000));
+  EXPECT_EQ(matchmaker.count, 3);
+
+  for (int i = 0; i < 3; ++i)
+    EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[i]);
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == NULL);
+  EXPECT_EQ(matchmaker.count, 0);
+  return SUCCESS;
+}
+
+TestResult test_rating() {
+  matchmaker_t matchmaker;
+  matchmaker_init(&matchmaker, MATCH_RATING);
+  match_entry entries[4];
+  matchmaker_add(&matchmaker, &entries[0], rated(400));
+  matchmaker_add(&matchmaker, &entries[1], rated(1500));
+  matchmaker_add(&matchmaker, &entries[2], rated(1010));
+  matchmaker_add(&matchmaker, &entries[3], rated(1020));
+
+  // The same bucket, oldest first
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[2]);
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[3]);
+  // Then whichever is closest
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[1]);
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[0]);
+
+  // As close either side, so it's the older of the two
+  matchmaker_add(&matchmaker, &entries[0], rated(1100));
+  matchmaker_add(&matchmaker, &entries[1], rated(900));
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[0]);
+
+  // Ratings past the last bucket all go into it
+  EXPECT_EQ(matchmaker_bucket(&matchmaker, rated(100000)),
+            MATCHMAKER_BUCKETS - 1);
+  EXPECT_EQ(matchmaker_bucket(&matchmaker, rated(-50)), 0);
+  return SUCCESS;
+}
+
+TestResult test_rtt() {
+  matchmaker_t matchmaker;
+  matchmaker_init(&matchmaker, MATCH_RTT);
+  match_entry near, far;
+  matchmaker_add(&matchmaker, &far, (match_profile){.rtt = 150});
+  matchmaker_add(&matchmaker, &near, (match_profile){.rtt = 5});
+
+  EXPECT(matchmaker_match(&matchmaker, (match_profile){.rtt = 160}) == &far);
+  // Someone whose RTT isn't known is treated as being close by
+  EXPECT(matchmaker_match(&matchmaker, (match_profile){.rtt = -1}) == &near);
+  return SUCCESS;
+}
+
+TestResult test_remove() {
+  matchmaker_t matchmaker;
+  matchmaker_init(&matchmaker, MATCH_RATING);
+  match_entry entries[2];
+  matchmaker_add(&matchmaker, &entries[0], rated(1000));
+  matchmaker_add(&matchmaker, &entries[1], rated(2000));
+
+  EXPECT_EQ(matchmaker_remove(&matchmaker, &entries[0]), 0);
+  EXPECT_EQ(matchmaker_remove(&matchmaker, &entries[0]), -1);
+  // The bucket is empty again, so it isn't picked
+  EXPECT(matchmaker_match(&matchmaker, rated(1000)) == &entries[1]);
+  EXPECT(matchmaker.occupied == 0);
+  return SUCCESS;
+}
+
+TestResult test_mode_names() {
+  EXPECT_EQ(matchmaker_mode_from_name("fifo"), MATCH_FIFO);
+  EXPECT_EQ(matchmaker_mode_from_name("rating"), MATCH_RATING);
+  EXPECT_EQ(matchmaker_mode_from_name("rtt"), MATCH_RTT);
+  EXPECT_EQ(matchmaker_mode_from_name("elo"), -1);
+  return SUCCESS;
+}
+
+TestResult test_rate() {
+  // Evenly matched
+  int winner = 1000, loser = 1000;
+  matchmaker_rate(&winner, &loser);
+  EXPECT_EQ(winner, 1000 + MATCHMAKER_RATING_K / 2);
+  EXPECT_EQ(loser, 1000 - MATCHMAKER_RATING_K / 2);
+
+  // Beating someone rated higher is worth more than beating someone lower
+  int upset = 1000, favourite = 1200;
+  matchmaker_rate(&upset, &favourite);
+  winner = 1200, loser = 1000;
+  matchmaker_rate(&winner, &loser);
+  EXPECT(upset - 1000 > winner - 1200);
+
+  // But never more than K, or nothing at all
+  winner = 0, loser = 100000;
+  matchmaker_rate(&winner, &loser);
+  EXPECT_EQ(winner, MATCHMAKER_RATING_K - 1);
+  winner = 100000, loser = 0;
+  matchmaker_rate(&winner, &loser);
+  EXPECT_EQ(winner, 100001);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("FIFO", &test_fifo),
+      new_test("Rating", &test_rating),
+      new_test("RTT", &test_rtt),
+      new_test("Remove", &test_remove),
+      new_test("Mode Names", &test_mode_names),
+      new_test("Rate", &test_rate),
+  };
+  Suite my_suite = new_suite("Matchmaker Tests", tests, 6);
+  run_suite(my_suite);
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "../src/lib/pool.h"
+#include "../src/lib/utils.h"
+#include "generics.h"
+
+TestResult test_reuse() {
+  pool_t *pool = pool_init(sizeof(int), 4);
+  int *first = pool_alloc(pool);
+  *first = 5;
+  EXPECT_EQ((int)pool->in_use, 1);
+
+  // The last object given back is the first one handed out again
+  pool_release(pool, first);
+  EXPECT_EQ((int)pool->in_use, 0);
+  EXPECT(pool_alloc(pool) == first);
+  EXPECT_EQ((int)pool->slab_count, 1);
+
+  pool_free(pool);
+  return SUCCESS;
+}
+
+TestResult test_slabs() {
+  pool_t *pool = pool_init(sizeof(struct node), 4);
+  void *objects[10];
+  for (int i = 0; i < 10; ++i) {
+    objects[i] = pool_alloc(pool);
+    memset(objects[i], i, sizeof(struct node));
+  }
+  EXPECT_EQ((int)pool->slab_count, 3);
+
+  // None of the objects overlap
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(*(char *)objects[i], i);
+
+  for (int i = 0; i < 10; ++i)
+    pool_release(pool, objects[i]);
+  for (int i = 0; i < 10; ++i)
+    pool_alloc(pool);
+  EXPECT_EQ((int)pool->slab_count, 3);
+
+  pool_free(pool);
+  return SUCCESS;
+}
+
+TestResult test_pooled_list() {
+  pool_t *pool = pool_init(sizeof(struct node), 0);
+  LinkedList *list = init_pooled_list(pool);
+  for (int i = 0; i < 100; ++i)
+    push_node(list, (NodeValue){.i_value = i});
+  EXPECT_EQ((int)pool->in_use, 100);
+
+  EXPECT_EQ(pop_node(list).i_value, 0);
+  EXPECT_EQ(remove_node(list, (NodeValue){.i_value = 50}).i_value, 50);
+  EXPECT_EQ((int)pool->in_use, 98);
+
+  free_list(list);
+  EXPECT_EQ((int)pool->in_use, 0);
+
+  pool_free(pool);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Reuse", &test_reuse),
+      new_test("Slabs", &test_slabs),
+      new_test("Pooled List", &test_pooled_list),
+  };
+  Suite my_suite = new_suite("Pool Tests", tests, 3);
+  run_suite(my_suite);
+  return 0;
+}
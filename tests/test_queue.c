@@ -0,0 +1,56 @@
+#include "../src/lib/queue.h"
+#include "generics.h"
+
+typedef struct {
+  int value;
+  queue_link link;
+} item;
+
+TestResult test_fifo() {
+  queue_t queue = new_queue();
+  item items[3] = {{.value = 1}, {.value = 2}, {.value = 3}};
+  for (int i = 0; i < 3; ++i)
+    queue_push(&queue, &items[i].link);
+  EXPECT_EQ(queue.count, 3);
+
+  for (int i = 0; i < 3; ++i) {
+    queue_link *link = queue_pop(&queue);
+    EXPECT(link != NULL);
+    EXPECT_EQ(queue_entry(link, item, link)->value, i + 1);
+  }
+  EXPECT(queue_pop(&queue) == NULL);
+  EXPECT_EQ(queue.count, 0);
+  return SUCCESS;
+}
+
+TestResult test_remove() {
+  queue_t queue = new_queue();
+  item items[3] = {{.value = 1}, {.value = 2}, {.value = 3}};
+  for (int i = 0; i < 3; ++i)
+    queue_push(&queue, &items[i].link);
+
+  // From the middle, then both ends
+  EXPECT_EQ(queue_remove(&queue, &items[1].link), 0);
+  EXPECT_EQ(queue_remove(&queue, &items[1].link), -1);
+  EXPECT(queue.head == &items[0].link && queue.tail == &items[2].link);
+  EXPECT_EQ(queue_remove(&queue, &items[2].link), 0);
+  EXPECT(queue.tail == &items[0].link);
+  EXPECT_EQ(queue_remove(&queue, &items[0].link), 0);
+  EXPECT(queue.head == NULL && queue.tail == NULL);
+  EXPECT_EQ(queue.count, 0);
+
+  // A link can be queued again once it has been taken out
+  queue_push(&queue, &items[1].link);
+  EXPECT(queue_pop(&queue) == &items[1].link);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("FIFO", &test_fifo),
+      new_test("Remove", &test_remove),
+  };
+  Suite my_suite = new_suite("Queue Tests", tests, 2);
+  run_suite(my_suite);
+  return 0;
+}
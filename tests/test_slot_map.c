@@ -0,0 +1,96 @@
+#include "../src/lib/slot_map.h"
+#include "generics.h"
+
+TestResult test_insert_get() {
+  slot_map map = new_slot_map();
+  int values[3] = {1, 2, 3};
+  slot_handle handles[3];
+  for (int i = 0; i < 3; ++i) {
+    handles[i] = slot_map_insert(&map, &values[i]);
+    EXPECT(handles[i] != SLOT_HANDLE_NONE);
+  }
+
+  EXPECT_EQ((int)map.count, 3);
+  for (int i = 0; i < 3; ++i)
+    EXPECT(slot_map_get(&map, handles[i]) == &values[i]);
+  EXPECT(slot_map_get(&map, SLOT_HANDLE_NONE) == NULL);
+
+  free_slot_map(&map);
+  return SUCCESS;
+}
+
+TestResult test_remove() {
+  slot_map map = new_slot_map();
+  int values[3] = {1, 2, 3};
+  slot_handle handles[3];
+  for (int i = 0; i < 3; ++i)
+    handles[i] = slot_map_insert(&map, &values[i]);
+
+  // The last value takes the place of the one that was removed
+  EXPECT(slot_map_remove(&map, handles[0]) == &values[0]);
+  EXPECT_EQ((int)map.count, 2);
+  EXPECT(map.values[0] == &values[2]);
+  EXPECT(map.values[1] == &values[1]);
+  EXPECT(slot_map_get(&map, handles[0]) == NULL);
+  EXPECT(slot_map_get(&map, handles[2]) == &values[2]);
+
+  EXPECT(slot_map_remove(&map, handles[0]) == NULL);
+
+  free_slot_map(&map);
+  return SUCCESS;
+}
+
+TestResult test_stale_handles() {
+  slot_map map = new_slot_map();
+  int first = 1, second = 2;
+  slot_handle old = slot_map_insert(&map, &first);
+  slot_map_remove(&map, old);
+
+  // The slot is reused, but the old handle must not see the new value
+  slot_handle new = slot_map_insert(&map, &second);
+  EXPECT(new != old);
+  EXPECT(slot_map_get(&map, old) == NULL);
+  EXPECT(slot_map_get(&map, new) == &second);
+  EXPECT(slot_map_remove(&map, old) == NULL);
+  EXPECT_EQ((int)map.count, 1);
+
+  free_slot_map(&map);
+  return SUCCESS;
+}
+
+TestResult test_growing() {
+  slot_map map = new_slot_map();
+  int values[1000];
+  slot_handle handles[1000];
+  for (int i = 0; i < 1000; ++i) {
+    values[i] = i;
+    handles[i] = slot_map_insert(&map, &values[i]);
+  }
+  for (int i = 0; i < 1000; i += 2)
+    slot_map_remove(&map, handles[i]);
+
+  EXPECT_EQ((int)map.count, 500);
+  for (int i = 1; i < 1000; i += 2)
+    EXPECT_EQ(*(int *)slot_map_get(&map, handles[i]), i);
+
+  // Every value that is left is in the packed array exactly once
+  int sum = 0;
+  for (uint32_t i = 0; i < map.count; ++i)
+    sum += *(int *)map.values[i];
+  EXPECT_EQ(sum, 500 * 500);
+
+  free_slot_map(&map);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Insert & Get", &test_insert_get),
+      new_test("Remove", &test_remove),
+      new_test("Stale Handles", &test_stale_handles),
+      new_test("Growing", &test_growing),
+  };
+  Suite my_suite = new_suite("Slot Map Tests", tests, 4);
+  run_suite(my_suite);
+  return 0;
+}
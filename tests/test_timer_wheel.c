@@ -0,0 +1,187 @@
+#include "../src/lib/timer_wheel.h"
+#include "generics.h"
+
+typedef struct {
+  wheel_timer timer;
+  uint64_t deadline;
+  uint64_t fired_at; // 0 until it has fired
+  int fired;         // How many times
+} item;
+
+static uint64_t now;
+
+static void on_fire(wheel_timer *timer, void *context) {
+  item *it = timer_entry(timer, item, timer);
+  it->fired_at = now;
+  it->fired++;
+  (*(int *)context)++;
+}
+
+// Advances the wheel a millisecond at a time, until `until`
+static int run_until(timer_wheel *wheel, uint64_t until) {
+  int fired = 0, counted = 0;
+  for (; now <= until; ++now)
+    counted += timer_wheel_advance(wheel, now, &fired);
+  now = until;
+  return fired == counted ? fired : -1;
+}
+
+TestResult test_on_time() {
+  timer_wheel wheel;
+  now = 1000;
+  timer_wheel_init(&wheel, now);
+  // One in each level, and a few that share a slot
+  item items[] = {{.deadline = 1005},    {.deadline = 1005},
+                  {.deadline = 1100},    {.deadline = 1640},
+                  {.deadline = 45000},   {.deadline = 1000 + 3000000},
+                  {.deadline = 1000}};
+  int count = sizeof(items) / sizeof(item);
+  for (int i = 0; i < count; ++i) {
+    timer_init(&items[i].timer, &on_fire);
+    timer_arm(&wheel, &items[i].timer, items[i].deadline);
+  }
+  EXPECT_EQ(wheel.count, count);
+
+  EXPECT_EQ(run_until(&wheel, 1000 + 3000000 + TIMER_WHEEL_TICK), count);
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(items[i].fired, 1);
+    // Never early, and at most a tick late
+    EXPECT(items[i].fired_at >= items[i].deadline);
+    EXPECT(items[i].fired_at < items[i].deadline + TIMER_WHEEL_TICK);
+  }
+  EXPECT_EQ(wheel.count, 0);
+  return SUCCESS;
+}
+
+TestResult test_cancel() {
+  timer_wheel wheel;
+  now = 0;
+  timer_wheel_init(&wheel, now);
+  item items[3] = {{.deadline = 50}, {.deadline = 50}, {.deadline = 9000}};
+  for (int i = 0; i < 3; ++i) {
+    timer_init(&items[i].timer, &on_fire);
+    timer_arm(&wheel, &items[i].timer, items[i].deadline);
+  }
+  EXPECT_EQ(timer_cancel(&wheel, &items[0].timer), 0);
+  EXPECT_EQ(timer_cancel(&wheel, &items[2].timer), 0);
+  EXPECT_EQ(timer_cancel(&wheel, &items[2].timer), -1);
+  EXPECT_EQ(wheel.count, 1);
+
+  EXPECT_EQ(run_until(&wheel, 10000), 1);
+  EXPECT_EQ(items[0].fired, 0);
+  EXPECT_EQ(items[1].fired, 1);
+  EXPECT_EQ(items[2].fired, 0);
+  return SUCCESS;
+}
+
+TestResult test_rearm() {
+  timer_wheel wheel;
+  now = 0;
+  timer_wheel_init(&wheel, now);
+  item it = {.deadline = 100};
+  timer_init(&it.timer, &on_fire);
+  timer_arm(&wheel, &it.timer, 100);
+  // Moved back, then forward again
+  timer_arm(&wheel, &it.timer, 5000);
+  timer_arm(&wheel, &it.timer, 300);
+  EXPECT_EQ(wheel.count, 1);
+  EXPECT_EQ(run_until(&wheel, 299), 0);
+  EXPECT_EQ(run_until(&wheel, 310), 1);
+  EXPECT_EQ((int)it.fired_at, 300);
+  return SUCCESS;
+}
+
+// Cancels the other item, and arms itself again a second later
+static item *victim;
+static void on_fire_cancel(wheel_timer *timer, void *context) {
+  timer_cancel(context, &victim->timer);
+  timer_arm(context, timer, now + 1000);
+  timer_entry(timer, item, timer)->fired++;
+}
+
+TestResult test_callbacks() {
+  timer_wheel wheel;
+  now = 0;
+  timer_wheel_init(&wheel, now);
+  // Both due on the same tick
+  item first = {0}, second = {0};
+  victim = &second;
+  timer_init(&first.timer, &on_fire_cancel);
+  timer_init(&second.timer, &on_fire);
+  timer_arm(&wheel, &first.timer, 20);
+  timer_arm(&wheel, &second.timer, 20);
+
+  for (now = 0; now <= 3500; ++now)
+    timer_wheel_advance(&wheel, now, &wheel);
+  EXPECT_EQ(first.fired, 4);
+  EXPECT_EQ(second.fired, 0);
+  EXPECT_EQ(wheel.count, 1);
+  return SUCCESS;
+}
+
+TestResult test_timeout() {
+  timer_wheel wheel;
+  now = 7;
+  timer_wheel_init(&wheel, now);
+  EXPECT_EQ(timer_wheel_timeout(&wheel, now), -1);
+
+  item soon = {0}, later = {0};
+  timer_init(&soon.timer, &on_fire);
+  timer_init(&later.timer, &on_fire);
+  timer_arm(&wheel, &later.timer, 200000);
+  // Never after it's due
+  int timeout = timer_wheel_timeout(&wheel, now);
+  EXPECT(timeout > 0 && now + timeout <= 200000);
+
+  timer_arm(&wheel, &soon.timer, 250);
+  timeout = timer_wheel_timeout(&wheel, now);
+  EXPECT(now + timeout >= 250 && now + timeout < 250 + TIMER_WHEEL_TICK);
+
+  // Waiting as long as it says each time gets to the timer without spinning
+  int fired = 0, waits = 0;
+  timer_cancel(&wheel, &soon.timer);
+  while (fired == 0 && waits < 100) {
+    now += timer_wheel_timeout(&wheel, now);
+    timer_wheel_advance(&wheel, now, &fired);
+    waits++;
+  }
+  EXPECT_EQ(fired, 1);
+  EXPECT(now >= 200000 && now < 200000 + TIMER_WHEEL_TICK);
+  EXPECT(waits <= TIMER_WHEEL_LEVELS);
+  EXPECT_EQ(timer_wheel_timeout(&wheel, now), -1);
+  return SUCCESS;
+}
+
+TestResult test_far_off() {
+  timer_wheel wheel;
+  now = 0;
+  timer_wheel_init(&wheel, now);
+  item it = {0};
+  timer_init(&it.timer, &on_fire);
+  uint64_t deadline = TIMER_WHEEL_SPAN * TIMER_WHEEL_TICK * 2 + 55;
+  timer_arm(&wheel, &it.timer, deadline);
+
+  int fired = 0;
+  while (fired == 0) {
+    int timeout = timer_wheel_timeout(&wheel, now);
+    EXPECT(timeout >= 0);
+    now += timeout;
+    timer_wheel_advance(&wheel, now, &fired);
+  }
+  EXPECT(now >= deadline && now < deadline + TIMER_WHEEL_TICK);
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("On Time", &test_on_time),
+      new_test("Cancel", &test_cancel),
+      new_test("Re-arm", &test_rearm),
+      new_test("Callbacks", &test_callbacks),
+      new_test("Timeout", &test_timeout),
+      new_test("Far Off", &test_far_off),
+  };
+  Suite my_suite = new_suite("Timer Wheel Tests", tests, 6);
+  run_suite(my_suite);
+  return 0;
+}
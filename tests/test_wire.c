@@ -0,0 +1,211 @@
+#include "../src/lib/wire.h"
+#include "generics.h"
+
+TestResult test_same_as_serialize() {
+  char buf[64];
+  wire_writer writer = wire_writer_fixed(buf, sizeof(buf));
+  wire_write_int(&writer, -10);
+  wire_write_bool(&writer, TRUE);
+  wire_write_string(&writer, "hello");
+  EXPECT(!writer.has_failed);
+  EXPECT_EQ((int)writer.len,
+            WIRE_INT_SIZE + WIRE_BOOL_SIZE + WIRE_STRING_SIZE(5));
+
+  // The encoding is the same as the one from the `serialize_*` functions
+  char *i = serialize_int(-10);
+  char *b = serialize_bool(TRUE);
+  serialized_string str = serialize_string("hello");
+  EXPECT_EQ(memcmp(buf, i, WIRE_INT_SIZE), 0);
+  EXPECT_EQ(memcmp(buf + WIRE_INT_SIZE, b, WIRE_BOOL_SIZE), 0);
+  EXPECT_EQ(memcmp(buf + WIRE_INT_SIZE + WIRE_BOOL_SIZE, str.str, str.len + 2),
+            0);
+
+  free(i);
+  free(b);
+  free(str.str);
+  return SUCCESS;
+}
+
+TestResult test_round_trip() {
+  wire_writer writer = wire_writer_growable(4);
+  wire_write_int(&writer, 123456);
+  wire_write_int(&writer, 200); // A byte with its top bit set
+  wire_write_enum(&writer, 3);
+  wire_write_stringf(&writer, "%s's game", "John");
+  wire_write_bool(&writer, FALSE);
+  EXPECT(!writer.has_failed);
+
+  wire_reader reader = wire_reader_init(writer.buf, writer.len);
+  EXPECT_EQ(wire_peek(&reader), INT_SERIALIZE_FLAG);
+  EXPECT_EQ(wire_read_int(&reader), 123456);
+  EXPECT_EQ(wire_read_int(&reader), 200);
+  EXPECT_EQ(wire_read_enum(&reader), 3);
+
+  size_t len;
+  const char *str = wire_read_string(&reader, &len);
+  EXPECT_EQ(strcmp(str, "John's game"), 0);
+  EXPECT_EQ((int)len, 11);
+  // The string is read in place
+  EXPECT(str > writer.buf && str < writer.buf + writer.len);
+
+  EXPECT_EQ(wire_read_bool(&reader), FALSE);
+  EXPECT_EQ(wire_peek(&reader), -1);
+  EXPECT(!reader.has_failed);
+  // Reading past the end fails, rather than reading as FALSE
+  EXPECT_EQ(wire_read_bool(&reader), -1);
+  EXPECT(reader.has_failed);
+
+  free(writer.buf);
+  return SUCCESS;
+}
+
+TestResult test_overflow() {
+  char buf[8];
+  wire_writer writer = wire_writer_fixed(buf, sizeof(buf));
+  wire_write_int(&writer, 1);
+  wire_write_int(&writer, 2);
+  EXPECT(writer.has_failed);
+  // Nothing after the failure is written
+  wire_write_bool(&writer, TRUE);
+  EXPECT_EQ((int)writer.len, WIRE_INT_SIZE);
+  return SUCCESS;
+}
+
+TestResult test_invalid_input() {
+  // A type that does not match
+  char *b = serialize_bool(TRUE);
+  wire_reader reader = wire_reader_init(b, WIRE_BOOL_SIZE);
+  EXPECT_EQ(wire_read_int(&reader), -1);
+  EXPECT(reader.has_failed);
+  free(b);
+
+  // An int that has been cut short
+  char *i = serialize_int(5);
+  reader = wire_reader_init(i, 4);
+  EXPECT_EQ(wire_read_int(&reader), -1);
+  EXPECT(reader.has_failed);
+  free(i);
+
+  // A string that claims to be longer than the buffer
+  char str[] = {STRING_SERIALIZE_FLAG, 50, 'a', 'b', '\0'};
+  reader = wire_reader_init(str, 4);
+  EXPECT(wire_read_string(&reader, NULL) == NULL);
+  EXPECT(reader.has_failed);
+  return SUCCESS;
+}
+
+TestResult test_missing_terminator() {
+  // The client sends " " without its terminator, which the connection puts
+  // back in place.
+  char frame[] = {STRING_SERIALIZE_FLAG, 2, ' ', '\0'};
+  wire_reader reader = wire_reader_init(frame, 3);
+  const char *str = wire_read_string(&reader, NULL);
+  EXPECT(str != NULL);
+  EXPECT_EQ(strcmp(str, " "), 0);
+  EXPECT_EQ(wire_peek(&reader), -1);
+  return SUCCESS;
+}
+
+TestResult test_delta() {
+  char buf[WIRE_DELTA_SIZE + WIRE_STRING_SIZE(6)];
+  wire_writer writer = wire_writer_fixed(buf, sizeof(buf));
+  wire_write_delta(&writer, LOBBY_GAME_OPENED, 300);
+  wire_write_string(&writer, "a game");
+  EXPECT(!writer.has_failed);
+
+  int id;
+  wire_reader reader = wire_reader_init(buf, writer.len);
+  EXPECT_EQ(wire_read_delta(&reader, &id), LOBBY_GAME_OPENED);
+  EXPECT_EQ(id, 300);
+  EXPECT_EQ(strcmp(wire_read_string(&reader, NULL), "a game"), 0);
+  EXPECT_EQ(wire_peek(&reader), -1);
+
+  // Anything else isn't a delta
+  reader = wire_reader_init(buf + WIRE_DELTA_SIZE, writer.len);
+  EXPECT_EQ(wire_read_delta(&reader, &id), -1);
+  EXPECT(reader.has_failed);
+  return SUCCESS;
+}
+
+TestResult test_resume() {
+  char buf[WIRE_RESUME_SIZE];
+  wire_writer writer = wire_writer_fixed(buf, sizeof(buf));
+  resume_token token = {0x0102030405060708, 0xF0E0D0C0B0A09080};
+  wire_write_resume(&writer, token);
+  EXPECT(!writer.has_failed);
+  EXPECT_EQ((int)writer.len, WIRE_RESUME_SIZE);
+
+  resume_token read;
+  wire_reader reader = wire_reader_init(buf, writer.len);
+  EXPECT_EQ(wire_read_resume(&reader, &read), 0);
+  EXPECT(read.session == token.session && read.secret == token.secret);
+  EXPECT_EQ(wire_peek(&reader), -1);
+
+  // A token that was cut short
+  reader = wire_reader_init(buf, WIRE_RESUME_SIZE - 1);
+  EXPECT_EQ(wire_read_resume(&reader, &read), -1);
+  // A name is not a token
+  reader = wire_reader_init("\x03\x04" "bob", 5);
+  EXPECT_EQ(wire_read_resume(&reader, &read), -1);
+  return SUCCESS;
+}
+
+// Whether the constant is the same as the frame that used to be built for it
+static BOOL is_same_frame(wire_constant_id id, const char *frame, int len) {
+  return wire_constants[id].len == len &&
+         !memcmp(wire_constants[id].data, frame, len);
+}
+
+TestResult test_constants() {
+  char *i = serialize_int(1);
+  EXPECT(is_same_frame(WIRE_VIEW_GAMES, i, 7));
+  EXPECT(is_same_frame(WIRE_NAME_ACCEPTED, i, 7));
+  free(i);
+  i = serialize_int(2);
+  EXPECT(is_same_frame(WIRE_CREATE_GAME, i, 7));
+  free(i);
+  i = serialize_int(-1);
+  EXPECT(is_same_frame(WIRE_NAME_REJECTED, i, 7));
+  free(i);
+  i = serialize_int(GAME_SIG_EXIT);
+  EXPECT(is_same_frame(WIRE_GAME_EXIT, i, 7));
+  free(i);
+
+  serialized_string str = serialize_string(" ");
+  EXPECT(is_same_frame(WIRE_JOIN, str.str, str.len + 2));
+  free(str.str);
+  str = serialize_string("w");
+  EXPECT(is_same_frame(WIRE_WATCH, str.str, str.len + 2));
+  free(str.str);
+  str = serialize_string("joined");
+  EXPECT(is_same_frame(WIRE_GAME_JOINED, str.str, str.len + 2));
+  free(str.str);
+  str = serialize_string("watching");
+  EXPECT(is_same_frame(WIRE_GAME_WATCHED, str.str, str.len + 2));
+  free(str.str);
+  str = serialize_string("resumed");
+  EXPECT(is_same_frame(WIRE_RESUMED, str.str, str.len + 2));
+  free(str.str);
+  str = serialize_string("expired");
+  EXPECT(is_same_frame(WIRE_RESUME_REJECTED, str.str, str.len + 2));
+  free(str.str);
+  EXPECT(is_same_frame(WIRE_BACK, "b", 2));
+
+  return SUCCESS;
+}
+
+int main() {
+  Test *tests = (Test[]){
+      new_test("Same As Serialize", &test_same_as_serialize),
+      new_test("Round Trip", &test_round_trip),
+      new_test("Overflow", &test_overflow),
+      new_test("Invalid Input", &test_invalid_input),
+      new_test("Missing Terminator", &test_missing_terminator),
+      new_test("Constants", &test_constants),
+      new_test("Delta", &test_delta),
+      new_test("Resume", &test_resume),
+  };
+  Suite my_suite = new_suite("Wire Tests", tests, 8);
+  run_suite(my_suite);
+  return 0;
+}